@@ -0,0 +1,78 @@
+#include "allocator.h"
+#include <string.h>
+
+/**
+ * Allocates a block from the allocator.
+ * @param mem an allocator, NULL for malloc.
+ * @param size the number of bytes.
+ * @return the block, NULL on failure.
+ */
+void *allocator_malloc (const allocator *mem, size_t size){
+    if (mem == NULL || mem->alloc == NULL){
+        return malloc(size);
+    }
+    return mem->alloc(mem->ctx, size);
+}
+
+/**
+ * Allocates a zeroed block from the allocator.
+ * @param mem an allocator, NULL for calloc.
+ * @param count, size the number of elements and the size of each one.
+ * @return the block, NULL on failure.
+ */
+void *allocator_calloc (const allocator *mem, size_t count, size_t size){
+    if (mem == NULL || mem->alloc == NULL){
+        return calloc(count, size);
+    }
+
+    if (size != 0 && count > (size_t) -1 / size){
+        return NULL;
+    }
+
+    void *block = mem->alloc(mem->ctx, count * size);
+    if (block != NULL){
+        memset(block, 0, count * size);
+    }
+    return block;
+}
+
+/**
+ * Resizes a block of the allocator, keeping its content.
+ * @param mem an allocator, NULL for realloc.
+ * @param ptr the block.
+ * @param old_size the size the block was allocated with.
+ * @param new_size the new size.
+ * @return the resized block, NULL on failure (then ptr is left as is).
+ */
+void *allocator_realloc (const allocator *mem, void *ptr, size_t old_size,
+                         size_t new_size){
+    if (mem == NULL || mem->alloc == NULL){
+        return realloc(ptr, new_size);
+    }
+
+    void *block = mem->alloc(mem->ctx, new_size);
+    if (block == NULL){
+        return NULL;
+    }
+
+    memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+    mem->free(mem->ctx, ptr, old_size);
+    return block;
+}
+
+/**
+ * Frees a block of the allocator.
+ * @param mem an allocator, NULL for free.
+ * @param ptr the block, may be NULL.
+ * @param size the size the block was allocated with.
+ */
+void allocator_free (const allocator *mem, void *ptr, size_t size){
+    if (ptr == NULL){
+        return;
+    }
+    if (mem == NULL || mem->alloc == NULL){
+        free(ptr);
+        return;
+    }
+    mem->free(mem->ctx, ptr, size);
+}
@@ -0,0 +1,68 @@
+#ifndef ALLOCATOR_H_
+#define ALLOCATOR_H_
+
+#include <stdlib.h>
+
+/**
+ * @typedef allocator_alloc_func
+ * Allocates size bytes (aligned for any type), returns NULL on failure.
+ */
+typedef void *(*allocator_alloc_func) (void *ctx, size_t size);
+
+/**
+ * @typedef allocator_free_func
+ * Frees a block returned by the matching allocator_alloc_func. size is the
+ * size the block was allocated with.
+ */
+typedef void (*allocator_free_func) (void *ctx, void *ptr, size_t size);
+
+/**
+ * @struct allocator
+ * A memory allocator the hash map, its vectors and its pairs draw from.
+ * A zeroed allocator (or a NULL pointer to one) means malloc and free.
+ * @param alloc the allocation function.
+ * @param free the free function.
+ * @param ctx passed as is to alloc and free, e.g. an arena.
+ */
+typedef struct allocator {
+    allocator_alloc_func alloc;
+    allocator_free_func free;
+    void *ctx;
+} allocator;
+
+/**
+ * Allocates a block from the allocator.
+ * @param mem an allocator, NULL for malloc.
+ * @param size the number of bytes.
+ * @return the block, NULL on failure.
+ */
+void *allocator_malloc (const allocator *mem, size_t size);
+
+/**
+ * Allocates a zeroed block from the allocator.
+ * @param mem an allocator, NULL for calloc.
+ * @param count, size the number of elements and the size of each one.
+ * @return the block, NULL on failure.
+ */
+void *allocator_calloc (const allocator *mem, size_t count, size_t size);
+
+/**
+ * Resizes a block of the allocator, keeping its content.
+ * @param mem an allocator, NULL for realloc.
+ * @param ptr the block.
+ * @param old_size the size the block was allocated with.
+ * @param new_size the new size.
+ * @return the resized block, NULL on failure (then ptr is left as is).
+ */
+void *allocator_realloc (const allocator *mem, void *ptr, size_t old_size,
+                         size_t new_size);
+
+/**
+ * Frees a block of the allocator.
+ * @param mem an allocator, NULL for free.
+ * @param ptr the block, may be NULL.
+ * @param size the size the block was allocated with.
+ */
+void allocator_free (const allocator *mem, void *ptr, size_t size);
+
+#endif //ALLOCATOR_H_
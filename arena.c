@@ -0,0 +1,214 @@
+#include "arena.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @def ARENA_ALIGN
+ * Every block is aligned (and sized) to this many bytes.
+ */
+#define ARENA_ALIGN 16UL
+
+#define SIZE_CLASSES (ARENA_MAX_SMALL / ARENA_ALIGN)
+
+/**
+ * @struct slab
+ * A header in front of every slab, and of every big block, linking them so
+ * arena_free can release them all.
+ * @param prev, next the neighbours in the list.
+ */
+typedef struct slab {
+    struct slab *prev;
+    struct slab *next;
+} slab;
+
+/**
+ * @struct free_block
+ * A freed small block, waiting in the free list of its size class.
+ */
+typedef struct free_block {
+    struct free_block *next;
+} free_block;
+
+/**
+ * @struct arena
+ * @param slab_size the size of every slab.
+ * @param slabs all the slabs and the big blocks.
+ * @param slab_count the number of entries in slabs.
+ * @param cur the unused part of the newest slab.
+ * @param left the number of bytes left at cur.
+ * @param free_lists one list of freed blocks per size class.
+ */
+struct arena {
+    size_t slab_size;
+    slab *slabs;
+    size_t slab_count;
+    char *cur;
+    size_t left;
+    free_block *free_lists[SIZE_CLASSES];
+};
+
+/**
+ * the size of the slab header, rounded up to keep blocks aligned.
+ */
+#define HEADER_SIZE ((sizeof(slab) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/**
+ * allocates a new slab of the given size (header included) and links it.
+ */
+static slab *slab_alloc(arena *mem_arena, size_t size){
+    slab *new_slab = malloc(size);
+    if (new_slab == NULL){
+        return NULL;
+    }
+
+    new_slab->prev = NULL;
+    new_slab->next = mem_arena->slabs;
+    if (mem_arena->slabs != NULL){
+        mem_arena->slabs->prev = new_slab;
+    }
+    mem_arena->slabs = new_slab;
+    mem_arena->slab_count += 1;
+    return new_slab;
+}
+
+/**
+ * Allocates dynamically a new arena.
+ * @param slab_size the size of every slab, 0 for ARENA_SLAB_SIZE.
+ * @return pointer to dynamically allocated arena.
+ * @if_fail return NULL.
+ */
+arena *arena_alloc (size_t slab_size){
+
+    if (slab_size == 0){
+        slab_size = ARENA_SLAB_SIZE;
+    }
+
+    // a slab must hold at least one block of the biggest size class.
+    if (slab_size < HEADER_SIZE + ARENA_MAX_SMALL){
+        slab_size = HEADER_SIZE + ARENA_MAX_SMALL;
+    }
+
+    arena *new_arena = calloc(1, sizeof(arena));
+    if (new_arena == NULL){
+        return NULL;
+    }
+
+    new_arena->slab_size = slab_size;
+    return new_arena;
+}
+
+/**
+ * Frees an arena and every block allocated from it.
+ * @param p_arena pointer to dynamically allocated pointer to arena.
+ */
+void arena_free (arena **p_arena){
+
+    if (p_arena == NULL || *p_arena == NULL){
+        return;
+    }
+
+    slab *cur_slab = (*p_arena)->slabs;
+    while (cur_slab != NULL) {
+        slab *next = cur_slab->next;
+        free(cur_slab);
+        cur_slab = next;
+    }
+
+    free(*p_arena);
+    *p_arena = NULL;
+}
+
+/**
+ * the allocation function of arena_allocator.
+ */
+static void *arena_block_alloc(void *ctx, size_t size){
+
+    arena *mem_arena = ctx;
+    size = size == 0 ? ARENA_ALIGN : (size + ARENA_ALIGN - 1) &
+            ~(ARENA_ALIGN - 1);
+
+    // big blocks get a slab of their own.
+    if (size > ARENA_MAX_SMALL){
+        if (size > SIZE_MAX - HEADER_SIZE){
+            return NULL;
+        }
+        slab *big = slab_alloc(mem_arena, HEADER_SIZE + size);
+        return big == NULL ? NULL : (char *) big + HEADER_SIZE;
+    }
+
+    // a freed block of the same size class is reused first.
+    size_t size_class = size / ARENA_ALIGN - 1;
+    free_block *block = mem_arena->free_lists[size_class];
+    if (block != NULL){
+        mem_arena->free_lists[size_class] = block->next;
+        return block;
+    }
+
+    if (mem_arena->left < size){
+        slab *new_slab = slab_alloc(mem_arena, mem_arena->slab_size);
+        if (new_slab == NULL){
+            return NULL;
+        }
+        mem_arena->cur = (char *) new_slab + HEADER_SIZE;
+        mem_arena->left = mem_arena->slab_size - HEADER_SIZE;
+    }
+
+    void *new_block = mem_arena->cur;
+    mem_arena->cur += size;
+    mem_arena->left -= size;
+    return new_block;
+}
+
+/**
+ * the free function of arena_allocator.
+ */
+static void arena_block_free(void *ctx, void *ptr, size_t size){
+
+    arena *mem_arena = ctx;
+    size = size == 0 ? ARENA_ALIGN : (size + ARENA_ALIGN - 1) &
+            ~(ARENA_ALIGN - 1);
+
+    if (size > ARENA_MAX_SMALL){
+
+        // unlink the big block's slab and give it back right away.
+        slab *big = (slab *) ((char *) ptr - HEADER_SIZE);
+        if (big->prev != NULL){
+            big->prev->next = big->next;
+        }
+        else {
+            mem_arena->slabs = big->next;
+        }
+        if (big->next != NULL){
+            big->next->prev = big->prev;
+        }
+        mem_arena->slab_count -= 1;
+        free(big);
+        return;
+    }
+
+    free_block *block = ptr;
+    size_t size_class = size / ARENA_ALIGN - 1;
+    block->next = mem_arena->free_lists[size_class];
+    mem_arena->free_lists[size_class] = block;
+}
+
+/**
+ * Returns an allocator drawing from the arena, e.g. for
+ * hashmap_alloc_allocator. A hash map whose keys and values need no freeing
+ * can then be dropped with arena_free alone, without hashmap_free.
+ * @param mem_arena an arena, it must outlive everything allocated from it.
+ * @return the allocator.
+ */
+allocator arena_allocator (arena *mem_arena){
+    allocator mem = {arena_block_alloc, arena_block_free, mem_arena};
+    return mem;
+}
+
+/**
+ * Returns the number of slabs the arena holds (big blocks count as one).
+ * @param mem_arena an arena.
+ * @return the number of slabs.
+ */
+size_t arena_slab_count (const arena *mem_arena){
+    return mem_arena == NULL ? 0 : mem_arena->slab_count;
+}
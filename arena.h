@@ -0,0 +1,58 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stdlib.h>
+#include "allocator.h"
+
+/**
+ * @def ARENA_SLAB_SIZE
+ * The default size of the slabs an arena carves small blocks from.
+ */
+#define ARENA_SLAB_SIZE (64UL * 1024UL)
+
+/**
+ * @def ARENA_MAX_SMALL
+ * Blocks up to this size are carved from slabs and recycled through free
+ * lists (one per 16 bytes size class). Bigger blocks are allocated on their
+ * own, but are still released by arena_free.
+ */
+#define ARENA_MAX_SMALL 512UL
+
+/**
+ * @typedef arena
+ * A slab allocator. Everything allocated from an arena is released at once
+ * by arena_free, in time proportional to the number of slabs.
+ */
+typedef struct arena arena;
+
+/**
+ * Allocates dynamically a new arena.
+ * @param slab_size the size of every slab, 0 for ARENA_SLAB_SIZE.
+ * @return pointer to dynamically allocated arena.
+ * @if_fail return NULL.
+ */
+arena *arena_alloc (size_t slab_size);
+
+/**
+ * Frees an arena and every block allocated from it.
+ * @param p_arena pointer to dynamically allocated pointer to arena.
+ */
+void arena_free (arena **p_arena);
+
+/**
+ * Returns an allocator drawing from the arena, e.g. for
+ * hashmap_alloc_allocator. A hash map whose keys and values need no freeing
+ * can then be dropped with arena_free alone, without hashmap_free.
+ * @param mem_arena an arena, it must outlive everything allocated from it.
+ * @return the allocator.
+ */
+allocator arena_allocator (arena *mem_arena);
+
+/**
+ * Returns the number of slabs the arena holds (big blocks count as one).
+ * @param mem_arena an arena.
+ * @return the number of slabs.
+ */
+size_t arena_slab_count (const arena *mem_arena);
+
+#endif //ARENA_H_
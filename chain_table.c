@@ -0,0 +1,526 @@
+#include "hashmap_engine.h"
+#include <stdbool.h>
+
+/**
+ * The "copy" function of the bucket vectors. The hash map hands its buckets
+ * entries it already owns, so pushing an entry (or shifting it on erase)
+ * only moves the pointer.
+ * @param p an entry owned by the hash map.
+ * @return the same entry.
+ */
+static void *entry_link(const void *p){
+    return (void *) p;
+}
+
+/**
+ * The "compare" function of the bucket vectors, an entry is only ever equal
+ * to itself.
+ */
+static int entry_same(const void *p1, const void *p2){
+    return p1 == p2;
+}
+
+/**
+ * The "free" function of the bucket vectors. The buckets only link the
+ * entries, the engine frees them.
+ * @param p an entry owned by the hash map.
+ */
+static void entry_unlink(void **p){
+    *p = NULL;
+}
+
+/**
+ * allocates a new buckets array.
+ * @param hash_map the hash map, whose allocator is used.
+ * @param capacity the number of buckets.
+ * @return a new buckets array
+ * @if_fail return NULL.
+ */
+static vector** buckets_alloc(hashmap *hash_map, size_t capacity){
+
+    // first alloc an array of pointers
+    vector** new_buckets = allocator_calloc(&hash_map->mem, capacity,
+                                            sizeof(vector*));
+
+    if (new_buckets == NULL){
+        return NULL;
+    }
+
+    for (size_t i = 0; i < capacity; ++i) {
+
+        // allocate every vector
+        new_buckets[i] = vector_alloc_with(entry_link, entry_same, entry_unlink,
+                                           &hash_map->mem);
+
+        // in case the memory allocation has not succeeded we need to free all
+        // vectors
+        if (new_buckets[i] == NULL){
+
+            for (size_t j = 0; j < i; ++j) {
+                vector_free(&new_buckets[j]);
+            }
+
+            allocator_free(&hash_map->mem, new_buckets,
+                           capacity * sizeof(vector*));
+            return NULL;
+
+        }
+
+    }
+
+    return new_buckets;
+}
+
+/**
+ * frees a buckets array.
+ * @param hash_map the hash map, whose allocator is used.
+ * @param buckets the buckets array.
+ * @param capacity the number of buckets.
+ * @param free_entries true to free the pairs too, false if they were moved
+ * to another buckets array.
+ */
+static void buckets_free(hashmap *hash_map, vector** buckets ,
+                         size_t capacity, int free_entries) {
+
+    for (size_t i = 0; i < capacity; ++i) {
+
+        for (size_t j = 0; free_entries && j < buckets[i]->size; ++j) {
+            entry_free((entry **) &buckets[i]->data[j], &hash_map->ops,
+                       &hash_map->mem);
+        }
+        vector_free(&buckets[i]);
+
+    }
+
+    allocator_free(&hash_map->mem, buckets, capacity * sizeof(vector*));
+}
+
+/**
+ * the number of words of the occupancy bitmap of capacity buckets.
+ */
+static size_t occupied_words(size_t capacity){
+    return (capacity + 63) / 64;
+}
+
+/**
+ * allocates a cleared occupancy bitmap for capacity buckets.
+ * @return the bitmap, NULL on failure.
+ */
+static uint64_t *occupied_alloc(hashmap *hash_map, size_t capacity){
+    return allocator_calloc(&hash_map->mem, occupied_words(capacity),
+                            sizeof(uint64_t));
+}
+
+static void occupied_free(hashmap *hash_map, uint64_t *occupied,
+                          size_t capacity){
+    allocator_free(&hash_map->mem, occupied,
+                   occupied_words(capacity) * sizeof(uint64_t));
+}
+
+/**
+ * marks a bucket as holding pairs. Atomic, since hashmap_from_array links
+ * the pairs of neighbouring buckets from several threads.
+ */
+static void occupied_set(uint64_t *occupied, size_t index){
+    __atomic_fetch_or(&occupied[index / 64], (uint64_t) 1 << (index % 64),
+                      __ATOMIC_RELAXED);
+}
+
+static void occupied_clear(uint64_t *occupied, size_t index){
+    occupied[index / 64] &= ~((uint64_t) 1 << (index % 64));
+}
+
+/**
+ * returns the first bucket from index on that may hold pairs, capacity if
+ * there is none.
+ */
+static size_t occupied_next(const uint64_t *occupied, size_t capacity,
+                            size_t index){
+    for (size_t word = index / 64; word < occupied_words(capacity); ++word) {
+
+        uint64_t bits = occupied[word];
+        if (word == index / 64){
+            bits &= ~(uint64_t) 0 << (index % 64);
+        }
+        if (bits != 0){
+            return word * 64 + (size_t) __builtin_ctzll(bits);
+        }
+    }
+
+    return capacity;
+}
+
+static int chain_init(hashmap *hash_map){
+    hash_map->buckets = buckets_alloc(hash_map, hash_map->capacity);
+    hash_map->occupied = occupied_alloc(hash_map, hash_map->capacity);
+
+    if (hash_map->buckets == NULL || hash_map->occupied == NULL){
+        if (hash_map->buckets != NULL){
+            buckets_free(hash_map, hash_map->buckets, hash_map->capacity,
+                         false);
+        }
+        occupied_free(hash_map, hash_map->occupied, hash_map->capacity);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * frees the old buckets array of an incremental rehash, the buckets that
+ * were already moved are NULL.
+ */
+static void old_buckets_free(hashmap *hash_map, int free_entries){
+
+    for (size_t i = hash_map->rehash_index; i < hash_map->old_capacity; ++i) {
+        vector *old_vector = hash_map->old_buckets[i];
+        for (size_t j = 0; free_entries && j < old_vector->size; ++j) {
+            entry_free((entry **) &old_vector->data[j], &hash_map->ops,
+                       &hash_map->mem);
+        }
+        vector_free(&hash_map->old_buckets[i]);
+    }
+
+    allocator_free(&hash_map->mem, hash_map->old_buckets,
+                   hash_map->old_capacity * sizeof(vector*));
+    hash_map->old_buckets = NULL;
+    hash_map->old_capacity = 0;
+    hash_map->rehash_index = 0;
+}
+
+static void chain_destroy(hashmap *hash_map){
+    if (hash_map->old_buckets != NULL){
+        old_buckets_free(hash_map, true);
+    }
+    buckets_free(hash_map, hash_map->buckets, hash_map->capacity, true);
+    occupied_free(hash_map, hash_map->occupied, hash_map->capacity);
+    hash_map->buckets = NULL;
+    hash_map->occupied = NULL;
+}
+
+/**
+ * returns the old bucket a hash still lives in, NULL if there is no
+ * rehash in progress or that bucket was already moved.
+ */
+static vector *old_bucket_of(const hashmap *hash_map, size_t hash){
+    if (hash_map->old_buckets == NULL){
+        return NULL;
+    }
+    size_t index = hash & (hash_map->old_capacity - 1);
+    if (index < hash_map->rehash_index){
+        return NULL;
+    }
+    return hash_map->old_buckets[index];
+}
+
+/**
+ * finds the slot of the key in one bucket, NULL if it isn't there.
+ */
+static entry **bucket_find(const hashmap *hash_map, vector *cur_vector,
+                           size_t hash, engine_key_match match,
+                           const void *key, size_t len){
+
+    for (size_t i = 0; i < cur_vector->size ; ++i) {
+        entry* cur_entry = cur_vector->data[i];
+
+        // the cached hashes rule out most pairs without calling key_cmp.
+        if (cur_entry->hash == hash &&
+            match(hash_map, cur_entry->key, key, len)){
+            return (entry **) &cur_vector->data[i];
+        }
+    }
+
+    return NULL;
+}
+
+static entry **chain_search(const hashmap *hash_map, size_t hash,
+                            engine_key_match match, const void *key,
+                            size_t len){
+
+    entry **slot = bucket_find(
+            hash_map, hash_map->buckets[hash & (hash_map->capacity - 1)],
+            hash, match, key, len);
+
+    // while rehashing, a key that was not moved yet is in the old buckets.
+    vector *old_vector = old_bucket_of(hash_map, hash);
+    if (slot == NULL && old_vector != NULL){
+        slot = bucket_find(hash_map, old_vector, hash, match, key, len);
+    }
+
+    return slot;
+}
+
+static entry **chain_find(const hashmap *hash_map, size_t hash,
+                          const_keyT key){
+    return chain_search(hash_map, hash, engine_match_key, key, 0);
+}
+
+static entry **chain_find_bytes(const hashmap *hash_map, size_t hash,
+                                const void *bytes, size_t len){
+    return chain_search(hash_map, hash, engine_match_bytes, bytes, len);
+}
+
+static int chain_insert(hashmap *hash_map, size_t hash, entry *new_entry){
+    size_t index = hash & (hash_map->capacity - 1);
+    vector* cur_vector = hash_map->buckets[index];
+
+    if (!vector_push_back(cur_vector, new_entry)){
+        return false;
+    }
+
+    if (cur_vector->size == 1){
+        occupied_set(hash_map->occupied, index);
+    }
+    return true;
+}
+
+/**
+ * finds the bucket a slot belongs to, by the cached hash of the pair in it.
+ */
+static vector *chain_bucket_of(const hashmap *hash_map, entry **slot){
+    size_t hash = (*slot)->hash;
+    vector *old_vector = old_bucket_of(hash_map, hash);
+
+    if (old_vector != NULL && (void **) slot >= old_vector->data &&
+        (void **) slot < old_vector->data + old_vector->size){
+        return old_vector;
+    }
+    return hash_map->buckets[hash & (hash_map->capacity - 1)];
+}
+
+static entry *chain_erase(hashmap *hash_map, entry **slot){
+    entry *old_entry = *slot;
+    size_t index = old_entry->hash & (hash_map->capacity - 1);
+    vector* cur_vector = chain_bucket_of(hash_map, slot);
+    vector_erase(cur_vector, (size_t) ((void **) slot - cur_vector->data));
+
+    if (cur_vector->size == 0 && cur_vector == hash_map->buckets[index]){
+        occupied_clear(hash_map->occupied, index);
+    }
+    return old_entry;
+}
+
+/**
+ * moves all the pairs of one old bucket to the new buckets array.
+ * @return 1 on success, 0 otherwise (then the pairs stay in the old bucket).
+ */
+static int move_old_bucket(hashmap *hash_map, size_t index){
+
+    vector *old_vector = hash_map->old_buckets[index];
+
+    for (size_t j = 0; j < old_vector->size; ++j) {
+
+        entry *cur_entry = old_vector->data[j];
+        size_t new_index = cur_entry->hash & (hash_map->capacity - 1);
+        vector *new_vector = hash_map->buckets[new_index];
+
+        // a bucket marked here stays marked if the move is taken back,
+        // chain_next skips it as empty.
+        occupied_set(hash_map->occupied, new_index);
+
+        if (!vector_push_back(new_vector, cur_entry)){
+
+            // take back the pairs already pushed, each one is the last in
+            // its new bucket.
+            while (j-- > 0) {
+                entry *moved = old_vector->data[j];
+                hash_map->buckets[moved->hash &
+                                  (hash_map->capacity - 1)]->size -= 1;
+            }
+            return false;
+        }
+    }
+
+    vector_free(&hash_map->old_buckets[index]);
+    return true;
+}
+
+static int chain_rehash_step(hashmap *hash_map, size_t n){
+
+    for (; n > 0 && hash_map->old_buckets != NULL; --n) {
+
+        if (!move_old_bucket(hash_map, hash_map->rehash_index)){
+            return true;
+        }
+        hash_map->rehash_index += 1;
+
+        if (hash_map->rehash_index == hash_map->old_capacity){
+            old_buckets_free(hash_map, false);
+        }
+    }
+
+    return hash_map->old_buckets != NULL;
+}
+
+static int chain_rehash(hashmap *hash_map, size_t new_capacity){
+
+    // a rehash in progress has to end before another one starts.
+    if (hash_map->old_buckets != NULL &&
+        chain_rehash_step(hash_map, hash_map->old_capacity)){
+        return false;
+    }
+
+    // first initialize a new buckets array to assign the pairs to.
+    vector **temp_buckets = buckets_alloc(hash_map, new_capacity);
+    uint64_t *temp_occupied = occupied_alloc(hash_map, new_capacity);
+
+    if (temp_buckets == NULL || temp_occupied == NULL){
+        if (temp_buckets != NULL){
+            buckets_free(hash_map, temp_buckets, new_capacity, false);
+        }
+        occupied_free(hash_map, temp_occupied, new_capacity);
+        return false;
+    }
+
+    if (hash_map->incremental_rehash){
+
+        // the pairs stay in the old buckets, the next operations move them.
+        // the old buckets are walked without a bitmap, they only live for
+        // the length of the rehash.
+        occupied_free(hash_map, hash_map->occupied, hash_map->capacity);
+        hash_map->old_buckets = hash_map->buckets;
+        hash_map->old_capacity = hash_map->capacity;
+        hash_map->rehash_index = 0;
+        hash_map->buckets = temp_buckets;
+        hash_map->occupied = temp_occupied;
+        hash_map->capacity = new_capacity;
+        return true;
+    }
+
+    for (size_t i = 0; i < hash_map->capacity; ++i) {
+
+        // get the current bucket/vector
+        vector* cur_vector = hash_map->buckets[i];
+
+        for (size_t j = 0; j < cur_vector->size ; ++j) {
+
+            //get the pair object in that bucket and its hash key.
+            entry *cur_entry = cur_vector->data[j];
+
+            size_t hash_key = cur_entry->hash & (new_capacity - 1);
+
+            // put the pair in the proper bucket key.
+            if (!vector_push_back(temp_buckets[hash_key], cur_entry)) {
+
+                // couldn't assign one of the pairs, they are all still
+                // linked from the old buckets.
+                buckets_free(hash_map, temp_buckets, new_capacity, false);
+                occupied_free(hash_map, temp_occupied, new_capacity);
+                return false;
+            }
+            occupied_set(temp_occupied, hash_key);
+        }
+
+    }
+
+    // the pairs moved, so only the former vectors should be freed.
+    buckets_free(hash_map, hash_map->buckets, hash_map->capacity, false);
+    occupied_free(hash_map, hash_map->occupied, hash_map->capacity);
+
+    // assign the temp buckets array to the buckets array of the hash map
+    hash_map->buckets = temp_buckets;
+    hash_map->occupied = temp_occupied;
+    hash_map->capacity = new_capacity;
+
+    return true;
+}
+
+/**
+ * the buckets, then (while rehashing) the old buckets.
+ */
+static size_t chain_positions(const hashmap *hash_map){
+    return hash_map->capacity +
+           (hash_map->old_buckets == NULL ? 0 : hash_map->old_capacity);
+}
+
+/**
+ * walks the buckets the bitmap marks, then (while rehashing) the old
+ * buckets that were not moved yet, as if they followed the buckets.
+ */
+static entry **chain_next(const hashmap *hash_map, hashmap_cursor *cursor){
+
+    size_t end = cursor->end != 0 ? cursor->end : chain_positions(hash_map);
+
+    while (cursor->bucket < end) {
+
+        vector* cur_vector;
+        if (cursor->bucket < hash_map->capacity){
+
+            // empty buckets are skipped 64 at a time.
+            if (cursor->index == 0){
+                cursor->bucket = occupied_next(hash_map->occupied,
+                                               hash_map->capacity,
+                                               cursor->bucket);
+                if (cursor->bucket == hash_map->capacity ||
+                    cursor->bucket >= end){
+                    continue;
+                }
+            }
+            cur_vector = hash_map->buckets[cursor->bucket];
+        }
+        else {
+            cur_vector = hash_map->old_buckets[cursor->bucket -
+                                               hash_map->capacity];
+        }
+
+        if (cur_vector != NULL && cursor->index < cur_vector->size){
+            return (entry **) &cur_vector->data[cursor->index++];
+        }
+        cursor->index = 0;
+        cursor->bucket += 1;
+    }
+
+    return NULL;
+}
+
+/**
+ * the pairs after an erased one move one place down its vector.
+ */
+static void chain_erased(const hashmap *hash_map, hashmap_cursor *cursor){
+    (void) hash_map;
+    cursor->index -= 1;
+}
+
+/**
+ * level 0 the bucket pointer, 1 the vector, 2 its array, 3 its first entry.
+ * while rehashing incrementally only the new bucket is prefetched.
+ */
+static void chain_prefetch(const hashmap *hash_map, size_t hash, int level){
+
+    vector **bucket = &hash_map->buckets[hash & (hash_map->capacity - 1)];
+
+    switch (level) {
+        case 0:
+            HASHMAP_PREFETCH(bucket);
+            break;
+        case 1:
+            HASHMAP_PREFETCH(*bucket);
+            break;
+        case 2:
+            HASHMAP_PREFETCH((*bucket)->data);
+            break;
+        default:
+            if ((*bucket)->size > 0){
+                HASHMAP_PREFETCH((*bucket)->data[0]);
+            }
+            break;
+    }
+}
+
+const hashmap_engine chain_engine = {
+    1,
+    0,
+    chain_init,
+    chain_destroy,
+    chain_find,
+    chain_find_bytes,
+    chain_insert,
+    chain_erase,
+    chain_rehash,
+    chain_next,
+    chain_rehash_step,
+    chain_prefetch,
+    NULL,
+    chain_erased,
+    chain_positions
+};
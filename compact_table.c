@@ -0,0 +1,360 @@
+#include "hashmap_engine.h"
+#include "hash_funcs.h"
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * @def COMPACT_MIN_CAPACITY
+ * The smallest number of index slots of a compact table.
+ */
+#define COMPACT_MIN_CAPACITY 8UL
+
+/**
+ * @def COMPACT_MAX_LOAD_FACTOR
+ * The highest max load factor a compact hash map may be configured with,
+ * the share of the index slots the entries array has room for.
+ */
+#define COMPACT_MAX_LOAD_FACTOR 0.875
+
+/**
+ * @def COMPACT_EMPTY, COMPACT_DUMMY
+ * The values of index slots that hold no position: an empty slot ends a
+ * probe sequence, a dummy one (its pair was erased) keeps it going. Any
+ * other value is the position of a pair in the entries array plus 2.
+ */
+#define COMPACT_EMPTY 0UL
+#define COMPACT_DUMMY 1UL
+
+/**
+ * @struct compact_table
+ * The storage of a compact hash map, allocated as one block: this header,
+ * the entries, then the index.
+ * @param dense_capacity the number of entries the entries array has room
+ * for, 7/8 of the index slots, so the index always has an empty slot.
+ * @param n_entries the number of positions of the entries array used so
+ * far, the erased ones (NULL) included. Pairs are appended at the end, so
+ * the entries array keeps the pairs in insertion order.
+ * @param width the size of an index slot in bytes: 1, 2, 4 or 8, the
+ * smallest that holds every position of the entries array.
+ * @param index one slot per bucket, probed linearly from the home slot of
+ * a hash.
+ * @param entries the pairs, in insertion order.
+ */
+struct compact_table {
+    size_t dense_capacity;
+    size_t n_entries;
+    size_t width;
+    void *index;
+    entry **entries;
+};
+
+/**
+ * the number of entries a table of the given capacity has room for.
+ */
+static size_t compact_dense_capacity(size_t capacity){
+    return capacity - capacity / 8;
+}
+
+/**
+ * the smallest index slot size that holds every value of a table with the
+ * given number of entries.
+ */
+static size_t compact_width(size_t dense_capacity){
+    size_t largest = dense_capacity + 1;
+
+    if (largest <= UINT8_MAX){
+        return sizeof(uint8_t);
+    }
+    if (largest <= UINT16_MAX){
+        return sizeof(uint16_t);
+    }
+    if (largest <= UINT32_MAX){
+        return sizeof(uint32_t);
+    }
+    return sizeof(uint64_t);
+}
+
+/**
+ * the size of the block of a table with the given capacity.
+ */
+static size_t compact_table_size(size_t capacity){
+    size_t dense_capacity = compact_dense_capacity(capacity);
+    return sizeof(compact_table) + dense_capacity * sizeof(entry *) +
+           capacity * compact_width(dense_capacity);
+}
+
+static size_t index_get(const compact_table *table, size_t i){
+    switch (table->width) {
+        case sizeof(uint8_t):
+            return ((const uint8_t *) table->index)[i];
+        case sizeof(uint16_t):
+            return ((const uint16_t *) table->index)[i];
+        case sizeof(uint32_t):
+            return ((const uint32_t *) table->index)[i];
+        default:
+            return (size_t) ((const uint64_t *) table->index)[i];
+    }
+}
+
+static void index_set(compact_table *table, size_t i, size_t value){
+    switch (table->width) {
+        case sizeof(uint8_t):
+            ((uint8_t *) table->index)[i] = (uint8_t) value;
+            break;
+        case sizeof(uint16_t):
+            ((uint16_t *) table->index)[i] = (uint16_t) value;
+            break;
+        case sizeof(uint32_t):
+            ((uint32_t *) table->index)[i] = (uint32_t) value;
+            break;
+        default:
+            ((uint64_t *) table->index)[i] = (uint64_t) value;
+    }
+}
+
+/**
+ * the index slot a pair with the given hash would like to be in. The user
+ * hash may well be the identity, so it is mixed before taking the low bits.
+ */
+static size_t compact_home(size_t hash, size_t capacity){
+    return (size_t) hash_mix64((uint64_t) hash) & (capacity - 1);
+}
+
+/**
+ * allocates an empty table of the given capacity from the hash map's
+ * allocator.
+ * @return the table, NULL on failure.
+ */
+static compact_table *compact_alloc_table(const hashmap *hash_map,
+                                          size_t capacity){
+    compact_table *table = allocator_malloc(&hash_map->mem,
+                                            compact_table_size(capacity));
+
+    if (table == NULL){
+        return NULL;
+    }
+
+    table->dense_capacity = compact_dense_capacity(capacity);
+    table->n_entries = 0;
+    table->width = compact_width(table->dense_capacity);
+    table->entries = (entry **) (table + 1);
+    table->index = table->entries + table->dense_capacity;
+    memset(table->index, 0, capacity * table->width);
+    return table;
+}
+
+static void compact_free_table(const hashmap *hash_map, compact_table *table,
+                               size_t capacity){
+    allocator_free(&hash_map->mem, table, compact_table_size(capacity));
+}
+
+/**
+ * appends new_entry to a table with room for it, and points the first
+ * empty slot of its probe sequence at it.
+ */
+static void compact_place(compact_table *table, size_t capacity,
+                          entry *new_entry){
+    size_t mask = capacity - 1;
+    size_t i = compact_home(new_entry->hash, capacity);
+
+    while (index_get(table, i) != COMPACT_EMPTY) {
+        i = (i + 1) & mask;
+    }
+
+    index_set(table, i, table->n_entries + 2);
+    table->entries[table->n_entries++] = new_entry;
+}
+
+static int compact_init(hashmap *hash_map){
+    hash_map->compact = compact_alloc_table(hash_map, hash_map->capacity);
+    return hash_map->compact != NULL;
+}
+
+static void compact_destroy(hashmap *hash_map){
+    compact_table *table = hash_map->compact;
+    for (size_t i = 0; i < table->n_entries; ++i) {
+        if (table->entries[i] != NULL){
+            entry_free(&table->entries[i], &hash_map->ops, &hash_map->mem);
+        }
+    }
+    compact_free_table(hash_map, table, hash_map->capacity);
+    hash_map->compact = NULL;
+}
+
+static entry **compact_search(const hashmap *hash_map, size_t hash,
+                              engine_key_match match, const void *key,
+                              size_t len){
+
+    const compact_table *table = hash_map->compact;
+    size_t mask = hash_map->capacity - 1;
+
+    for (size_t i = compact_home(hash, hash_map->capacity); ;
+         i = (i + 1) & mask) {
+
+        size_t value = index_get(table, i);
+        if (value == COMPACT_EMPTY){
+            return NULL;
+        }
+        if (value == COMPACT_DUMMY){
+            continue;
+        }
+
+        entry **slot = &table->entries[value - 2];
+        if ((*slot)->hash == hash &&
+            match(hash_map, (*slot)->key, key, len)){
+            return slot;
+        }
+    }
+}
+
+static entry **compact_find(const hashmap *hash_map, size_t hash,
+                            const_keyT key){
+    return compact_search(hash_map, hash, engine_match_key, key, 0);
+}
+
+static entry **compact_find_bytes(const hashmap *hash_map, size_t hash,
+                                  const void *bytes, size_t len){
+    return compact_search(hash_map, hash, engine_match_bytes, bytes, len);
+}
+
+/**
+ * moves the pairs to a new table, in the same order and without the erased
+ * positions. With the same capacity this only compacts the entries.
+ */
+static int compact_rehash(hashmap *hash_map, size_t new_capacity){
+
+    if (compact_dense_capacity(new_capacity) < hash_map->size){
+        return false;
+    }
+
+    compact_table *old_table = hash_map->compact;
+    compact_table *new_table = compact_alloc_table(hash_map, new_capacity);
+
+    if (new_table == NULL){
+        return false;
+    }
+
+    for (size_t i = 0; i < old_table->n_entries; ++i) {
+        if (old_table->entries[i] != NULL){
+            compact_place(new_table, new_capacity, old_table->entries[i]);
+        }
+    }
+
+    compact_free_table(hash_map, old_table, hash_map->capacity);
+    hash_map->compact = new_table;
+    hash_map->capacity = new_capacity;
+    hash_map->tombstones = 0;
+
+    return true;
+}
+
+static int compact_insert(hashmap *hash_map, size_t hash, entry *new_entry){
+    (void) hash;
+
+    compact_table *table = hash_map->compact;
+
+    // a full entries array is compacted in place when enough of it was
+    // erased, otherwise (e.g. a max load factor of 0.875) the hash map
+    // grows it.
+    if (table->n_entries == table->dense_capacity &&
+        (hash_map->tombstones <= table->dense_capacity / 8 ||
+         !compact_rehash(hash_map, hash_map->capacity))){
+        return false;
+    }
+
+    compact_place(hash_map->compact, hash_map->capacity, new_entry);
+    return true;
+}
+
+/**
+ * the index slot of the erased pair becomes a dummy and its position in
+ * the entries array a hole, nothing moves until the next rehash.
+ */
+static entry *compact_erase(hashmap *hash_map, entry **slot){
+
+    compact_table *table = hash_map->compact;
+    size_t mask = hash_map->capacity - 1;
+    size_t value = (size_t) (slot - table->entries) + 2;
+    entry *old_entry = *slot;
+
+    size_t i = compact_home(old_entry->hash, hash_map->capacity);
+    while (index_get(table, i) != value) {
+        i = (i + 1) & mask;
+    }
+
+    index_set(table, i, COMPACT_DUMMY);
+    *slot = NULL;
+    hash_map->tombstones += 1;
+
+    return old_entry;
+}
+
+/**
+ * walks the entries array, so the pairs come in insertion order.
+ */
+static entry **compact_next(const hashmap *hash_map, hashmap_cursor *cursor){
+
+    const compact_table *table = hash_map->compact;
+    size_t end = cursor->end != 0 ? cursor->end : table->n_entries;
+
+    for (; cursor->bucket < end; ++cursor->bucket) {
+        if (table->entries[cursor->bucket] != NULL){
+            return &table->entries[cursor->bucket++];
+        }
+    }
+
+    return NULL;
+}
+
+static size_t compact_positions(const hashmap *hash_map){
+    return hash_map->compact->n_entries;
+}
+
+/**
+ * level 0 the home index slot, 1 the position it points at, 2 the entry
+ * there, 3 its key.
+ */
+static void compact_prefetch(const hashmap *hash_map, size_t hash, int level){
+
+    const compact_table *table = hash_map->compact;
+    size_t home = compact_home(hash, hash_map->capacity);
+
+    if (level == 0){
+        HASHMAP_PREFETCH((const char *) table->index + home * table->width);
+        return;
+    }
+
+    size_t value = index_get(table, home);
+    if (value <= COMPACT_DUMMY){
+        return;
+    }
+
+    entry *const *slot = &table->entries[value - 2];
+    if (level == 1){
+        HASHMAP_PREFETCH(slot);
+    }
+    else if (level == 2){
+        HASHMAP_PREFETCH(*slot);
+    }
+    else {
+        HASHMAP_PREFETCH((*slot)->key);
+    }
+}
+
+const hashmap_engine compact_engine = {
+    COMPACT_MIN_CAPACITY,
+    COMPACT_MAX_LOAD_FACTOR,
+    compact_init,
+    compact_destroy,
+    compact_find,
+    compact_find_bytes,
+    compact_insert,
+    compact_erase,
+    compact_rehash,
+    compact_next,
+    NULL,
+    compact_prefetch,
+    NULL,
+    NULL,
+    compact_positions
+};
@@ -0,0 +1,258 @@
+#include "concurrent_hashmap.h"
+#include "hashmap_engine.h"
+#include <stdbool.h>
+
+/**
+ * returns the stripe of a hash.
+ * @param map the concurrent hash map.
+ * @param hash the hash of a key.
+ * @return the index of its stripe.
+ */
+static size_t stripe_of(const concurrent_hashmap *map, size_t hash){
+    if (map->n_stripes == 1){
+        return 0;
+    }
+
+    // the stripes take the top bits, the hash map of a stripe the low bits.
+    return hash >> map->stripe_shift;
+}
+
+/**
+ * Allocates a new concurrent hash map. Allocating and freeing it are not
+ * thread safe, all the other functions are.
+ * @param func a function which "hashes" keys. Its top bits choose the
+ * stripe, so it should mix its keys (see hash_funcs.h).
+ * @param backend the storage engine of the stripes.
+ * @param n_stripes the number of stripes, rounded up to a power of 2. 0 for
+ * CONCURRENT_HASHMAP_DEFAULT_STRIPES. A few times the number of threads is
+ * a good choice.
+ * @return pointer to dynamically allocated concurrent_hashmap.
+ * @if_fail return NULL.
+ */
+concurrent_hashmap *concurrent_hashmap_alloc (hash_func func,
+                                              hashmap_backend backend,
+                                              size_t n_stripes){
+
+    if (func == NULL){
+        return NULL;
+    }
+
+    if (n_stripes == 0){
+        n_stripes = CONCURRENT_HASHMAP_DEFAULT_STRIPES;
+    }
+
+    unsigned bits = 0;
+    while (((size_t) 1 << bits) < n_stripes) {
+        bits += 1;
+    }
+
+    if (bits >= sizeof(size_t) * 8){
+        return NULL;
+    }
+
+    concurrent_hashmap *map = calloc(1, sizeof(concurrent_hashmap));
+
+    if (map == NULL){
+        return NULL;
+    }
+
+    map->n_stripes = (size_t) 1 << bits;
+    map->stripe_shift = (unsigned) (sizeof(size_t) * 8) - bits;
+    map->hash_func = func;
+    map->stripes = calloc(map->n_stripes, sizeof(hashmap *));
+    map->locks = calloc(map->n_stripes, sizeof(pthread_rwlock_t));
+
+    if (map->stripes == NULL || map->locks == NULL){
+        concurrent_hashmap_free(&map);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < map->n_stripes; ++i) {
+
+        map->stripes[i] = hashmap_alloc_backend(func, backend);
+
+        if (map->stripes[i] == NULL ||
+            pthread_rwlock_init(&map->locks[i], NULL) != 0){
+            hashmap_free(&map->stripes[i]);
+            concurrent_hashmap_free(&map);
+            return NULL;
+        }
+
+        // a resize moves a few buckets per write, instead of all at once.
+        hashmap_set_incremental_rehash(map->stripes[i], true);
+    }
+
+    return map;
+}
+
+/**
+ * Frees a concurrent hash map and all its pairs. No other thread may use it
+ * meanwhile.
+ * @param p_map pointer to dynamically allocated pointer to the map.
+ */
+void concurrent_hashmap_free (concurrent_hashmap **p_map){
+
+    if (p_map == NULL || *p_map == NULL){
+        return;
+    }
+
+    concurrent_hashmap *map = *p_map;
+
+    // the stripes were set up in order, the first NULL one ends them.
+    for (size_t i = 0; map->stripes != NULL && i < map->n_stripes &&
+                       map->stripes[i] != NULL; ++i) {
+        hashmap_free(&map->stripes[i]);
+        pthread_rwlock_destroy(&map->locks[i]);
+    }
+
+    free(map->stripes);
+    free(map->locks);
+    free(map);
+    *p_map = NULL;
+}
+
+/**
+ * Inserts a copy of in_pair, like hashmap_insert.
+ * @param map the concurrent hash map.
+ * @param in_pair a pair the map would contain.
+ * @return returns 1 for successful insertion, 0 otherwise.
+ */
+int concurrent_hashmap_insert (concurrent_hashmap *map, const pair *in_pair){
+
+    if (map == NULL || in_pair == NULL){
+        return false;
+    }
+
+    // the key is hashed once, for its stripe and for the hash map of it.
+    size_t hash = map->hash_func(in_pair->key);
+    size_t i = stripe_of(map, hash);
+
+    pthread_rwlock_wrlock(&map->locks[i]);
+    int is_success = hashmap_insert_hashed(map->stripes[i], in_pair, hash);
+    pthread_rwlock_unlock(&map->locks[i]);
+
+    return is_success;
+}
+
+/**
+ * Returns a copy of the value associated with the given key. Another thread
+ * may erase the pair at any time, so unlike hashmap_at the value itself is
+ * never handed out.
+ * @param map the concurrent hash map.
+ * @param key the key to be checked.
+ * @return a copy of the value (made by the value_cpy of the map's pairs),
+ * which the caller frees. NULL if key is not in the map.
+ */
+valueT concurrent_hashmap_at (const concurrent_hashmap *map, const_keyT key){
+
+    if (map == NULL || key == NULL){
+        return NULL;
+    }
+
+    size_t hash = map->hash_func(key);
+    size_t i = stripe_of(map, hash);
+    valueT copy = NULL;
+
+    // hashmap_at never moves pairs, even while rehashing incrementally, so
+    // the readers of a stripe can share its lock.
+    pthread_rwlock_rdlock(&map->locks[i]);
+    const hashmap *stripe = map->stripes[i];
+    valueT value = hashmap_at_hashed(stripe, key, hash);
+    if (value != NULL){
+        copy = stripe->ops.value_cpy(value);
+    }
+    pthread_rwlock_unlock(&map->locks[i]);
+
+    return copy;
+}
+
+/**
+ * Checks whether the key is in the map.
+ * @param map the concurrent hash map.
+ * @param key the key to be checked.
+ * @return 1 if it is, 0 otherwise.
+ */
+int concurrent_hashmap_contains (const concurrent_hashmap *map,
+                                 const_keyT key){
+
+    if (map == NULL || key == NULL){
+        return false;
+    }
+
+    size_t hash = map->hash_func(key);
+    size_t i = stripe_of(map, hash);
+
+    pthread_rwlock_rdlock(&map->locks[i]);
+    int found = hashmap_at_hashed(map->stripes[i], key, hash) != NULL;
+    pthread_rwlock_unlock(&map->locks[i]);
+
+    return found;
+}
+
+/**
+ * Erases the pair associated with key, like hashmap_erase.
+ * @param map the concurrent hash map.
+ * @param key a key of the pair to be erased.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+int concurrent_hashmap_erase (concurrent_hashmap *map, const_keyT key){
+
+    if (map == NULL || key == NULL){
+        return false;
+    }
+
+    size_t hash = map->hash_func(key);
+    size_t i = stripe_of(map, hash);
+
+    pthread_rwlock_wrlock(&map->locks[i]);
+    int is_success = hashmap_erase_hashed(map->stripes[i], key, hash);
+    pthread_rwlock_unlock(&map->locks[i]);
+
+    return is_success;
+}
+
+/**
+ * Returns the number of pairs in the map. The stripes are counted one at a
+ * time, so with concurrent writers it is a snapshot of no single moment.
+ * @param map the concurrent hash map.
+ * @return the number of pairs, 0 for a NULL map.
+ */
+size_t concurrent_hashmap_size (const concurrent_hashmap *map){
+
+    size_t size = 0;
+
+    for (size_t i = 0; map != NULL && i < map->n_stripes; ++i) {
+        pthread_rwlock_rdlock(&map->locks[i]);
+        size += map->stripes[i]->size;
+        pthread_rwlock_unlock(&map->locks[i]);
+    }
+
+    return size;
+}
+
+/**
+ * Applies valT_func on the values whose keys fulfill keyT_func, like
+ * hashmap_apply_if, one stripe at a time under its exclusive lock.
+ * @param map the concurrent hash map.
+ * @param keyT_func a function that checks a condition on keyT and return 1 if true, 0 else
+ * @param valT_func a function that modifies valueT, in-place
+ * @return number of changed values
+ */
+int concurrent_hashmap_apply_if (concurrent_hashmap *map, keyT_func keyT_func,
+                                 valueT_func valT_func){
+
+    int changed_values = 0;
+
+    if (map == NULL || keyT_func == NULL || valT_func == NULL){
+        return changed_values;
+    }
+
+    for (size_t i = 0; i < map->n_stripes; ++i) {
+        pthread_rwlock_wrlock(&map->locks[i]);
+        changed_values += hashmap_apply_if(map->stripes[i], keyT_func,
+                                           valT_func);
+        pthread_rwlock_unlock(&map->locks[i]);
+    }
+
+    return changed_values;
+}
@@ -0,0 +1,114 @@
+#ifndef CONCURRENT_HASHMAP_H_
+#define CONCURRENT_HASHMAP_H_
+
+#include <pthread.h>
+#include "hashmap.h"
+
+/**
+ * @def CONCURRENT_HASHMAP_DEFAULT_STRIPES
+ * The number of stripes concurrent_hashmap_alloc uses when asked for 0.
+ */
+#define CONCURRENT_HASHMAP_DEFAULT_STRIPES 64UL
+
+/**
+ * @struct concurrent_hashmap
+ * A hash map many threads can use at once. The keys are split into stripes
+ * by the top bits of their hash, every stripe is a hash map of its own with
+ * its own read-write lock: lookups take the lock of their stripe shared,
+ * inserts and erases take it exclusive. A stripe grows and shrinks by
+ * itself, so a resize only blocks the keys of one stripe. Chaining stripes
+ * also rehash incrementally, so a resize never rebuilds a whole table under
+ * one lock.
+ * @param stripes the hash maps of the stripes.
+ * @param locks the locks of the stripes.
+ * @param n_stripes the number of stripes, a power of 2.
+ * @param stripe_shift the shift that takes a hash to its stripe.
+ * @param hash_func the hash function of the keys.
+ */
+typedef struct concurrent_hashmap {
+    hashmap **stripes;
+    pthread_rwlock_t *locks;
+    size_t n_stripes;
+    unsigned stripe_shift;
+    hash_func hash_func;
+} concurrent_hashmap;
+
+/**
+ * Allocates a new concurrent hash map. Allocating and freeing it are not
+ * thread safe, all the other functions are.
+ * @param func a function which "hashes" keys. Its top bits choose the
+ * stripe, so it should mix its keys (see hash_funcs.h).
+ * @param backend the storage engine of the stripes.
+ * @param n_stripes the number of stripes, rounded up to a power of 2. 0 for
+ * CONCURRENT_HASHMAP_DEFAULT_STRIPES. A few times the number of threads is
+ * a good choice.
+ * @return pointer to dynamically allocated concurrent_hashmap.
+ * @if_fail return NULL.
+ */
+concurrent_hashmap *concurrent_hashmap_alloc (hash_func func,
+                                              hashmap_backend backend,
+                                              size_t n_stripes);
+
+/**
+ * Frees a concurrent hash map and all its pairs. No other thread may use it
+ * meanwhile.
+ * @param p_map pointer to dynamically allocated pointer to the map.
+ */
+void concurrent_hashmap_free (concurrent_hashmap **p_map);
+
+/**
+ * Inserts a copy of in_pair, like hashmap_insert.
+ * @param map the concurrent hash map.
+ * @param in_pair a pair the map would contain.
+ * @return returns 1 for successful insertion, 0 otherwise.
+ */
+int concurrent_hashmap_insert (concurrent_hashmap *map, const pair *in_pair);
+
+/**
+ * Returns a copy of the value associated with the given key. Another thread
+ * may erase the pair at any time, so unlike hashmap_at the value itself is
+ * never handed out.
+ * @param map the concurrent hash map.
+ * @param key the key to be checked.
+ * @return a copy of the value (made by the value_cpy of the map's pairs),
+ * which the caller frees. NULL if key is not in the map.
+ */
+valueT concurrent_hashmap_at (const concurrent_hashmap *map, const_keyT key);
+
+/**
+ * Checks whether the key is in the map.
+ * @param map the concurrent hash map.
+ * @param key the key to be checked.
+ * @return 1 if it is, 0 otherwise.
+ */
+int concurrent_hashmap_contains (const concurrent_hashmap *map,
+                                 const_keyT key);
+
+/**
+ * Erases the pair associated with key, like hashmap_erase.
+ * @param map the concurrent hash map.
+ * @param key a key of the pair to be erased.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+int concurrent_hashmap_erase (concurrent_hashmap *map, const_keyT key);
+
+/**
+ * Returns the number of pairs in the map. The stripes are counted one at a
+ * time, so with concurrent writers it is a snapshot of no single moment.
+ * @param map the concurrent hash map.
+ * @return the number of pairs, 0 for a NULL map.
+ */
+size_t concurrent_hashmap_size (const concurrent_hashmap *map);
+
+/**
+ * Applies valT_func on the values whose keys fulfill keyT_func, like
+ * hashmap_apply_if, one stripe at a time under its exclusive lock.
+ * @param map the concurrent hash map.
+ * @param keyT_func a function that checks a condition on keyT and return 1 if true, 0 else
+ * @param valT_func a function that modifies valueT, in-place
+ * @return number of changed values
+ */
+int concurrent_hashmap_apply_if (concurrent_hashmap *map, keyT_func keyT_func,
+                                 valueT_func valT_func);
+
+#endif //CONCURRENT_HASHMAP_H_
@@ -0,0 +1,484 @@
+#include "hashmap_engine.h"
+#include "hash_funcs.h"
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * @def CUCKOO_SLOTS
+ * The number of slots of a bucket. A bucket (the hashes and the entries of
+ * its slots) fills one 64 byte cache line.
+ */
+#define CUCKOO_SLOTS 4
+
+/**
+ * @def CUCKOO_STASH_SIZE
+ * The number of pairs kept aside when no displacement path frees a slot.
+ */
+#define CUCKOO_STASH_SIZE 4
+
+/**
+ * @def CUCKOO_MAX_PATH_NODES
+ * The number of buckets the breadth first search for a displacement path
+ * may visit before giving up.
+ */
+#define CUCKOO_MAX_PATH_NODES 256
+
+/**
+ * @def CUCKOO_ALIGN
+ * The alignment of the buckets, the size of a cache line.
+ */
+#define CUCKOO_ALIGN 64UL
+
+/**
+ * @def CUCKOO_MAX_LOAD_FACTOR
+ * The highest max load factor a cuckoo hash map may be configured with.
+ * Four slot buckets still find displacement paths at it.
+ */
+#define CUCKOO_MAX_LOAD_FACTOR 0.95
+
+/**
+ * @struct cuckoo_bucket
+ * @param hashes the hashes of the pairs in the slots, compared before any
+ * entry is read.
+ * @param slots the entries of the slots, NULL for an empty slot.
+ */
+typedef struct cuckoo_bucket {
+    size_t hashes[CUCKOO_SLOTS];
+    entry *slots[CUCKOO_SLOTS];
+} cuckoo_bucket;
+
+/**
+ * @struct cuckoo_table
+ * The storage of a cuckoo hash map, allocated as one block: this header,
+ * then the buckets aligned to a cache line.
+ * @param n_buckets the number of buckets, a power of 2.
+ * @param stash_size the number of pairs in the stash.
+ * @param stash the pairs no displacement path found a slot for.
+ * @param buckets the buckets.
+ */
+struct cuckoo_table {
+    size_t n_buckets;
+    size_t stash_size;
+    entry *stash[CUCKOO_STASH_SIZE];
+    cuckoo_bucket *buckets;
+};
+
+/**
+ * @struct path_node
+ * A bucket reached by the search for a displacement path.
+ * @param bucket the index of the bucket.
+ * @param parent the node whose pair can move to this bucket, -1 for the two
+ * buckets of the new pair.
+ * @param slot the slot of that pair in the parent bucket.
+ */
+typedef struct path_node {
+    size_t bucket;
+    int parent;
+    int slot;
+} path_node;
+
+/**
+ * the two buckets a pair with the given hash may be in, from two
+ * independent mixes of the hash. They always differ.
+ */
+static void cuckoo_buckets_of(size_t hash, size_t n_buckets, size_t *first,
+                              size_t *second){
+    size_t mask = n_buckets - 1;
+    *first = (size_t) hash_mix64((uint64_t) hash) & mask;
+    *second = (size_t) hash_mix64((uint64_t) hash ^ HASH_SECRET_0) & mask;
+    if (*second == *first){
+        *second = *first ^ 1;
+    }
+}
+
+/**
+ * the bucket a pair with the given hash may be in, other than bucket.
+ */
+static size_t cuckoo_other_bucket(size_t hash, size_t n_buckets,
+                                  size_t bucket){
+    size_t first, second;
+    cuckoo_buckets_of(hash, n_buckets, &first, &second);
+    return bucket == first ? second : first;
+}
+
+/**
+ * the size of the block of a table with n_buckets buckets.
+ */
+static size_t cuckoo_table_size(size_t n_buckets){
+    return sizeof(cuckoo_table) + CUCKOO_ALIGN - 1 +
+           n_buckets * sizeof(cuckoo_bucket);
+}
+
+/**
+ * allocates an empty table of the given capacity from the hash map's
+ * allocator.
+ * @return the table, NULL on failure.
+ */
+static cuckoo_table *cuckoo_alloc_table(const hashmap *hash_map,
+                                        size_t capacity){
+    size_t n_buckets = capacity / CUCKOO_SLOTS;
+    cuckoo_table *table = allocator_calloc(&hash_map->mem, 1,
+                                           cuckoo_table_size(n_buckets));
+
+    if (table == NULL){
+        return NULL;
+    }
+
+    uintptr_t first = (uintptr_t) (table + 1);
+    table->buckets = (cuckoo_bucket *) ((first + CUCKOO_ALIGN - 1) &
+                                        ~(uintptr_t) (CUCKOO_ALIGN - 1));
+    table->n_buckets = n_buckets;
+    return table;
+}
+
+static void cuckoo_free_table(const hashmap *hash_map, cuckoo_table *table){
+    allocator_free(&hash_map->mem, table,
+                   cuckoo_table_size(table->n_buckets));
+}
+
+/**
+ * returns the first empty slot of a bucket, -1 if it is full.
+ */
+static int cuckoo_empty_slot(const cuckoo_bucket *bucket){
+    for (int i = 0; i < CUCKOO_SLOTS; ++i) {
+        if (bucket->slots[i] == NULL){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * searches breadth first for the shortest path of moves that frees a slot
+ * in one of the two buckets of hash: every pair on it moves to its other
+ * bucket.
+ * @param path the nodes of the search.
+ * @param last set to the node that has an empty slot.
+ * @return the empty slot of the last node, -1 if no path was found.
+ */
+static int cuckoo_search(const cuckoo_table *table, size_t hash,
+                         path_node *path, int *last){
+    size_t first, second;
+    cuckoo_buckets_of(hash, table->n_buckets, &first, &second);
+
+    path[0] = (path_node) {first, -1, -1};
+    path[1] = (path_node) {second, -1, -1};
+    int n_nodes = 2;
+
+    for (int cur = 0; cur < n_nodes; ++cur) {
+
+        const cuckoo_bucket *bucket = &table->buckets[path[cur].bucket];
+        int empty = cuckoo_empty_slot(bucket);
+
+        if (empty >= 0){
+            *last = cur;
+            return empty;
+        }
+
+        for (int i = 0; i < CUCKOO_SLOTS &&
+                        n_nodes < CUCKOO_MAX_PATH_NODES; ++i) {
+
+            size_t next = cuckoo_other_bucket(bucket->hashes[i],
+                                              table->n_buckets,
+                                              path[cur].bucket);
+
+            // a bucket is visited once, so the moves of a path never
+            // overlap.
+            int seen = false;
+            for (int j = 0; j < n_nodes && !seen; ++j) {
+                seen = path[j].bucket == next;
+            }
+
+            if (!seen){
+                path[n_nodes++] = (path_node) {next, cur, i};
+            }
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * places new_entry in one of its buckets, moving other pairs along a
+ * displacement path if needed, or in the stash.
+ * @return 1 on success, 0 if there is no path and the stash is full (the
+ * table is then left untouched).
+ */
+static int cuckoo_place(cuckoo_table *table, entry *new_entry){
+
+    path_node path[CUCKOO_MAX_PATH_NODES];
+    int node;
+    int empty = cuckoo_search(table, new_entry->hash, path, &node);
+
+    if (empty < 0){
+        if (table->stash_size == CUCKOO_STASH_SIZE){
+            return false;
+        }
+        table->stash[table->stash_size++] = new_entry;
+        return true;
+    }
+
+    // move the pairs from the end of the path back, every move frees the
+    // slot the one before it moves into.
+    for (; path[node].parent >= 0; node = path[node].parent) {
+        cuckoo_bucket *to = &table->buckets[path[node].bucket];
+        cuckoo_bucket *from = &table->buckets[path[path[node].parent].bucket];
+        to->hashes[empty] = from->hashes[path[node].slot];
+        to->slots[empty] = from->slots[path[node].slot];
+        empty = path[node].slot;
+    }
+
+    cuckoo_bucket *bucket = &table->buckets[path[node].bucket];
+    bucket->hashes[empty] = new_entry->hash;
+    bucket->slots[empty] = new_entry;
+    return true;
+}
+
+static int cuckoo_init(hashmap *hash_map){
+    hash_map->cuckoo = cuckoo_alloc_table(hash_map, hash_map->capacity);
+    return hash_map->cuckoo != NULL;
+}
+
+static void cuckoo_destroy(hashmap *hash_map){
+    cuckoo_table *table = hash_map->cuckoo;
+
+    for (size_t b = 0; b < table->n_buckets; ++b) {
+        for (int i = 0; i < CUCKOO_SLOTS; ++i) {
+            if (table->buckets[b].slots[i] != NULL){
+                entry_free(&table->buckets[b].slots[i], &hash_map->ops,
+                           &hash_map->mem);
+            }
+        }
+    }
+    for (size_t i = 0; i < table->stash_size; ++i) {
+        entry_free(&table->stash[i], &hash_map->ops, &hash_map->mem);
+    }
+
+    cuckoo_free_table(hash_map, table);
+    hash_map->cuckoo = NULL;
+}
+
+/**
+ * looks for the key in one bucket.
+ * @return its slot, NULL if it is not there.
+ */
+static entry **cuckoo_find_in(const hashmap *hash_map, cuckoo_bucket *bucket,
+                              size_t hash, engine_key_match match,
+                              const void *key, size_t len){
+    for (int i = 0; i < CUCKOO_SLOTS; ++i) {
+        if (bucket->hashes[i] == hash && bucket->slots[i] != NULL &&
+            match(hash_map, bucket->slots[i]->key, key, len)){
+            return &bucket->slots[i];
+        }
+    }
+    return NULL;
+}
+
+static entry **cuckoo_lookup(const hashmap *hash_map, size_t hash,
+                             engine_key_match match, const void *key,
+                             size_t len){
+
+    cuckoo_table *table = hash_map->cuckoo;
+    size_t first, second;
+    cuckoo_buckets_of(hash, table->n_buckets, &first, &second);
+
+    // a pair is only ever in one of its two buckets (one cache line each),
+    // or in the stash, which is almost always empty.
+    entry **slot = cuckoo_find_in(hash_map, &table->buckets[first], hash,
+                                  match, key, len);
+    if (slot == NULL){
+        slot = cuckoo_find_in(hash_map, &table->buckets[second], hash, match,
+                              key, len);
+    }
+
+    for (size_t i = 0; slot == NULL && i < table->stash_size; ++i) {
+        if (table->stash[i]->hash == hash &&
+            match(hash_map, table->stash[i]->key, key, len)){
+            slot = &table->stash[i];
+        }
+    }
+
+    return slot;
+}
+
+static entry **cuckoo_find(const hashmap *hash_map, size_t hash,
+                           const_keyT key){
+    return cuckoo_lookup(hash_map, hash, engine_match_key, key, 0);
+}
+
+static entry **cuckoo_find_bytes(const hashmap *hash_map, size_t hash,
+                                 const void *bytes, size_t len){
+    return cuckoo_lookup(hash_map, hash, engine_match_bytes, bytes, len);
+}
+
+static int cuckoo_rehash(hashmap *hash_map, size_t new_capacity){
+
+    cuckoo_table *table = hash_map->cuckoo;
+    cuckoo_table *new_table = cuckoo_alloc_table(hash_map, new_capacity);
+
+    if (new_table == NULL){
+        return false;
+    }
+
+    int is_success = true;
+
+    for (size_t b = 0; b < table->n_buckets && is_success; ++b) {
+        for (int i = 0; i < CUCKOO_SLOTS && is_success; ++i) {
+            entry *cur_entry = table->buckets[b].slots[i];
+            is_success = cur_entry == NULL ||
+                         cuckoo_place(new_table, cur_entry);
+        }
+    }
+    for (size_t i = 0; i < table->stash_size && is_success; ++i) {
+        is_success = cuckoo_place(new_table, table->stash[i]);
+    }
+
+    // the entries are only pointed to by the new table, so dropping it
+    // leaves the old one as it was.
+    if (!is_success){
+        cuckoo_free_table(hash_map, new_table);
+        return false;
+    }
+
+    cuckoo_free_table(hash_map, table);
+    hash_map->cuckoo = new_table;
+    hash_map->capacity = new_capacity;
+
+    return true;
+}
+
+static int cuckoo_insert(hashmap *hash_map, size_t hash, entry *new_entry){
+
+    (void) hash;
+
+    // no displacement path and a full stash: the hash map grows and tries
+    // again.
+    return cuckoo_place(hash_map->cuckoo, new_entry);
+}
+
+static entry *cuckoo_erase(hashmap *hash_map, entry **slot){
+
+    cuckoo_table *table = hash_map->cuckoo;
+    entry *old_entry = *slot;
+
+    if (slot >= table->stash && slot < table->stash + table->stash_size){
+        *slot = table->stash[--table->stash_size];
+        return old_entry;
+    }
+
+    *slot = NULL;
+
+    // the freed slot may take a stashed pair back.
+    size_t b = (size_t) ((char *) slot - (char *) table->buckets) /
+               sizeof(cuckoo_bucket);
+
+    for (size_t i = 0; i < table->stash_size; ++i) {
+        size_t first, second;
+        cuckoo_buckets_of(table->stash[i]->hash, table->n_buckets, &first,
+                          &second);
+        if (first == b || second == b){
+            int empty = (int) (slot - table->buckets[b].slots);
+            table->buckets[b].hashes[empty] = table->stash[i]->hash;
+            table->buckets[b].slots[empty] = table->stash[i];
+            table->stash[i] = table->stash[--table->stash_size];
+            break;
+        }
+    }
+
+    return old_entry;
+}
+
+/**
+ * the slots of the buckets, then the stash.
+ */
+static size_t cuckoo_positions(const hashmap *hash_map){
+    return hash_map->capacity + hash_map->cuckoo->stash_size;
+}
+
+static entry **cuckoo_next(const hashmap *hash_map, hashmap_cursor *cursor){
+
+    cuckoo_table *table = hash_map->cuckoo;
+    size_t end = cursor->end != 0 ? cursor->end : cuckoo_positions(hash_map);
+
+    for (; cursor->bucket < end; ++cursor->bucket) {
+
+        entry **slot;
+        if (cursor->bucket < hash_map->capacity){
+            slot = &table->buckets[cursor->bucket / CUCKOO_SLOTS].slots[
+                    cursor->bucket % CUCKOO_SLOTS];
+        }
+        else if (cursor->bucket - hash_map->capacity < table->stash_size){
+            slot = &table->stash[cursor->bucket - hash_map->capacity];
+        }
+        else {
+            break;
+        }
+
+        if (*slot != NULL){
+            cursor->bucket += 1;
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * erasing a bucket slot may pull a stashed pair into it, erasing from the
+ * stash moves its last pair into the erased place.
+ */
+static void cuckoo_erased(const hashmap *hash_map, hashmap_cursor *cursor){
+    (void) hash_map;
+    cursor->bucket -= 1;
+}
+
+/**
+ * level 0 both buckets, 1 the entries of the first bucket whose hash
+ * matches, 2 their keys. level 3 has nothing left to prefetch.
+ */
+static void cuckoo_prefetch(const hashmap *hash_map, size_t hash, int level){
+
+    cuckoo_table *table = hash_map->cuckoo;
+    size_t first, second;
+    cuckoo_buckets_of(hash, table->n_buckets, &first, &second);
+
+    if (level == 0){
+        HASHMAP_PREFETCH(&table->buckets[first]);
+        HASHMAP_PREFETCH(&table->buckets[second]);
+        return;
+    }
+
+    if (level > 2){
+        return;
+    }
+
+    const cuckoo_bucket *bucket = &table->buckets[first];
+    for (int i = 0; i < CUCKOO_SLOTS; ++i) {
+        if (bucket->hashes[i] == hash && bucket->slots[i] != NULL){
+            if (level == 1){
+                HASHMAP_PREFETCH(bucket->slots[i]);
+            }
+            else {
+                HASHMAP_PREFETCH(bucket->slots[i]->key);
+            }
+        }
+    }
+}
+
+const hashmap_engine cuckoo_engine = {
+    2 * CUCKOO_SLOTS,
+    CUCKOO_MAX_LOAD_FACTOR,
+    cuckoo_init,
+    cuckoo_destroy,
+    cuckoo_find,
+    cuckoo_find_bytes,
+    cuckoo_insert,
+    cuckoo_erase,
+    cuckoo_rehash,
+    cuckoo_next,
+    NULL,
+    cuckoo_prefetch,
+    NULL,
+    cuckoo_erased,
+    cuckoo_positions
+};
@@ -0,0 +1,166 @@
+#include "entry.h"
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * rounds n up to a multiple of ENTRY_INLINE_ALIGN.
+ */
+static size_t inline_align(size_t n){
+    return (n + ENTRY_INLINE_ALIGN - 1) & ~(ENTRY_INLINE_ALIGN - 1);
+}
+
+/**
+ * whether object is stored inside the inline bytes of cur_entry.
+ */
+static int is_inline(const entry *cur_entry, const void *object,
+                     size_t inline_size){
+    return (uintptr_t) object - (uintptr_t) cur_entry->data < inline_size;
+}
+
+/**
+ * The number of bytes of every entry of the given functions.
+ * @param ops the functions of the key and the value.
+ */
+size_t entry_size (const pair_ops *ops){
+    return sizeof(entry) + inline_align(ops->inline_size);
+}
+
+/**
+ * Allocates a new entry holding copies of the given key and value.
+ * @param ops the functions of the key and the value.
+ * @param mem the allocator of the entry (NULL for malloc).
+ * @param key, value the key and value to copy.
+ * @param hash the hash of the key.
+ * @return the entry, NULL on failure.
+ */
+entry *entry_alloc (const pair_ops *ops, const allocator *mem,
+                    const_keyT key, const_valueT value, size_t hash){
+
+    entry *new_entry = allocator_malloc(mem, entry_size(ops));
+
+    if (new_entry == NULL){
+        return NULL;
+    }
+
+    // the key takes the inline bytes first, the value what is left of them.
+    size_t used = 0;
+    size_t key_size = ops->key_size == NULL ? SIZE_MAX : ops->key_size(key);
+
+    if (ops->inline_size > 0 && key_size <= ops->inline_size){
+        memcpy(new_entry->data, key, key_size);
+        new_entry->key = new_entry->data;
+        used = inline_align(key_size);
+    }
+    else {
+        new_entry->key = ops->key_cpy(key);
+        if (new_entry->key == NULL){
+            allocator_free(mem, new_entry, entry_size(ops));
+            return NULL;
+        }
+    }
+
+    size_t value_size = ops->value_size == NULL ? SIZE_MAX :
+                        ops->value_size(value);
+
+    if (used < ops->inline_size && value_size <= ops->inline_size - used){
+        memcpy(new_entry->data + used, value, value_size);
+        new_entry->value = new_entry->data + used;
+    }
+    else {
+        new_entry->value = ops->value_cpy(value);
+        if (new_entry->value == NULL){
+            if (!is_inline(new_entry, new_entry->key, ops->inline_size)){
+                ops->key_free(&new_entry->key);
+            }
+            allocator_free(mem, new_entry, entry_size(ops));
+            return NULL;
+        }
+    }
+
+    new_entry->hash = hash;
+    return new_entry;
+}
+
+/**
+ * Allocates a new entry around the given key and value, without copying
+ * them (so not inline either). The entry owns them from now on.
+ * @param ops the functions of the key and the value.
+ * @param mem the allocator of the entry (NULL for malloc).
+ * @param key, value the key and value to adopt.
+ * @param hash the hash of the key.
+ * @return the entry, NULL on failure (then the caller still owns them).
+ */
+entry *entry_adopt (const pair_ops *ops, const allocator *mem, keyT key,
+                    valueT value, size_t hash){
+
+    entry *new_entry = allocator_malloc(mem, entry_size(ops));
+
+    if (new_entry == NULL){
+        return NULL;
+    }
+
+    new_entry->key = key;
+    new_entry->value = value;
+    new_entry->hash = hash;
+    return new_entry;
+}
+
+/**
+ * Replaces the value of an entry with a copy of the given one, inline if
+ * it fits where the old value could have been.
+ * @param cur_entry an entry.
+ * @param ops the functions of the key and the value.
+ * @param value the value to copy.
+ * @return 1 on success, 0 otherwise (then the entry keeps its old value).
+ */
+int entry_assign (entry *cur_entry, const pair_ops *ops, const_valueT value){
+
+    size_t used = is_inline(cur_entry, cur_entry->key, ops->inline_size) ?
+                  inline_align(ops->key_size(cur_entry->key)) : 0;
+    size_t value_size = ops->value_size == NULL ? SIZE_MAX :
+                        ops->value_size(value);
+    int fits = used < ops->inline_size &&
+               value_size <= ops->inline_size - used;
+
+    valueT new_value = fits ? NULL : ops->value_cpy(value);
+    if (!fits && new_value == NULL){
+        return 0;
+    }
+
+    // value may be the old value itself, so it is copied before the old
+    // value is freed.
+    if (fits){
+        memmove(cur_entry->data + used, value, value_size);
+        new_value = cur_entry->data + used;
+    }
+
+    if (!is_inline(cur_entry, cur_entry->value, ops->inline_size)){
+        ops->value_free(&cur_entry->value);
+    }
+    cur_entry->value = new_value;
+    return 1;
+}
+
+/**
+ * Frees an entry, its key and its value.
+ * @param p_entry pointer to the entry to be freed.
+ * @param ops the functions of the key and the value.
+ * @param mem the allocator of the entry (NULL for malloc).
+ */
+void entry_free (entry **p_entry, const pair_ops *ops, const allocator *mem){
+
+    if (p_entry == NULL || *p_entry == NULL){
+        return;
+    }
+
+    // inline keys and values go away with the entry itself.
+    entry *cur_entry = *p_entry;
+    if (!is_inline(cur_entry, cur_entry->key, ops->inline_size)){
+        ops->key_free(&cur_entry->key);
+    }
+    if (!is_inline(cur_entry, cur_entry->value, ops->inline_size)){
+        ops->value_free(&cur_entry->value);
+    }
+    allocator_free(mem, cur_entry, entry_size(ops));
+    *p_entry = NULL;
+}
@@ -0,0 +1,90 @@
+#ifndef ENTRY_H_
+#define ENTRY_H_
+
+#include <stdlib.h>
+#include "pair.h"
+#include "allocator.h"
+
+/**
+ * @def ENTRY_INLINE_SIZE
+ * A good inline_size for pair_ops of small keys and values, e.g. a char key
+ * and an int value, or a short string key and a double value.
+ */
+#define ENTRY_INLINE_SIZE 16UL
+
+/**
+ * @def ENTRY_INLINE_ALIGN
+ * The alignment of keys and values stored inline.
+ */
+#define ENTRY_INLINE_ALIGN sizeof(size_t)
+
+/**
+ * @struct entry - a pair as a hash map stores it: the key, the value, and
+ * the cached hash of the key. The functions of the key and the value are
+ * kept once per hash map, in its pair_ops.
+ *
+ * When the pair_ops have an inline_size, every entry is followed by that
+ * many bytes, and a key (or value) whose key_size (or value_size) fits in
+ * what is left of them is copied there byte by byte, instead of by key_cpy
+ * into a block of its own. key and value then point inside the entry, so a
+ * lookup reads the key from the same block as the hash. Bigger keys and
+ * values are copied to the heap as usual.
+ * @param key, value - the key and value, owned by the entry.
+ * @param hash - the full hash of the key.
+ * @param data - the inline_size bytes of inline keys and values.
+ */
+typedef struct entry {
+    keyT key;
+    valueT value;
+    size_t hash;
+    unsigned char data[];
+} entry;
+
+/**
+ * The number of bytes of every entry of the given functions.
+ * @param ops the functions of the key and the value.
+ */
+size_t entry_size (const pair_ops *ops);
+
+/**
+ * Allocates a new entry holding copies of the given key and value.
+ * @param ops the functions of the key and the value.
+ * @param mem the allocator of the entry (NULL for malloc).
+ * @param key, value the key and value to copy.
+ * @param hash the hash of the key.
+ * @return the entry, NULL on failure.
+ */
+entry *entry_alloc (const pair_ops *ops, const allocator *mem,
+                    const_keyT key, const_valueT value, size_t hash);
+
+/**
+ * Allocates a new entry around the given key and value, without copying
+ * them (so not inline either). The entry owns them from now on.
+ * @param ops the functions of the key and the value.
+ * @param mem the allocator of the entry (NULL for malloc).
+ * @param key, value the key and value to adopt.
+ * @param hash the hash of the key.
+ * @return the entry, NULL on failure (then the caller still owns them).
+ */
+entry *entry_adopt (const pair_ops *ops, const allocator *mem, keyT key,
+                    valueT value, size_t hash);
+
+/**
+ * Replaces the value of an entry with a copy of the given one, inline if
+ * it fits where the old value could have been.
+ * @param cur_entry an entry.
+ * @param ops the functions of the key and the value.
+ * @param value the value to copy.
+ * @return 1 on success, 0 otherwise (then the entry keeps its old value).
+ */
+int entry_assign (entry *cur_entry, const pair_ops *ops, const_valueT value);
+
+/**
+ * Frees an entry, its key and its value.
+ * @param p_entry pointer to the entry to be freed.
+ * @param ops the functions of the key and the value.
+ * @param mem the allocator of the entry (NULL for malloc).
+ */
+void entry_free (entry **p_entry, const pair_ops *ops, const allocator *mem);
+
+#endif //ENTRY_H_
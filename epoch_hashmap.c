@@ -0,0 +1,495 @@
+#include "epoch_hashmap.h"
+#include <stdbool.h>
+
+/**
+ * the kinds of garbage.
+ * GARBAGE_NODE - an erased node and its entry.
+ * GARBAGE_TABLE - a replaced table and its nodes (their entries moved to the
+ * new table).
+ */
+typedef enum garbage_kind {
+    GARBAGE_NODE,
+    GARBAGE_TABLE
+} garbage_kind;
+
+struct epoch_garbage {
+    epoch_garbage *next;
+    uint64_t epoch;
+    garbage_kind kind;
+    void *ptr;
+};
+
+/**
+ * allocates an empty table.
+ * @return the table, NULL on failure.
+ */
+static epoch_table *table_alloc(size_t capacity){
+
+    epoch_table *table = malloc(sizeof(epoch_table) +
+                                capacity * sizeof(_Atomic(epoch_node *)));
+
+    if (table == NULL){
+        return NULL;
+    }
+
+    table->capacity = capacity;
+    for (size_t i = 0; i < capacity; ++i) {
+        atomic_init(&table->buckets[i], NULL);
+    }
+    return table;
+}
+
+/**
+ * frees a table and its nodes. Their entries are freed too if ops is not
+ * NULL.
+ */
+static void table_free(epoch_table *table, const pair_ops *ops){
+
+    for (size_t i = 0; i < table->capacity; ++i) {
+        epoch_node *node = atomic_load_explicit(&table->buckets[i],
+                                                memory_order_relaxed);
+        while (node != NULL) {
+            epoch_node *next = atomic_load_explicit(&node->next,
+                                                    memory_order_relaxed);
+            if (ops != NULL){
+                entry_free(&node->item, ops, NULL);
+            }
+            free(node);
+            node = next;
+        }
+    }
+    free(table);
+}
+
+/**
+ * frees one piece of garbage.
+ */
+static void garbage_free(epoch_hashmap *map, epoch_garbage *garbage){
+
+    if (garbage->kind == GARBAGE_NODE){
+        epoch_node *node = garbage->ptr;
+        entry_free(&node->item, &map->ops, NULL);
+        free(node);
+    }
+    else {
+        table_free(garbage->ptr, NULL);
+    }
+    free(garbage);
+}
+
+/**
+ * frees the garbage no reader can see anymore: the garbage retired before
+ * the epoch of every reader inside a read section. Called by writers.
+ */
+static void collect(epoch_hashmap *map){
+
+    // pairs with the fence of epoch_hashmap_enter: either this sees the
+    // epoch of a reader, or the reader sees every unlink made before.
+    atomic_thread_fence(memory_order_seq_cst);
+
+    uint64_t min_epoch = UINT64_MAX;
+    for (epoch_reader *reader = map->readers; reader != NULL;
+         reader = reader->next) {
+        uint64_t epoch = atomic_load(&reader->epoch);
+        if (epoch != 0 && epoch < min_epoch){
+            min_epoch = epoch;
+        }
+    }
+
+    epoch_garbage **link = &map->garbage;
+    while (*link != NULL) {
+        epoch_garbage *garbage = *link;
+        if (garbage->epoch < min_epoch){
+            *link = garbage->next;
+            garbage_free(map, garbage);
+        }
+        else {
+            link = &garbage->next;
+        }
+    }
+}
+
+/**
+ * retires a piece of garbage that was already unlinked, and moves to the
+ * next epoch: readers that enter from now on can't reach it.
+ */
+static void retire(epoch_hashmap *map, epoch_garbage *garbage,
+                   garbage_kind kind, void *ptr){
+    garbage->kind = kind;
+    garbage->ptr = ptr;
+    garbage->epoch = atomic_fetch_add(&map->epoch, 1);
+    garbage->next = map->garbage;
+    map->garbage = garbage;
+}
+
+/**
+ * Allocates a new epoch hash map.
+ * @param func a function which "hashes" keys.
+ * @param ops the functions of the keys and the values, NULL to take them
+ * from the first pair inserted.
+ * @return pointer to dynamically allocated epoch_hashmap.
+ * @if_fail return NULL.
+ */
+epoch_hashmap *epoch_hashmap_alloc (hash_func func, const pair_ops *ops){
+
+    if (func == NULL){
+        return NULL;
+    }
+
+    epoch_hashmap *map = calloc(1, sizeof(epoch_hashmap));
+
+    if (map == NULL){
+        return NULL;
+    }
+
+    epoch_table *table = table_alloc(HASH_MAP_INITIAL_CAP);
+
+    if (table == NULL || pthread_mutex_init(&map->writer, NULL) != 0){
+        free(table);
+        free(map);
+        return NULL;
+    }
+
+    atomic_init(&map->table, table);
+    atomic_init(&map->epoch, 1);
+    map->hash_func = func;
+    if (ops != NULL){
+        map->ops = *ops;
+        map->has_ops = true;
+    }
+    return map;
+}
+
+/**
+ * Frees an epoch hash map and all its pairs. No other thread may use it
+ * meanwhile, its readers are freed too.
+ * @param p_map pointer to dynamically allocated pointer to the map.
+ */
+void epoch_hashmap_free (epoch_hashmap **p_map){
+
+    if (p_map == NULL || *p_map == NULL){
+        return;
+    }
+
+    epoch_hashmap *map = *p_map;
+
+    while (map->garbage != NULL) {
+        epoch_garbage *next = map->garbage->next;
+        garbage_free(map, map->garbage);
+        map->garbage = next;
+    }
+
+    while (map->readers != NULL) {
+        epoch_reader *next = map->readers->next;
+        free(map->readers);
+        map->readers = next;
+    }
+
+    table_free(atomic_load(&map->table), &map->ops);
+    pthread_mutex_destroy(&map->writer);
+    free(map);
+    *p_map = NULL;
+}
+
+/**
+ * Registers the calling thread as a reader of the map.
+ * @param map the epoch hash map.
+ * @return the registration, used by one thread only.
+ * @if_fail return NULL.
+ */
+epoch_reader *epoch_hashmap_register (epoch_hashmap *map){
+
+    if (map == NULL){
+        return NULL;
+    }
+
+    pthread_mutex_lock(&map->writer);
+
+    epoch_reader *reader = map->readers;
+    while (reader != NULL && reader->in_use) {
+        reader = reader->next;
+    }
+
+    if (reader == NULL){
+        reader = malloc(sizeof(epoch_reader));
+        if (reader != NULL){
+            atomic_init(&reader->epoch, 0);
+            reader->global = &map->epoch;
+            reader->next = map->readers;
+            map->readers = reader;
+        }
+    }
+
+    if (reader != NULL){
+        reader->in_use = true;
+    }
+
+    pthread_mutex_unlock(&map->writer);
+    return reader;
+}
+
+/**
+ * Gives a registration back. The reader must be outside a read section.
+ * @param map the epoch hash map.
+ * @param reader a registration of the map.
+ */
+void epoch_hashmap_unregister (epoch_hashmap *map, epoch_reader *reader){
+
+    if (map == NULL || reader == NULL){
+        return;
+    }
+
+    pthread_mutex_lock(&map->writer);
+    reader->in_use = false;
+    pthread_mutex_unlock(&map->writer);
+}
+
+/**
+ * Starts a read section. Nothing the reader sees in it is freed before
+ * epoch_hashmap_exit. Wait-free.
+ * @param reader the registration of the calling thread.
+ */
+void epoch_hashmap_enter (epoch_reader *reader){
+
+    uint64_t epoch = atomic_load(reader->global);
+    atomic_store_explicit(&reader->epoch, epoch, memory_order_relaxed);
+
+    // pairs with the fence of collect: either the writer sees this epoch,
+    // or this reader sees every unlink made before the writer collected.
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+/**
+ * Ends a read section.
+ * @param reader the registration of the calling thread.
+ */
+void epoch_hashmap_exit (epoch_reader *reader){
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+}
+
+/**
+ * Returns the value associated with the given key. Call it inside a read
+ * section, with no lock: it is wait-free.
+ * @param map the epoch hash map.
+ * @param key the key to be checked.
+ * @return the value (the stored one, valid until the end of the read
+ * section, not to be modified), NULL if key is not in the map.
+ */
+valueT epoch_hashmap_at (const epoch_hashmap *map, const_keyT key){
+
+    if (map == NULL || key == NULL){
+        return NULL;
+    }
+
+    size_t hash = map->hash_func(key);
+    epoch_table *table = atomic_load_explicit(
+            &((epoch_hashmap *) map)->table, memory_order_acquire);
+    epoch_node *node = atomic_load_explicit(
+            &table->buckets[hash & (table->capacity - 1)],
+            memory_order_acquire);
+
+    // the ops were set before the first node was published.
+    for (; node != NULL; node = atomic_load_explicit(&node->next,
+                                                     memory_order_acquire)) {
+        if (node->item->hash == hash &&
+            map->ops.key_cmp(node->item->key, key) == true){
+            return node->item->value;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * finds the link pointing to the node of the key in the current table.
+ * Called by writers.
+ * @return the link, or the link at the end of the bucket list if the key is
+ * not in the map (then it points to NULL).
+ */
+static _Atomic(epoch_node *) *find_link(epoch_hashmap *map, size_t hash,
+                                        const_keyT key){
+
+    epoch_table *table = atomic_load_explicit(&map->table,
+                                              memory_order_relaxed);
+    _Atomic(epoch_node *) *link = &table->buckets[hash &
+                                                  (table->capacity - 1)];
+    epoch_node *node;
+
+    while ((node = atomic_load_explicit(link, memory_order_relaxed)) != NULL) {
+        if (node->item->hash == hash &&
+            map->ops.key_cmp(node->item->key, key) == true){
+            return link;
+        }
+        link = &node->next;
+    }
+
+    return link;
+}
+
+/**
+ * publishes a copy of the current table with new_capacity buckets, and
+ * retires the current one. Called by writers.
+ * @return 1 on success, 0 otherwise (then the map is left untouched).
+ */
+static int resize(epoch_hashmap *map, size_t new_capacity){
+
+    epoch_table *old_table = atomic_load_explicit(&map->table,
+                                                  memory_order_relaxed);
+    epoch_table *new_table = table_alloc(new_capacity);
+    epoch_garbage *garbage = malloc(sizeof(epoch_garbage));
+
+    if (new_table == NULL || garbage == NULL){
+        free(new_table);
+        free(garbage);
+        return false;
+    }
+
+    // readers may be walking the old nodes, so they are copied, not moved.
+    for (size_t i = 0; i < old_table->capacity; ++i) {
+        epoch_node *node = atomic_load_explicit(&old_table->buckets[i],
+                                                memory_order_relaxed);
+        for (; node != NULL; node = atomic_load_explicit(
+                &node->next, memory_order_relaxed)) {
+
+            epoch_node *copy = malloc(sizeof(epoch_node));
+            if (copy == NULL){
+                table_free(new_table, NULL);
+                free(garbage);
+                return false;
+            }
+
+            _Atomic(epoch_node *) *head =
+                    &new_table->buckets[node->item->hash &
+                                        (new_capacity - 1)];
+            copy->item = node->item;
+            atomic_init(&copy->next, atomic_load_explicit(
+                    head, memory_order_relaxed));
+            atomic_init(head, copy);
+        }
+    }
+
+    atomic_store_explicit(&map->table, new_table, memory_order_release);
+    retire(map, garbage, GARBAGE_TABLE, old_table);
+    return true;
+}
+
+/**
+ * Inserts a copy of in_pair, like hashmap_insert. Writers take turns.
+ * @param map the epoch hash map.
+ * @param in_pair a pair the map would contain.
+ * @return returns 1 for successful insertion, 0 otherwise.
+ */
+int epoch_hashmap_insert (epoch_hashmap *map, const pair *in_pair){
+
+    if (map == NULL || in_pair == NULL){
+        return false;
+    }
+
+    pthread_mutex_lock(&map->writer);
+
+    if (!map->has_ops){
+        map->ops = pair_get_ops(in_pair);
+        map->has_ops = true;
+    }
+
+    size_t hash = map->hash_func(in_pair->key);
+    _Atomic(epoch_node *) *link = find_link(map, hash, in_pair->key);
+    int is_success = false;
+
+    if (atomic_load_explicit(link, memory_order_relaxed) == NULL){
+
+        epoch_node *node = malloc(sizeof(epoch_node));
+        entry *item = entry_alloc(&map->ops, NULL, in_pair->key,
+                                  in_pair->value, hash);
+
+        if (node != NULL && item != NULL){
+
+            // the node is complete before the release store publishes it.
+            node->item = item;
+            atomic_init(&node->next, NULL);
+            atomic_store_explicit(link, node, memory_order_release);
+            map->size += 1;
+            is_success = true;
+
+            epoch_table *table = atomic_load_explicit(&map->table,
+                                                      memory_order_relaxed);
+            if ((double) map->size / (double) table->capacity >
+                HASH_MAP_MAX_LOAD_FACTOR){
+
+                // a failed resize only leaves the table fuller.
+                resize(map, table->capacity * HASH_MAP_GROWTH_FACTOR);
+            }
+        }
+        else {
+            free(node);
+            entry_free(&item, &map->ops, NULL);
+        }
+    }
+
+    collect(map);
+    pthread_mutex_unlock(&map->writer);
+    return is_success;
+}
+
+/**
+ * Erases the pair associated with key, like hashmap_erase. The pair is
+ * freed once no read section can see it anymore.
+ * @param map the epoch hash map.
+ * @param key a key of the pair to be erased.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+int epoch_hashmap_erase (epoch_hashmap *map, const_keyT key){
+
+    if (map == NULL || key == NULL){
+        return false;
+    }
+
+    pthread_mutex_lock(&map->writer);
+
+    size_t hash = map->hash_func(key);
+    _Atomic(epoch_node *) *link = find_link(map, hash, key);
+    epoch_node *node = atomic_load_explicit(link, memory_order_relaxed);
+    epoch_garbage *garbage = node == NULL ? NULL :
+            malloc(sizeof(epoch_garbage));
+    int is_success = false;
+
+    if (garbage != NULL){
+
+        // readers that already reached the node keep walking from it.
+        atomic_store_explicit(
+                link, atomic_load_explicit(&node->next, memory_order_relaxed),
+                memory_order_release);
+        retire(map, garbage, GARBAGE_NODE, node);
+        map->size -= 1;
+        is_success = true;
+
+        epoch_table *table = atomic_load_explicit(&map->table,
+                                                  memory_order_relaxed);
+        if ((double) map->size / (double) table->capacity <
+            HASH_MAP_MIN_LOAD_FACTOR &&
+            table->capacity / HASH_MAP_GROWTH_FACTOR >= HASH_MAP_INITIAL_CAP){
+            resize(map, table->capacity / HASH_MAP_GROWTH_FACTOR);
+        }
+    }
+
+    collect(map);
+    pthread_mutex_unlock(&map->writer);
+    return is_success;
+}
+
+/**
+ * Returns the number of pairs in the map.
+ * @param map the epoch hash map.
+ * @return the number of pairs, 0 for a NULL map.
+ */
+size_t epoch_hashmap_size (epoch_hashmap *map){
+
+    if (map == NULL){
+        return 0;
+    }
+
+    pthread_mutex_lock(&map->writer);
+    size_t size = map->size;
+    pthread_mutex_unlock(&map->writer);
+    return size;
+}
@@ -0,0 +1,178 @@
+#ifndef EPOCH_HASHMAP_H_
+#define EPOCH_HASHMAP_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "hashmap.h"
+
+/**
+ * @file
+ * A hash map for read-mostly tables: lookups take no lock and never wait,
+ * writers take a mutex among themselves.
+ *
+ * Every bucket is a linked list of nodes. Writers publish a node with one
+ * release store (to the head of its bucket, or to the next pointer of its
+ * predecessor on erase), and a resize publishes a whole new table with one
+ * release store, so a reader always walks a consistent list.
+ *
+ * A node (or table) that was unlinked is not freed right away: a reader may
+ * still be walking it. It is retired with the current epoch, and freed once
+ * every reader inside a read section entered it at a later epoch
+ * (epoch-based reclamation).
+ *
+ * Usage, in every reading thread:
+ *   epoch_reader *reader = epoch_hashmap_register(map);
+ *   epoch_hashmap_enter(reader);
+ *   valueT value = epoch_hashmap_at(map, key); // valid until exit
+ *   epoch_hashmap_exit(reader);
+ *   ...
+ *   epoch_hashmap_unregister(map, reader);
+ */
+
+/**
+ * @struct epoch_node
+ * a link of a bucket list.
+ * @param next the next node of the bucket.
+ * @param item the entry of the node.
+ */
+typedef struct epoch_node {
+    _Atomic(struct epoch_node *) next;
+    entry *item;
+} epoch_node;
+
+/**
+ * @struct epoch_table
+ * @param capacity the number of buckets, a power of 2.
+ * @param buckets the heads of the bucket lists.
+ */
+typedef struct epoch_table {
+    size_t capacity;
+    _Atomic(epoch_node *) buckets[];
+} epoch_table;
+
+/**
+ * @struct epoch_reader
+ * the registration of a reading thread.
+ * @param epoch the epoch the thread entered its read section at, 0 outside
+ * of read sections.
+ * @param global the global epoch of the map.
+ * @param next the next registration of the map.
+ * @param in_use 0 once unregistered, the registration is then reused.
+ */
+typedef struct epoch_reader {
+    _Atomic uint64_t epoch;
+    _Atomic uint64_t *global;
+    struct epoch_reader *next;
+    int in_use;
+} epoch_reader;
+
+/**
+ * @struct epoch_garbage
+ * a node, an entry or a table waiting for the readers to leave it.
+ */
+typedef struct epoch_garbage epoch_garbage;
+
+/**
+ * @struct epoch_hashmap
+ * @param table the current table.
+ * @param epoch the global epoch, starts at 1.
+ * @param size the number of pairs stored in the map.
+ * @param hash_func the hash function of the keys.
+ * @param ops the functions of the keys and the values.
+ * @param has_ops 0 until ops is known.
+ * @param writer the mutex of the writers.
+ * @param readers the registrations of the readers.
+ * @param garbage what was retired and is not freed yet.
+ */
+typedef struct epoch_hashmap {
+    _Atomic(epoch_table *) table;
+    _Atomic uint64_t epoch;
+    size_t size;
+    hash_func hash_func;
+    pair_ops ops;
+    int has_ops;
+    pthread_mutex_t writer;
+    epoch_reader *readers;
+    epoch_garbage *garbage;
+} epoch_hashmap;
+
+/**
+ * Allocates a new epoch hash map.
+ * @param func a function which "hashes" keys.
+ * @param ops the functions of the keys and the values, NULL to take them
+ * from the first pair inserted.
+ * @return pointer to dynamically allocated epoch_hashmap.
+ * @if_fail return NULL.
+ */
+epoch_hashmap *epoch_hashmap_alloc (hash_func func, const pair_ops *ops);
+
+/**
+ * Frees an epoch hash map and all its pairs. No other thread may use it
+ * meanwhile, its readers are freed too.
+ * @param p_map pointer to dynamically allocated pointer to the map.
+ */
+void epoch_hashmap_free (epoch_hashmap **p_map);
+
+/**
+ * Registers the calling thread as a reader of the map.
+ * @param map the epoch hash map.
+ * @return the registration, used by one thread only.
+ * @if_fail return NULL.
+ */
+epoch_reader *epoch_hashmap_register (epoch_hashmap *map);
+
+/**
+ * Gives a registration back. The reader must be outside a read section.
+ * @param map the epoch hash map.
+ * @param reader a registration of the map.
+ */
+void epoch_hashmap_unregister (epoch_hashmap *map, epoch_reader *reader);
+
+/**
+ * Starts a read section. Nothing the reader sees in it is freed before
+ * epoch_hashmap_exit. Wait-free.
+ * @param reader the registration of the calling thread.
+ */
+void epoch_hashmap_enter (epoch_reader *reader);
+
+/**
+ * Ends a read section.
+ * @param reader the registration of the calling thread.
+ */
+void epoch_hashmap_exit (epoch_reader *reader);
+
+/**
+ * Returns the value associated with the given key. Call it inside a read
+ * section, with no lock: it is wait-free.
+ * @param map the epoch hash map.
+ * @param key the key to be checked.
+ * @return the value (the stored one, valid until the end of the read
+ * section, not to be modified), NULL if key is not in the map.
+ */
+valueT epoch_hashmap_at (const epoch_hashmap *map, const_keyT key);
+
+/**
+ * Inserts a copy of in_pair, like hashmap_insert. Writers take turns.
+ * @param map the epoch hash map.
+ * @param in_pair a pair the map would contain.
+ * @return returns 1 for successful insertion, 0 otherwise.
+ */
+int epoch_hashmap_insert (epoch_hashmap *map, const pair *in_pair);
+
+/**
+ * Erases the pair associated with key, like hashmap_erase. The pair is
+ * freed once no read section can see it anymore.
+ * @param map the epoch hash map.
+ * @param key a key of the pair to be erased.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+int epoch_hashmap_erase (epoch_hashmap *map, const_keyT key);
+
+/**
+ * Returns the number of pairs in the map.
+ * @param map the epoch hash map.
+ * @return the number of pairs, 0 for a NULL map.
+ */
+size_t epoch_hashmap_size (epoch_hashmap *map);
+
+#endif //EPOCH_HASHMAP_H_
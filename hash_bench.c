@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <time.h>
+#include "hashmap.h"
+#include "hash_funcs.h"
+#include "test_pairs.h"
+
+/**
+ * @file
+ * Measures the hash functions of hash_funcs.h, and a hash map with strided
+ * int keys under each of them and under the identity (the old hash_int).
+ * Prints one "name ns_per_op" line per measurement.
+ */
+
+#define BENCH_HASHES 10000000
+#define BENCH_KEYS 100000
+#define BENCH_STRIDE 1024
+
+/**
+ * the former hash_int, for comparison.
+ */
+static size_t identity_hash_int(const void *elem){
+    return (size_t) *((const int *) elem);
+}
+
+/**
+ * returns the current time in nanoseconds.
+ */
+static double now_ns(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+/**
+ * keeps the compiler from dropping the hashes.
+ */
+static volatile size_t bench_sink;
+
+/**
+ * prints the time per hash of a hash function.
+ */
+static void bench_hash(const char *name, hash_func func, const void *keys,
+                       size_t key_size, size_t n_keys){
+    size_t acc = 0;
+    double start = now_ns();
+    for (size_t i = 0; i < BENCH_HASHES; ++i) {
+        acc += func((const char *) keys + (i % n_keys) * key_size);
+    }
+    bench_sink = acc;
+    printf("%-24s %8.2f\n", name, (now_ns() - start) / BENCH_HASHES);
+}
+
+/**
+ * prints the time per insert and per lookup of a map of strided int keys.
+ */
+static void bench_map(const char *name, hash_func func,
+                      hashmap_backend backend){
+    hashmap *map = hashmap_alloc_backend(func, backend);
+    if (map == NULL){
+        return;
+    }
+    int value = 0;
+    double start = now_ns();
+    for (int i = 0; i < BENCH_KEYS; ++i) {
+        int key = i * BENCH_STRIDE;
+        pair *p = pair_alloc(&key, &value, int_value_cpy, int_value_cpy,
+                             int_value_cmp, int_value_cmp, int_value_free,
+                             int_value_free);
+        hashmap_insert(map, p);
+        pair_free((void **) &p);
+    }
+    double insert_ns = (now_ns() - start) / BENCH_KEYS;
+    size_t found = 0;
+    start = now_ns();
+    for (int i = 0; i < BENCH_KEYS; ++i) {
+        int key = i * BENCH_STRIDE;
+        found += hashmap_at(map, &key) != NULL;
+    }
+    double at_ns = (now_ns() - start) / BENCH_KEYS;
+    bench_sink = found;
+    printf("%-24s insert %8.2f at %8.2f\n", name, insert_ns, at_ns);
+    hashmap_free(&map);
+}
+
+int main(void){
+    static int ints[1024];
+    static double doubles[1024];
+    static char strings[1024][16];
+    static char long_strings[64][256];
+    for (int i = 0; i < 1024; ++i) {
+        ints[i] = i * BENCH_STRIDE;
+        doubles[i] = i / 1024.0;
+        snprintf(strings[i], sizeof(strings[i]), "key_%d", i);
+    }
+    for (int i = 0; i < 64; ++i) {
+        memset(long_strings[i], 'a' + i % 26, sizeof(long_strings[i]) - 1);
+        long_strings[i][sizeof(long_strings[i]) - 1] = '\0';
+    }
+
+    bench_hash("identity_int", identity_hash_int, ints, sizeof(int), 1024);
+    bench_hash("hash_int", hash_int, ints, sizeof(int), 1024);
+    bench_hash("hash_double", hash_double, doubles, sizeof(double), 1024);
+    bench_hash("hash_string/short", hash_string, strings, 16, 1024);
+    bench_hash("hash_string/255", hash_string, long_strings, 256, 64);
+
+    bench_map("chaining/identity_int", identity_hash_int, HASHMAP_CHAINING);
+    bench_map("chaining/hash_int", hash_int, HASHMAP_CHAINING);
+    bench_map("swiss/identity_int", identity_hash_int, HASHMAP_SWISS);
+    bench_map("swiss/hash_int", hash_int, HASHMAP_SWISS);
+    bench_map("robin/identity_int", identity_hash_int, HASHMAP_ROBIN_HOOD);
+    bench_map("robin/hash_int", hash_int, HASHMAP_ROBIN_HOOD);
+    bench_map("cuckoo/identity_int", identity_hash_int, HASHMAP_CUCKOO);
+    bench_map("cuckoo/hash_int", hash_int, HASHMAP_CUCKOO);
+    bench_map("compact/identity_int", identity_hash_int, HASHMAP_COMPACT);
+    bench_map("compact/hash_int", hash_int, HASHMAP_COMPACT);
+    return 0;
+}
@@ -2,29 +2,201 @@
 #define HASHFUNCS_H_
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 
 /**
- * Integers simple hash func.
+ * @file
+ * Hash functions for the common key types. The hash maps keep only the low
+ * bits of a hash (hash & (capacity - 1)), so every bit of the key has to
+ * reach them: sequential, strided and floating point keys would otherwise
+ * crowd into a few buckets.
+ *
+ * hash_bytes is a port of wyhash (final version 4, public domain), which
+ * passes SMHasher and hashes long strings at several bytes per cycle.
+ * hash_mix64 is the 64 bit finalizer of splitmix64 (Stafford's Mix13): a
+ * bijection whose every output bit depends on every input bit.
  */
-size_t hash_int(const void *elem){
-    size_t hash = *((int *) elem);
-    return hash;
+
+/**
+ * The seed of the hash_* functions below.
+ */
+#define HASH_DEFAULT_SEED 0
+
+/**
+ * The secrets of wyhash.
+ */
+#define HASH_SECRET_0 0xa0761d6478bd642fULL
+#define HASH_SECRET_1 0xe7037ed1a0b428dbULL
+#define HASH_SECRET_2 0x8ebc6af09c88c6e3ULL
+#define HASH_SECRET_3 0x589965cc75374cc3ULL
+
+/**
+ * Multiplies a and b into a 128 bit product, its low half goes to a and its
+ * high half to b.
+ */
+static inline void hash_mum(uint64_t *a, uint64_t *b){
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) *a * *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = (uint32_t) *a, lb = (uint32_t) *b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/**
+ * Folds the 128 bit product of a and b into 64 bits.
+ */
+static inline uint64_t hash_fold(uint64_t a, uint64_t b){
+    hash_mum(&a, &b);
+    return a ^ b;
+}
+
+/**
+ * Reads 8 (4) bytes, in the byte order of the machine.
+ */
+static inline uint64_t hash_read64(const uint8_t *p){
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hash_read32(const uint8_t *p){
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * Reads 1 to 3 bytes.
+ */
+static inline uint64_t hash_read_small(const uint8_t *p, size_t len){
+    return ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) |
+           p[len - 1];
+}
+
+/**
+ * Hashes a byte string.
+ * @param data the bytes, may be NULL if len is 0.
+ * @param len the number of bytes.
+ * @param seed a seed, different seeds give unrelated hashes.
+ * @return the 64 bit hash of the bytes.
+ */
+static inline uint64_t hash_bytes(const void *data, size_t len,
+                                  uint64_t seed){
+    const uint8_t *p = data;
+    uint64_t a, b;
+    seed ^= hash_fold(seed ^ HASH_SECRET_0, HASH_SECRET_1);
+
+    if (len <= 16){
+        if (len >= 4){
+            size_t shift = (len >> 3) << 2;
+            a = (hash_read32(p) << 32) | hash_read32(p + shift);
+            b = (hash_read32(p + len - 4) << 32) |
+                hash_read32(p + len - 4 - shift);
+        }
+        else if (len > 0){
+            a = hash_read_small(p, len);
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else {
+        size_t i = len;
+        if (i > 48){
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = hash_fold(hash_read64(p) ^ HASH_SECRET_1,
+                                 hash_read64(p + 8) ^ seed);
+                see1 = hash_fold(hash_read64(p + 16) ^ HASH_SECRET_2,
+                                 hash_read64(p + 24) ^ see1);
+                see2 = hash_fold(hash_read64(p + 32) ^ HASH_SECRET_3,
+                                 hash_read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = hash_fold(hash_read64(p) ^ HASH_SECRET_1,
+                             hash_read64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = hash_read64(p + i - 16);
+        b = hash_read64(p + i - 8);
+    }
+
+    a ^= HASH_SECRET_1;
+    b ^= seed;
+    hash_mum(&a, &b);
+    return hash_fold(a ^ HASH_SECRET_0 ^ len, b ^ HASH_SECRET_1);
+}
+
+/**
+ * Mixes a 64 bit integer, e.g. a key that is an integer or an address.
+ * @param x the integer.
+ * @return its hash, a bijection of x.
+ */
+static inline uint64_t hash_mix64(uint64_t x){
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * Integers hash func.
+ */
+static inline size_t hash_int(const void *elem){
+    return (size_t) hash_mix64((uint64_t) (int64_t) *((const int *) elem));
+}
+
+/**
+ * Chars hash func.
+ */
+static inline size_t hash_char(const void *elem){
+    return (size_t) hash_mix64((uint64_t) *((const unsigned char *) elem));
 }
 
 /**
- * Chars simple hash func.
+ * Doubles hash func, by the bits of the double. Equal doubles hash the
+ * same: 0.0 and -0.0 are hashed as 0.0, and every NaN as the same NaN
+ * (a NaN key is never found anyway, as NaN != NaN).
  */
-size_t hash_char(const void *elem){
-    size_t hash = *((char *) elem);
-    return hash;
+static inline size_t hash_double(const void *elem){
+    double key = *((const double *) elem);
+    uint64_t bits;
+    if (key == 0.0){
+        key = 0.0;
+    }
+    else if (key != key){
+        bits = 0x7ff8000000000000ULL;
+        return (size_t) hash_mix64(bits);
+    }
+    memcpy(&bits, &key, sizeof(bits));
+    return (size_t) hash_mix64(bits);
 }
 
 /**
- * Doubles simple hash func.
+ * Strings (null terminated) hash func.
  */
-size_t hash_double(const void *elem){
-    size_t hash = *((double *) elem);
-    return hash;
+static inline size_t hash_string(const void *elem){
+    const char *key = elem;
+    return (size_t) hash_bytes(key, strlen(key), HASH_DEFAULT_SEED);
 }
 
-#endif // HASHFUNCS_H_
\ No newline at end of file
+#endif // HASHFUNCS_H_
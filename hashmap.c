@@ -1,381 +1,1306 @@
-#include "hashmap.h"
+#include "hashmap_engine.h"
 #include "stdbool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
 
 
 
 #define LOAD_FACTOR_ERR -1
-#define VACANT -1
-#define INSERT 5
-#define DELETE 4
 
 /**
- * allocates a new buckets array for the hash map;
- * @param hash_map a hash map
- * @return a new buckets array
+ * returns the engine of the given backend.
+ * @param backend a storage engine of a hash map.
+ * @return the operations of that engine, NULL for unknown backends.
+ */
+static const hashmap_engine *engine_of(hashmap_backend backend){
+    switch (backend) {
+        case HASHMAP_CHAINING:
+            return &chain_engine;
+        case HASHMAP_SWISS:
+            return &swiss_engine;
+        case HASHMAP_ROBIN_HOOD:
+            return &robin_engine;
+        case HASHMAP_CUCKOO:
+            return &cuckoo_engine;
+        case HASHMAP_COMPACT:
+            return &compact_engine;
+    }
+    return NULL;
+}
+
+/**
+ * Allocates dynamically new hash map element, that stores its pairs in
+ * vectors chained from the buckets (HASHMAP_CHAINING).
+ * @param func a function which "hashes" keys.
+ * @return pointer to dynamically allocated hashmap.
  * @if_fail return NULL.
  */
-vector** buckets_alloc(hashmap* hash_map){
+hashmap *hashmap_alloc (hash_func func){
+    return hashmap_alloc_backend(func, HASHMAP_CHAINING);
+}
+
+/**
+ * Allocates dynamically new hash map element, with the given storage engine.
+ * All the other hashmap functions behave the same for every engine.
+ * @param func a function which "hashes" keys.
+ * @param backend the storage engine of the new hash map.
+ * @return pointer to dynamically allocated hashmap.
+ * @if_fail return NULL.
+ */
+hashmap *hashmap_alloc_backend (hash_func func, hashmap_backend backend){
+    return hashmap_alloc_allocator(func, backend, NULL);
+}
+
+/**
+ * Allocates a new hash map element with the given storage engine, that
+ * draws all its memory (the hash map itself, its buckets, vectors and pairs)
+ * from the given allocator, e.g. arena_allocator of an arena (see arena.h).
+ * Keys and values are still copied by key_cpy and value_cpy.
+ * @param func a function which "hashes" keys.
+ * @param backend the storage engine of the new hash map.
+ * @param mem the allocator, NULL for malloc. Its ctx must outlive the map.
+ * @return pointer to the allocated hashmap.
+ * @if_fail return NULL.
+ */
+hashmap *hashmap_alloc_allocator (hash_func func, hashmap_backend backend,
+                                  const allocator *mem){
+    return hashmap_alloc_ops(func, backend, NULL, mem);
+}
+
+/**
+ * Allocates a new hash map element, whose keys and values all share the
+ * given functions. The hash map stores every pair as an entry (key, value
+ * and hash) and keeps the functions once, instead of in every pair. The
+ * functions of the pairs inserted later are ignored.
+ * @param func a function which "hashes" keys.
+ * @param backend the storage engine of the new hash map.
+ * @param ops the functions of the keys and the values, NULL to take them
+ * from the first pair inserted.
+ * @param mem the allocator, NULL for malloc. Its ctx must outlive the map.
+ * @return pointer to the allocated hashmap.
+ * @if_fail return NULL.
+ */
+hashmap *hashmap_alloc_ops (hash_func func, hashmap_backend backend,
+                            const pair_ops *ops, const allocator *mem){
+
+    hashmap_config config = {0};
+    config.backend = backend;
+    config.ops = ops;
+    config.mem = mem;
+    return hashmap_alloc_config(func, &config);
+}
+
+/**
+ * returns whether n is a power of 2.
+ */
+static int is_power_of_2 (size_t n){
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+/**
+ * fills the zeroed fields of a configuration with the defaults, and checks
+ * the configuration.
+ * @param config the configuration, completed in place.
+ * @param engine the engine of its backend.
+ * @return 1 if it is valid, 0 otherwise.
+ */
+static int complete_config (hashmap_config *config,
+                            const hashmap_engine *engine){
+
+    if (config->initial_capacity == 0){
+        config->initial_capacity = HASH_MAP_INITIAL_CAP;
+    }
+    if (config->growth_factor == 0){
+        config->growth_factor = HASH_MAP_GROWTH_FACTOR;
+    }
+    if (config->max_load_factor == 0){
+        config->max_load_factor = HASH_MAP_MAX_LOAD_FACTOR;
+    }
+    if (config->min_load_factor == 0){
+        config->min_load_factor = HASH_MAP_MIN_LOAD_FACTOR;
+    }
+
+    // round the capacity up to a power of 2 the engine can work with.
+    size_t capacity = engine->min_capacity;
+    while (capacity < config->initial_capacity) {
+        if (capacity > SIZE_MAX / 2){
+            return false;
+        }
+        capacity *= 2;
+    }
+    config->initial_capacity = capacity;
+
+    if (config->growth_factor < 2 || !is_power_of_2(config->growth_factor) ||
+        !(config->max_load_factor > 0) || !(config->min_load_factor > 0)){
+        return false;
+    }
+
+    if (engine->max_load_factor != 0 &&
+        config->max_load_factor > engine->max_load_factor){
+        return false;
+    }
+
+    // a shrink must not leave the hash map about to grow again.
+    if (!config->no_shrink &&
+        config->min_load_factor * (double) config->growth_factor >=
+        config->max_load_factor){
+        return false;
+    }
+
+    if (config->incremental_rehash && engine->rehash_step == NULL){
+        return false;
+    }
+
+    const pair_ops *ops = config->ops;
+    const allocator *mem = config->mem;
+
+    if (mem != NULL && (mem->alloc == NULL) != (mem->free == NULL)){
+        return false;
+    }
+
+    return ops == NULL || (ops->key_cpy != NULL && ops->value_cpy != NULL &&
+                           ops->key_cmp != NULL && ops->key_free != NULL &&
+                           ops->value_free != NULL);
+}
+
+/**
+ * Allocates a new hash map element, configured by config: its storage
+ * engine, its functions and allocator, and when it grows and shrinks.
+ * @param func a function which "hashes" keys.
+ * @param config the configuration, NULL for the defaults.
+ * @return pointer to the allocated hashmap.
+ * @if_fail return NULL, also for an invalid configuration.
+ */
+hashmap *hashmap_alloc_config (hash_func func, const hashmap_config *config){
 
-    // first alloc an array of pointers
-    vector** new_buckets = calloc(hash_map->capacity, sizeof(vector*));
+    hashmap_config full_config = {0};
+    if (config != NULL){
+        full_config = *config;
+    }
 
-    if (new_buckets == NULL){
+    const hashmap_engine *engine = engine_of(full_config.backend);
+
+    if (func == NULL || engine == NULL ||
+        !complete_config(&full_config, engine)){
         return NULL;
     }
 
-    for (int i = 0; i < hash_map->capacity; ++i) {
+    const allocator *mem = full_config.mem;
+
+    // first create a new hash map and allocate the memory
+    hashmap *new_hash_map = allocator_calloc(mem, 1, sizeof(hashmap));
+
+    if (new_hash_map == NULL){
+        return NULL;
+    }
+
+    if (mem != NULL){
+        new_hash_map->mem = *mem;
+    }
+
+    if (full_config.ops != NULL){
+        new_hash_map->ops = *full_config.ops;
+        new_hash_map->has_ops = true;
+    }
+
+    // initialize the hash map data members.
+    new_hash_map->capacity = full_config.initial_capacity;
+
+    new_hash_map->size = 0;
+
+    new_hash_map->hash_func = func;
 
-        // allocate every vector
-        new_buckets[i] = vector_alloc(pair_copy, pair_cmp, pair_free);
+    new_hash_map->backend = full_config.backend;
+
+    new_hash_map->engine = engine;
+
+    new_hash_map->growth_factor = full_config.growth_factor;
+    new_hash_map->max_load_factor = full_config.max_load_factor;
+    new_hash_map->min_load_factor = full_config.min_load_factor;
+    new_hash_map->no_shrink = full_config.no_shrink ? true : false;
+    new_hash_map->hysteresis = full_config.hysteresis;
+    new_hash_map->incremental_rehash = full_config.incremental_rehash ?
+                                       true : false;
+
+    if (!engine->init(new_hash_map)){
+        allocator_free(mem, new_hash_map, sizeof(hashmap));
+        return NULL;
+    }
 
-        // in case the memory allocation has not succeeded we need to free all
-        // vectors
-        if (new_buckets[i] == NULL){
 
-            for (int j = 0; j < i; ++j) {
-                vector_free(&new_buckets[j]);
+    // if code got here everything is okay, return the new allocated hashmap
+    return new_hash_map;
+}
+
+/**
+ * Turns incremental rehashing on or off. When it is on, growing or
+ * shrinking the hash map only allocates the new buckets array; the pairs
+ * move there HASH_MAP_REHASH_STEP buckets at a time, by the following
+ * inserts and erases (or by hashmap_rehash_step). Until then lookups search
+ * both arrays, and capacity already reports the new number of buckets.
+ * Turning it off finishes a rehash in progress.
+ * Only HASHMAP_CHAINING supports it.
+ * @param hash_map a hash map.
+ * @param enabled 1 to turn it on, 0 to turn it off.
+ * @return 1 on success, 0 otherwise.
+ */
+int hashmap_set_incremental_rehash (hashmap *hash_map, int enabled){
+
+    if (hash_map == NULL || hash_map->engine->rehash_step == NULL){
+        return false;
+    }
+
+    if (!enabled && hashmap_rehash_step(hash_map, SIZE_MAX)){
+
+        // the rest of the pairs could not be moved.
+        return false;
+    }
+
+    hash_map->incremental_rehash = enabled ? true : false;
+    return true;
+}
+
+/**
+ * Moves the pairs of up to n old buckets of an incremental rehash in
+ * progress, e.g. to finish it while the hash map is idle.
+ * hashmap_at never moves pairs, so it is safe to call it from many readers.
+ * @param hash_map a hash map.
+ * @param n the number of old buckets to move.
+ * @return 1 if a rehash is still in progress afterwards, 0 otherwise.
+ */
+int hashmap_rehash_step (hashmap *hash_map, size_t n){
+
+    if (hash_map == NULL || hash_map->engine->rehash_step == NULL){
+        return false;
+    }
+
+    return hash_map->engine->rehash_step(hash_map, n);
+}
+
+/**
+ * Frees a hash map and the elements the hash map itself allocated.
+ * @param p_hash_map pointer to dynamically allocated pointer to hash_map.
+ */
+void hashmap_free (hashmap **p_hash_map){
+
+    if (p_hash_map == NULL || *p_hash_map == NULL){
+        return;
+    }
+
+    hashmap *hash_map_ptr = *p_hash_map;
+
+    // first we need to free all the pairs and the storage holding them
+    hash_map_ptr->engine->destroy(hash_map_ptr);
+
+    // now free the hash map itself, a copy of the allocator outlives it.
+    allocator mem = hash_map_ptr->mem;
+    allocator_free(&mem, hash_map_ptr, sizeof(hashmap));
+    *p_hash_map = NULL;
+}
+
+/**
+ * counts an insert or an erase towards the hysteresis of the hash map.
+ */
+static void count_since_resize (hashmap *hash_map){
+    if (hash_map->since_resize < hash_map->hysteresis){
+        hash_map->since_resize += 1;
+    }
+}
+
+/**
+ * resizes the storage of the hash map to new_capacity buckets.
+ * @return 1 on success, 0 otherwise (then the hash map is left untouched).
+ */
+static int resize (hashmap *hash_map, size_t new_capacity){
+
+    if (!hash_map->engine->rehash(hash_map, new_capacity)){
+        return false;
+    }
+
+    hash_map->since_resize = 0;
+    return true;
+}
+
+int hashmap_engine_insert (hashmap *hash_map, entry *new_entry){
+
+    if (hash_map->engine->insert(hash_map, new_entry->hash, new_entry)){
+        return true;
+    }
+
+    // the storage has no room left for the pair, so it grows like it does
+    // past the max load factor, and gets one more try.
+    return resize(hash_map, hash_map->capacity * hash_map->growth_factor) &&
+           hash_map->engine->insert(hash_map, new_entry->hash, new_entry);
+}
+
+/**
+ * Makes sure the hash map knows the functions of its keys and values,
+ * taking them from the given pair if it was allocated without pair_ops.
+ * @param hash_map a hash map.
+ * @param in_pair a pair about to be inserted.
+ */
+static void adopt_ops (hashmap *hash_map, const pair *in_pair){
+    if (!hash_map->has_ops){
+        hash_map->ops = pair_get_ops(in_pair);
+        hash_map->has_ops = true;
+    }
+}
+
+/**
+ * Links an owned entry to the hash map, and grows the hash map if needed.
+ * @param hash_map the hash map to be inserted with new element.
+ * @param new_entry an entry the hash map owns from now on, if this succeeds.
+ * Its hash is cached, so rehashing and scanning never call hash_func again.
+ * @return returns 1 for successful insertion, 0 otherwise (then the caller
+ * still owns new_entry).
+ */
+static int link_entry (hashmap *hash_map, entry *new_entry){
+
+    if (!hashmap_engine_insert(hash_map, new_entry)){
+        return false;
+    }
+
+    hash_map->size += 1;
+    count_since_resize(hash_map);
+
+    if (hashmap_get_load_factor(hash_map) > hash_map->max_load_factor){
+
+        // there are too many values in hashmap, so it needs to be resized.
+        int is_success = resize(hash_map,
+                                hash_map->capacity * hash_map->growth_factor);
+
+        if (!is_success) {
+
+            // the reassign of the pairs was unsuccessful so the insertion
+            // needs to be undone, without freeing the entry.
+            hash_map->engine->erase(
+                    hash_map,
+                    hash_map->engine->find(hash_map, new_entry->hash,
+                                           new_entry->key));
+            hash_map->size -= 1;
+            return false;
+        }
+
+    }
+
+    // finally, the new value is in the hash map.
+    return true;
+}
+
+/**
+ * inserts a copy of in_pair, whose key hashes to hash.
+ * @return returns 1 for successful insertion, 0 otherwise.
+ */
+static int insert_hashed (hashmap *hash_map, const pair *in_pair,
+                          size_t hash){
+
+    // every insert pays for a small part of a rehash in progress.
+    hashmap_rehash_step(hash_map, HASH_MAP_REHASH_STEP);
+
+    if (hash_map->engine->find(hash_map, hash, in_pair->key) != NULL){
+
+        // this means that the value with the same key is already in hash map.
+        return false;
+    }
+
+    // there is no value like this in the hash map so we can insert a copy
+    // of it.
+    entry *new_entry = entry_alloc(&hash_map->ops, &hash_map->mem,
+                                   in_pair->key, in_pair->value, hash);
+
+    if (new_entry == NULL){
+        return false;
+    }
+
+    if (!link_entry(hash_map, new_entry)){
+        entry_free(&new_entry, &hash_map->ops, &hash_map->mem);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Inserts a new in_pair to the hash map.
+ * The function inserts *new*, *copied*, *dynamically allocated* in_pair,
+ * NOT the in_pair it receives as a parameter. The key and the value are
+ * copied with the hash map's pair_ops (the ones of the first pair, unless it
+ * was allocated with hashmap_alloc_ops).
+ * @param hash_map the hash map to be inserted with new element.
+ * @param in_pair a in_pair the hash map would contain.
+ * @return returns 1 for successful insertion, 0 otherwise.
+ */
+int hashmap_insert (hashmap *hash_map, const pair *in_pair){
+
+    if (hash_map == NULL || in_pair == NULL){
+        return false;
+    }
+
+    adopt_ops(hash_map, in_pair);
+
+    // activate hash function on the pair.
+    return insert_hashed(hash_map, in_pair, hash_map->hash_func(in_pair->key));
+}
+
+/**
+ * Like hashmap_insert, with the hash of the key already computed.
+ * @param hash the hash_func of the hash map applied to the key of in_pair.
+ * @return returns 1 for successful insertion, 0 otherwise.
+ */
+int hashmap_insert_hashed (hashmap *hash_map, const pair *in_pair,
+                           size_t hash){
+
+    if (hash_map == NULL || in_pair == NULL){
+        return false;
+    }
+
+    adopt_ops(hash_map, in_pair);
+    return insert_hashed(hash_map, in_pair, hash);
+}
+
+/**
+ * Inserts the key and the value of in_pair to the hash map, without copying
+ * them. Build in_pair with pair_alloc, or with pair_adopt to hand over a key
+ * and a value that are already allocated.
+ * @param hash_map the hash map to be inserted with new element.
+ * @param in_pair a dynamically allocated pair. On success the hash map owns
+ * its key and value (and frees them on erase or on hashmap_free) and frees
+ * the pair struct itself, on failure the caller still owns all of it.
+ * @return returns 1 for successful insertion, 0 otherwise (e.g. when the key
+ * is already in the hash map).
+ */
+int hashmap_insert_take (hashmap *hash_map, pair *in_pair){
+
+    if (hash_map == NULL || in_pair == NULL){
+        return false;
+    }
+
+    adopt_ops(hash_map, in_pair);
+
+    // every insert pays for a small part of a rehash in progress.
+    hashmap_rehash_step(hash_map, HASH_MAP_REHASH_STEP);
+
+    size_t hash = hash_map->hash_func(in_pair->key);
+
+    if (hash_map->engine->find(hash_map, hash, in_pair->key) != NULL){
+        return false;
+    }
+
+    // the key and the value move to a new entry, only the pair struct is
+    // left behind.
+    entry *new_entry = entry_adopt(&hash_map->ops, &hash_map->mem,
+                                   in_pair->key, in_pair->value, hash);
+
+    if (new_entry == NULL){
+        return false;
+    }
+
+    if (!link_entry(hash_map, new_entry)){
+        allocator_free(&hash_map->mem, new_entry,
+                       entry_size(&hash_map->ops));
+        return false;
+    }
+
+    free(in_pair);
+    return true;
+}
+
+/**
+ * looks key up and inserts it with a copy of value if it is missing.
+ * @return the entry of key, NULL on failure.
+ */
+static entry *find_or_insert_hashed (hashmap *hash_map, const_keyT key,
+                                     const_valueT value, size_t hash,
+                                     int *inserted){
+
+    // every insert pays for a small part of a rehash in progress.
+    hashmap_rehash_step(hash_map, HASH_MAP_REHASH_STEP);
+
+    *inserted = false;
+    entry **slot = hash_map->engine->find(hash_map, hash, key);
+
+    if (slot != NULL){
+        return *slot;
+    }
+
+    // the miss is placed straight by the engine, without comparing keys
+    // again. the entry is a block of its own, so it stays where it is even
+    // if linking it resizes the hash map.
+    entry *new_entry = entry_alloc(&hash_map->ops, &hash_map->mem, key,
+                                   value, hash);
+
+    if (new_entry == NULL){
+        return NULL;
+    }
+
+    if (!link_entry(hash_map, new_entry)){
+        entry_free(&new_entry, &hash_map->ops, &hash_map->mem);
+        return NULL;
+    }
+
+    *inserted = true;
+    return new_entry;
+}
+
+/**
+ * Returns the value of key, inserting key with a copy of value first if it
+ * is not in the hash map yet. The key is hashed once and looked up once, so
+ * a counter is updated in place without hashmap_at before hashmap_insert:
+ *   int zero = 0;
+ *   int *count = hashmap_find_or_insert(map, word, &zero, NULL);
+ *   *count += 1;
+ * @param hash_map a hash map that knows its pair_ops (allocated with
+ * hashmap_alloc_ops, or after its first insert).
+ * @param key the key to be looked up, copied only when inserted.
+ * @param value the value of a new pair, copied only when inserted.
+ * @param inserted if not NULL, set to 1 when the pair was inserted, else 0.
+ * @return the value of key in the hash map (the value itself, which may be
+ * modified in place until the pair is erased), NULL on failure.
+ */
+valueT hashmap_find_or_insert (hashmap *hash_map, const_keyT key,
+                               const_valueT value, int *inserted){
+
+    int is_inserted = false;
+    entry *cur_entry = NULL;
+
+    if (hash_map != NULL && key != NULL && value != NULL &&
+        hash_map->has_ops){
+        cur_entry = find_or_insert_hashed(hash_map, key, value,
+                                          hash_map->hash_func(key),
+                                          &is_inserted);
+    }
+
+    if (inserted != NULL){
+        *inserted = is_inserted;
+    }
+    return cur_entry == NULL ? NULL : cur_entry->value;
+}
+
+/**
+ * Inserts a copy of in_pair to the hash map, or, if its key is already
+ * there, replaces the value of that key with a copy of the value of
+ * in_pair. Like hashmap_find_or_insert, the key is hashed and looked up
+ * once.
+ * @param hash_map the hash map to be inserted with new element.
+ * @param in_pair a in_pair the hash map would contain.
+ * @param inserted if not NULL, set to 1 when the pair was inserted, 0 when
+ * the value was assigned.
+ * @return returns 1 for successful insertion or assignment, 0 otherwise
+ * (then the hash map is left as it was).
+ */
+int hashmap_insert_or_assign (hashmap *hash_map, const pair *in_pair,
+                              int *inserted){
+
+    int is_inserted = false;
+    int is_success = false;
+
+    if (hash_map != NULL && in_pair != NULL){
+
+        adopt_ops(hash_map, in_pair);
+
+        entry *cur_entry = find_or_insert_hashed(
+                hash_map, in_pair->key, in_pair->value,
+                hash_map->hash_func(in_pair->key), &is_inserted);
+
+        // a new pair already has the value, an old one gets it now.
+        is_success = cur_entry != NULL &&
+                     (is_inserted ||
+                      entry_assign(cur_entry, &hash_map->ops,
+                                   in_pair->value));
+    }
+
+    if (inserted != NULL){
+        *inserted = is_inserted;
+    }
+    return is_success;
+}
+
+/**
+ * The function returns the value associated with the given key.
+ * @param hash_map a hash map.
+ * @param key the key to be checked.
+ * @return the value associated with key if exists, NULL otherwise (the value itself,
+ * not a copy of it).
+ */
+valueT hashmap_at (const hashmap *hash_map, const_keyT key){
+
+    if (key == NULL || hash_map == NULL){
+        return NULL;
+    }
+
+    // first get the hash code for the key, the engine finds its slot.
+    entry **slot = hash_map->engine->find(hash_map, hash_map->hash_func(key),
+                                          key);
+
+    // no slot means pair with this key is not in hashmap.
+    if (slot == NULL){
+        return NULL;
+    }
+
+    return (*slot)->value;
+}
+
+/**
+ * Like hashmap_at, with the hash of the key already computed.
+ * @param hash the hash_func of the hash map applied to key.
+ * @return the value associated with key if exists, NULL otherwise.
+ */
+valueT hashmap_at_hashed (const hashmap *hash_map, const_keyT key,
+                          size_t hash){
+
+    if (key == NULL || hash_map == NULL){
+        return NULL;
+    }
+
+    entry **slot = hash_map->engine->find(hash_map, hash, key);
+    return slot == NULL ? NULL : (*slot)->value;
+}
+
+/**
+ * Like hashmap_at, for a key given as raw bytes: parsers can look keys up
+ * straight from their input, without building a key object. The stored
+ * keys are compared with the bytes by the key_cmp_bytes of the pair_ops of
+ * the hash map (see hashmap_alloc_ops).
+ * @param hash_map a hash map whose pair_ops have key_cmp_bytes.
+ * @param bytes the bytes of the key.
+ * @param len the number of bytes.
+ * @param hash the hash of the key, the one hash_func gives for its key
+ * object (e.g. hash_bytes(bytes, len, HASH_DEFAULT_SEED) for hash_string).
+ * @return the value associated with the key if exists, NULL otherwise (the
+ * value itself, not a copy of it).
+ */
+valueT hashmap_at_bytes (const hashmap *hash_map, const void *bytes,
+                         size_t len, size_t hash){
+
+    if (hash_map == NULL || (bytes == NULL && len > 0) ||
+        hash_map->ops.key_cmp_bytes == NULL){
+        return NULL;
+    }
+
+    entry **slot = hash_map->engine->find_bytes(hash_map, hash, bytes, len);
+    return slot == NULL ? NULL : (*slot)->value;
+}
+
+/**
+ * erases the pair in slot, as found in the hash map.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+static int erase_slot (hashmap *hash_map, entry **slot){
+
+    if (slot == NULL){
+        // there is nothing to delete
+        return false;
+    }
+
+    entry *old_entry = hash_map->engine->erase(hash_map, slot);
+    entry_free(&old_entry, &hash_map->ops, &hash_map->mem);
+
+    hash_map->size -= 1;
+    count_since_resize(hash_map);
+
+    // now check if a resizing of the hash map is required. if the resizing
+    // fails the hash map just stays bigger, the pair is erased anyway.
+    if (!hash_map->no_shrink &&
+    hash_map->since_resize >= hash_map->hysteresis &&
+    hashmap_get_load_factor(hash_map) < hash_map->min_load_factor &&
+    hash_map->capacity / hash_map->growth_factor >=
+    hash_map->engine->min_capacity){
+
+        resize(hash_map, hash_map->capacity / hash_map->growth_factor);
+
+    }
+
+    return true;
+}
+
+/**
+ * erases the pair of key, which hashes to hash.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+static int erase_hashed (hashmap *hash_map, const_keyT key, size_t hash){
+
+    // every erase pays for a small part of a rehash in progress.
+    hashmap_rehash_step(hash_map, HASH_MAP_REHASH_STEP);
+
+    // first we need to check if hash map contains a value with this key.
+    return erase_slot(hash_map, hash_map->engine->find(hash_map, hash, key));
+}
+
+/**
+ * The function erases the pair associated with key.
+ * @param hash_map a hash map.
+ * @param key a key of the pair to be erased.
+ * @return 1 if the erasing was done successfully, 0 otherwise. (if key not in map,
+ * considered fail).
+ */
+int hashmap_erase (hashmap *hash_map, const_keyT key){
+
+    if (hash_map == NULL || key == NULL){
+        return false;
+    }
+
+    return erase_hashed(hash_map, key, hash_map->hash_func(key));
+}
 
-            }
+/**
+ * Like hashmap_erase, with the hash of the key already computed.
+ * @param hash the hash_func of the hash map applied to key.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+int hashmap_erase_hashed (hashmap *hash_map, const_keyT key, size_t hash){
 
-            // the hash map and the pointer array of buckets
-            // also needs to be freed
+    if (hash_map == NULL || key == NULL){
+        return false;
+    }
 
-            return NULL;
+    return erase_hashed(hash_map, key, hash);
+}
 
-        }
+/**
+ * Like hashmap_erase, for a key given as raw bytes (see hashmap_at_bytes).
+ * @param hash_map a hash map whose pair_ops have key_cmp_bytes.
+ * @param bytes the bytes of the key.
+ * @param len the number of bytes.
+ * @param hash the hash of the key, the one hash_func gives for its key
+ * object.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+int hashmap_erase_bytes (hashmap *hash_map, const void *bytes, size_t len,
+                         size_t hash){
 
+    if (hash_map == NULL || (bytes == NULL && len > 0) ||
+        hash_map->ops.key_cmp_bytes == NULL){
+        return false;
     }
 
-    return new_buckets;
+    hashmap_rehash_step(hash_map, HASH_MAP_REHASH_STEP);
+    return erase_slot(hash_map, hash_map->engine->find_bytes(hash_map, hash,
+                                                             bytes, len));
 }
 
 /**
- * frees all the buckets until the current vector
- * @param hash_map a hash map
- * @param index the index of the current vector
+ * @def BATCH_PIPELINE_DEPTH
+ * the number of steps between the first prefetch of a key and its lookup.
  */
-void free_all_buckets(vector** buckets , int index) {
-
-    for (int i = 0; i < index; ++i) {
+#define BATCH_PIPELINE_DEPTH (HASHMAP_PREFETCH_LEVELS * \
+                              HASH_MAP_PREFETCH_DISTANCE)
 
-        vector_clear(buckets[i]);
-        vector_free(&buckets[i]);
-
-        buckets[i] = NULL;
+/**
+ * issues the prefetches due at step i of a batch window: every level of
+ * every key is prefetched HASH_MAP_PREFETCH_DISTANCE steps after the level
+ * before it, and the key is looked up at step index + BATCH_PIPELINE_DEPTH.
+ * @param hash_map a hash map.
+ * @param hashes the hashes of the keys of the window.
+ * @param n the number of keys in the window.
+ * @param i the step.
+ */
+static void prefetch_step (const hashmap *hash_map, const size_t *hashes,
+                           size_t n, size_t i){
 
+    for (int level = 0; level < HASHMAP_PREFETCH_LEVELS; ++level) {
+        size_t lag = (size_t) level * HASH_MAP_PREFETCH_DISTANCE;
+        if (i >= lag && i - lag < n){
+            hash_map->engine->prefetch(hash_map, hashes[i - lag], level);
+        }
     }
-
-    free(buckets);
-    buckets = NULL;
 }
 
 /**
- * Allocates dynamically new hash map element.
- * @param func a function which "hashes" keys.
- * @return pointer to dynamically allocated hashmap.
- * @if_fail return NULL.
+ * Looks up n keys at once, like calling hashmap_at for each of them, but
+ * faster for big maps: the keys are hashed first, then the memory of every
+ * lookup is prefetched a few lookups ahead, so many cache misses are in
+ * flight at the same time instead of one after the other.
+ * @param hash_map a hash map.
+ * @param keys the keys to be checked.
+ * @param n the number of keys.
+ * @param out_values out_values[i] is set to the value of keys[i] (the value
+ * itself, not a copy of it), or to NULL if it is not in the hash map.
+ * @return the number of keys found, 0 if the function failed.
  */
-hashmap *hashmap_alloc (hash_func func){
+size_t hashmap_at_batch (const hashmap *hash_map, const_keyT *keys, size_t n,
+                         valueT *out_values){
 
-    // first create a new hash map and allocate the memory
-    hashmap *new_hash_map = malloc(sizeof(hashmap));
+    size_t found = 0;
 
-    if (new_hash_map == NULL){
-        return NULL;
+    if (hash_map == NULL || keys == NULL || out_values == NULL){
+        return found;
     }
 
-    // initialize the hash map data members.
-    new_hash_map->capacity = HASH_MAP_INITIAL_CAP;
+    size_t hashes[HASH_MAP_BATCH_WINDOW];
 
-    new_hash_map->size = 0;
+    for (size_t first = 0; first < n; first += HASH_MAP_BATCH_WINDOW) {
 
-    new_hash_map->hash_func = func;
+        size_t window = n - first < HASH_MAP_BATCH_WINDOW ?
+                        n - first : HASH_MAP_BATCH_WINDOW;
+        const_keyT *cur_keys = keys + first;
+
+        for (size_t j = 0; j < window; ++j) {
+            hashes[j] = cur_keys[j] == NULL ? 0 :
+                        hash_map->hash_func(cur_keys[j]);
+        }
 
-    new_hash_map->buckets = buckets_alloc(new_hash_map);
+        for (size_t i = 0; i < window + BATCH_PIPELINE_DEPTH; ++i) {
 
-    if (new_hash_map->buckets == NULL){
-        return NULL;
-    }
+            prefetch_step(hash_map, hashes, window, i);
 
+            if (i < BATCH_PIPELINE_DEPTH){
+                continue;
+            }
 
-    // if code got here everything is okay, return the new allocated hashmap
-    return new_hash_map;
+            size_t j = i - BATCH_PIPELINE_DEPTH;
+            entry **slot = cur_keys[j] == NULL ? NULL :
+                    hash_map->engine->find(hash_map, hashes[j], cur_keys[j]);
+            out_values[first + j] = slot == NULL ? NULL : (*slot)->value;
+            found += slot != NULL;
+        }
+    }
+
+    return found;
 }
 
 /**
- * Frees a hash map and the elements the hash map itself allocated.
- * @param p_hash_map pointer to dynamically allocated pointer to hash_map.
+ * Inserts copies of n pairs, like calling hashmap_insert for each of them,
+ * prefetching like hashmap_at_batch.
+ * @param hash_map the hash map to be inserted with new elements.
+ * @param pairs the pairs the hash map would contain.
+ * @param n the number of pairs.
+ * @return the number of pairs inserted (a pair whose key is already in the
+ * hash map is not), 0 if the function failed.
  */
-void hashmap_free (hashmap **p_hash_map){
+size_t hashmap_insert_batch (hashmap *hash_map, pair *const *pairs,
+                             size_t n){
 
-    hashmap *hash_map_ptr = *p_hash_map;
+    size_t inserted = 0;
+
+    if (hash_map == NULL || pairs == NULL){
+        return inserted;
+    }
+
+    size_t hashes[HASH_MAP_BATCH_WINDOW];
 
-    // first we need to free all the vectors
-    free_all_buckets(hash_map_ptr->buckets, (int) hash_map_ptr->capacity);
+    for (size_t first = 0; first < n; first += HASH_MAP_BATCH_WINDOW) {
 
-    // now free the hash map itself
-    free(hash_map_ptr);
+        size_t window = n - first < HASH_MAP_BATCH_WINDOW ?
+                        n - first : HASH_MAP_BATCH_WINDOW;
+        pair *const *cur_pairs = pairs + first;
+
+        for (size_t j = 0; j < window; ++j) {
+            hashes[j] = 0;
+            if (cur_pairs[j] != NULL){
+                adopt_ops(hash_map, cur_pairs[j]);
+                hashes[j] = hash_map->hash_func(cur_pairs[j]->key);
+            }
+        }
+
+        // an insert may rehash, the prefetches after it just follow the
+        // new storage.
+        for (size_t i = 0; i < window + BATCH_PIPELINE_DEPTH; ++i) {
+
+            prefetch_step(hash_map, hashes, window, i);
+
+            if (i >= BATCH_PIPELINE_DEPTH &&
+                cur_pairs[i - BATCH_PIPELINE_DEPTH] != NULL){
+                size_t j = i - BATCH_PIPELINE_DEPTH;
+                inserted += insert_hashed(hash_map, cur_pairs[j], hashes[j]);
+            }
+        }
+    }
+
+    return inserted;
 }
 
 /**
- * re hashes all values in the hash map
- * @param hash_map a hash map
- * @return 1 if the re assign succeeded, 0 otherwise.
+ * Erases the pairs of n keys, like calling hashmap_erase for each of them,
+ * prefetching like hashmap_at_batch.
+ * @param hash_map a hash map.
+ * @param keys the keys of the pairs to be erased.
+ * @param n the number of keys.
+ * @return the number of pairs erased, 0 if the function failed.
  */
-int assign_all_pairs(hashmap *hash_map, int action){
+size_t hashmap_erase_batch (hashmap *hash_map, const_keyT *keys, size_t n){
 
-    // first initialize a new buckets array to assign the pairs to.
-    vector **temp_buckets = buckets_alloc(hash_map);
+    size_t erased = 0;
 
-    if (temp_buckets == NULL){
-        return false;
+    if (hash_map == NULL || keys == NULL){
+        return erased;
     }
 
-    for (int i = 0; i < hash_map->size; ++i) {
+    size_t hashes[HASH_MAP_BATCH_WINDOW];
 
-        // get the current bucket/vector
-        vector* cur_vector = hash_map->buckets[i];
+    for (size_t first = 0; first < n; first += HASH_MAP_BATCH_WINDOW) {
 
-        for (int j = 0; j < cur_vector->size ; ++j) {
+        size_t window = n - first < HASH_MAP_BATCH_WINDOW ?
+                        n - first : HASH_MAP_BATCH_WINDOW;
+        const_keyT *cur_keys = keys + first;
 
-            //get the pair object in that bucket and its hash key.
-            pair *cur_pair = cur_vector->data[j];
-
-            size_t hash_key = hash_map->hash_func(cur_pair->key) &
-                    (hash_map->capacity - 1);
+        for (size_t j = 0; j < window; ++j) {
+            hashes[j] = cur_keys[j] == NULL ? 0 :
+                        hash_map->hash_func(cur_keys[j]);
+        }
 
-            // put the pair in the proper bucket key.
-            int is_success = vector_push_back(temp_buckets[hash_key], cur_pair);
+        for (size_t i = 0; i < window + BATCH_PIPELINE_DEPTH; ++i) {
 
-            if (!is_success) {
+            prefetch_step(hash_map, hashes, window, i);
 
-                // couldn't assign one of the pairs,
-                free_all_buckets(temp_buckets, i);
-                return false;
+            if (i >= BATCH_PIPELINE_DEPTH &&
+                cur_keys[i - BATCH_PIPELINE_DEPTH] != NULL){
+                size_t j = i - BATCH_PIPELINE_DEPTH;
+                erased += erase_hashed(hash_map, cur_keys[j], hashes[j]);
             }
         }
-
     }
 
-    // we should now free the former buckets array of hash map
-    switch (action) {
-        case INSERT:
-            for (int i = 0; i < (hash_map->capacity) /
-            VECTOR_GROWTH_FACTOR; ++i) {
-                vector_free(&hash_map->buckets[i]);
-            }
-            break;
-        case DELETE:
-            for (int i = 0; i < (hash_map->capacity) *
-            VECTOR_GROWTH_FACTOR; ++i) {
-                vector_free(&hash_map->buckets[i]);
-            }
-            break;
+    return erased;
+}
+
+/**
+ * Makes room for n pairs: grows the hash map once to the capacity n pairs
+ * need, so the next inserts up to n pairs don't rehash. A hash map that is
+ * already big enough is left as it is.
+ * @param hash_map a hash map.
+ * @param n the number of pairs the hash map will hold.
+ * @return 1 on success, 0 otherwise (then the hash map is left untouched).
+ */
+int hashmap_reserve (hashmap *hash_map, size_t n){
+
+    if (hash_map == NULL){
+        return false;
     }
 
-    free(hash_map->buckets);
+    size_t new_capacity = hash_map->capacity;
 
-    // assign the temp buckets array to the buckets array of the hash map
-    hash_map->buckets = temp_buckets;
+    while ((double) n / (double) new_capacity > hash_map->max_load_factor) {
+        if (new_capacity > SIZE_MAX / hash_map->growth_factor){
+            return false;
+        }
+        new_capacity *= hash_map->growth_factor;
+    }
 
-    return true;
+    if (new_capacity == hash_map->capacity){
+        return true;
+    }
 
+    return resize(hash_map, new_capacity);
 }
 
 /**
- * gets a vector and a key and checks if a pair with a key is in the vector
- * @param vector a bucket in hash map
- * @param key the key to find
- * @return the index of the pair with that key, -1 otherwise.
+ * @def PARALLEL_MAX_THREADS
+ * the most threads hashmap_from_array and hashmap_apply_if_parallel run.
  */
-int get_pair_by_key(vector* vector , const_keyT key){
+#define PARALLEL_MAX_THREADS 64
 
-    pair* cur_pair;
-    for (int i = 0; i < vector->size ; ++i) {
-        cur_pair = vector->data[i];
-        if (cur_pair->key_cmp(cur_pair->key, key) == true){
-            return i;
-        }
+/**
+ * returns the number of threads to run.
+ * @param requested the number asked for, 0 for one per core.
+ */
+static size_t thread_count (size_t requested){
 
+    if (requested == 0){
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        requested = cores > 1 ? (size_t) cores : 1;
     }
 
-    return VACANT;
-
+    return requested < PARALLEL_MAX_THREADS ? requested :
+           PARALLEL_MAX_THREADS;
 }
+
 /**
- * Inserts a new in_pair to the hash map.
- * The function inserts *new*, *copied*, *dynamically allocated* in_pair,
- * NOT the in_pair it receives as a parameter.
- * @param hash_map the hash map to be inserted with new element.
- * @param in_pair a in_pair the hash map would contain.
- * @return returns 1 for successful insertion, 0 otherwise.
+ * @struct build_task
+ * the share of one thread of hashmap_from_array.
+ * @param hash_map the hash map being built.
+ * @param pairs, entries the pairs, and the entries copied from them (NULL
+ * once linked to the hash map, or for skipped pairs).
+ * @param order the indices of the entries grouped by part, in the order of
+ * the pairs within every part.
+ * @param first, end the pairs the thread copies.
+ * @param part, n_parts the thread links the entries of the part-th of
+ * n_parts ranges of buckets.
+ * @param counts the number of entries the thread copied for every part,
+ * then where the next of them goes in order.
+ * @param order_first, order_end the indices in order of the entries of the
+ * part the thread links.
+ * @param unique whether to skip the duplicates check.
+ * @param linked the number of entries the thread linked.
+ * @param failed whether an allocation failed.
  */
-int hashmap_insert (hashmap *hash_map, const pair *in_pair){
-
-    if (hash_map == NULL || in_pair == NULL){
-        return false;
-    }
-    // activate hash function on the pair.
-    size_t hash_key = hash_map->hash_func(in_pair->key)  &
-            (hash_map->capacity - 1);
+typedef struct build_task {
+    hashmap *hash_map;
+    pair *const *pairs;
+    entry **entries;
+    size_t *order;
+    size_t first;
+    size_t end;
+    size_t part;
+    size_t n_parts;
+    size_t counts[PARALLEL_MAX_THREADS];
+    size_t order_first;
+    size_t order_end;
+    int unique;
+    size_t linked;
+    int failed;
+} build_task;
 
-    // get to the proper bucket in the vector.
-    vector* cur_vector = hash_map->buckets[hash_key];
+/**
+ * the part of the buckets an entry is linked by.
+ */
+static size_t build_part_of (const build_task *task, const entry *cur_entry){
+    size_t capacity = task->hash_map->capacity;
+    return (cur_entry->hash & (capacity - 1)) * task->n_parts / capacity;
+}
 
-    if (get_pair_by_key(cur_vector,in_pair->key) == VACANT){
+/**
+ * copies the pairs of a task into entries, and counts them per part.
+ */
+static void *build_copy (void *arg){
 
-        // this means there is no value like this in the vector so we can
-        // insert it.
-        int value_addition = vector_push_back(cur_vector, in_pair);
+    build_task *task = arg;
+    hashmap *hash_map = task->hash_map;
 
-        // check the insertion to the vector was ok
-        if (!value_addition) {
-            return false;
-        }
+    for (size_t i = task->first; i < task->end; ++i) {
 
-        hash_map->size += 1;
+        const pair *cur_pair = task->pairs[i];
 
-        if (hashmap_get_load_factor(hash_map) > HASH_MAP_MAX_LOAD_FACTOR){
+        if (cur_pair == NULL){
+            continue;
+        }
 
-            // there are too many values in hashmap, so it needs to be resized.
-            hash_map->capacity *= HASH_MAP_GROWTH_FACTOR;
+        task->entries[i] = entry_alloc(&hash_map->ops, &hash_map->mem,
+                                       cur_pair->key, cur_pair->value,
+                                       hash_map->hash_func(cur_pair->key));
+        if (task->entries[i] == NULL){
+            task->failed = true;
+            return NULL;
+        }
+        task->counts[build_part_of(task, task->entries[i])] += 1;
+    }
 
-            int is_success = assign_all_pairs(hash_map, INSERT);
+    return NULL;
+}
 
-            if (!is_success) {
+/**
+ * writes the indices of the entries a task copied to their parts of order.
+ * counts holds where every part of the task starts.
+ */
+static void *build_order (void *arg){
 
-                // the reassign of the pairs was unsuccessful so size and
-                // capacity changes needs to be undone.
-                hash_map->size -= 1;
-                hash_map->capacity /= HASH_MAP_GROWTH_FACTOR;
-                vector_erase(cur_vector, hash_map->size);
-                return false;
-            }
+    build_task *task = arg;
 
+    for (size_t i = task->first; i < task->end; ++i) {
+        if (task->entries[i] != NULL){
+            size_t part = build_part_of(task, task->entries[i]);
+            task->order[task->counts[part]++] = i;
         }
-
-        // finally, the new value is in the hash map.
-        return true;
-
     }
 
-    // this means that the value with the same key is already in hash map.
-    return false;
-
+    return NULL;
 }
 
 /**
- * The function returns the value associated with the given key.
- * @param hash_map a hash map.
- * @param key the key to be checked.
- * @return the value associated with key if exists, NULL otherwise (the value itself,
- * not a copy of it).
+ * links the entries of the buckets of a task, in the order of the pairs.
+ * Tasks own distinct buckets, so they can run at once on the buckets of
+ * HASHMAP_CHAINING, and every task only walks its own entries.
  */
-valueT hashmap_at (const hashmap *hash_map, const_keyT key){
+static void *build_link (void *arg){
 
-    if (key == NULL || hash_map == NULL){
-        return NULL;
-    }
+    build_task *task = arg;
+    hashmap *hash_map = task->hash_map;
 
-    // first get the hash code for the key and the vector in that index.
-    size_t hash_key = hash_map->hash_func(key) & (hash_map->capacity - 1);
+    for (size_t j = task->order_first; j < task->order_end && !task->failed;
+         ++j) {
 
-    const vector *cur_vector = hash_map->buckets[hash_key];
+        size_t i = task->order[j];
+        entry *cur_entry = task->entries[i];
 
-    for (int i = 0 ; i < cur_vector->size ; ++i){
+        if (!task->unique &&
+            hash_map->engine->find(hash_map, cur_entry->hash,
+                                   cur_entry->key) != NULL){
 
-        // get the current pair for every index
-        pair *cur_Value = vector_at(cur_vector, i);
+            // a later pair of a key that is already in the hash map.
+            entry_free(&task->entries[i], &hash_map->ops, &hash_map->mem);
+            continue;
+        }
 
-        // compare between the key given and the key in that pair, if they are
-        // the same this is the value we need to return.
-        if (cur_Value->key_cmp(key, cur_Value->key) == true){
-            return cur_Value->value;
+        // only a task that owns all the buckets may resize them.
+        int is_linked = task->n_parts == 1 ?
+                        hashmap_engine_insert(hash_map, cur_entry) :
+                        hash_map->engine->insert(hash_map, cur_entry->hash,
+                                                 cur_entry);
+        if (!is_linked){
+            task->failed = true;
+            continue;
         }
 
+        task->entries[i] = NULL;
+        task->linked += 1;
     }
 
-    // if the loop has ended it means there is no pair with that key in the cur
-    // bucket, and that means pair with this key is not in hashmap.
     return NULL;
 }
 
+/**
+ * turns the counts of the tasks into where their entries go in order: the
+ * parts one after the other, and in every part the tasks in the order of
+ * their pairs. Sets the range of order every part is linked from.
+ */
+static void build_offsets (build_task *tasks, size_t n_tasks,
+                           size_t n_parts){
 
+    size_t offset = 0;
+
+    for (size_t p = 0; p < n_parts; ++p) {
+        tasks[p].order_first = offset;
+        for (size_t t = 0; t < n_tasks; ++t) {
+            size_t count = tasks[t].counts[p];
+            tasks[t].counts[p] = offset;
+            offset += count;
+        }
+        tasks[p].order_end = offset;
+    }
+}
 
 /**
- * The function erases the pair associated with key.
- * @param hash_map a hash map.
- * @param key a key of the pair to be erased.
- * @return 1 if the erasing was done successfully, 0 otherwise. (if key not in map,
- * considered fail).
+ * runs func on every task, on a thread each (the last one on the calling
+ * thread).
+ * @return 1 on success, 0 if one of them failed.
  */
-int hashmap_erase (hashmap *hash_map, const_keyT key){
+static int build_run (void *(*func) (void *), build_task *tasks,
+                      size_t n_tasks){
 
-    if (hash_map == NULL || key == NULL){
-        return false;
-    }
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    size_t started = 0;
 
-    // first we need to check if hash map contains a value with this key.
-    valueT given_key_value = hashmap_at(hash_map, key);
+    while (started + 1 < n_tasks &&
+           pthread_create(&threads[started], NULL, func,
+                          &tasks[started]) == 0) {
+        started += 1;
+    }
 
-    if (given_key_value == NULL){
-        // there is nothing to delete
-        return false;
+    // the tasks that got no thread run here.
+    for (size_t t = started; t < n_tasks; ++t) {
+        func(&tasks[t]);
     }
 
-    int erase_succsses = false;
+    int is_success = true;
+    for (size_t t = 0; t < n_tasks; ++t) {
+        if (t < started){
+            pthread_join(threads[t], NULL);
+        }
+        if (tasks[t].failed){
+            is_success = false;
+        }
+    }
 
-    pair* cur_pair = NULL;
+    return is_success;
+}
 
-    // get the hash key and the vector in that index
-    size_t hash_value = hash_map->hash_func(key) & (hash_map->capacity - 1);
+/**
+ * Builds a hash map of copies of n pairs at once: the storage is sized once
+ * for all of them, so it is never rehashed. Like inserting the pairs one by
+ * one, the first pair of every key wins.
+ * @param pairs the pairs, NULL ones are skipped. All of them share the
+ * functions of the first one.
+ * @param n the number of pairs.
+ * @param func a function which "hashes" keys.
+ * @param backend the storage engine of the new hash map.
+ * @param flags HASHMAP_BUILD_UNIQUE, HASHMAP_BUILD_PARALLEL or 0.
+ * @return pointer to dynamically allocated hashmap.
+ * @if_fail return NULL.
+ */
+hashmap *hashmap_from_array (pair *const *pairs, size_t n, hash_func func,
+                             hashmap_backend backend, unsigned flags){
 
-    vector* proper_vector = hash_map->buckets[hash_value];
+    if (pairs == NULL && n > 0){
+        return NULL;
+    }
 
-    // find the pair in the vector
-    for (int i = 0; i < proper_vector->size; ++i) {
+    hashmap *hash_map = hashmap_alloc_backend(func, backend);
 
-        cur_pair = proper_vector->data[i];
+    if (hash_map == NULL || !hashmap_reserve(hash_map, n)){
+        hashmap_free(&hash_map);
+        return NULL;
+    }
 
-        if (cur_pair->key_cmp(cur_pair->key, key)){
-            erase_succsses = vector_erase(proper_vector, i);
+    for (size_t i = 0; i < n; ++i) {
+        if (pairs[i] != NULL){
+            adopt_ops(hash_map, pairs[i]);
             break;
         }
+    }
+
+    entry **entries = calloc(n > 0 ? n : 1, sizeof(entry *));
+    size_t *order = malloc((n > 0 ? n : 1) * sizeof(size_t));
 
+    if (entries == NULL || order == NULL){
+        free(entries);
+        free(order);
+        hashmap_free(&hash_map);
+        return NULL;
     }
 
-    // iteration on the pairs in the vector has ended, check if a value was
-    // deleted successfully
-    if (!erase_succsses){
-        return erase_succsses;
+    size_t n_threads = 1;
+    if ((flags & HASHMAP_BUILD_PARALLEL) && n >= HASH_MAP_PARALLEL_MIN_PAIRS){
+        n_threads = thread_count(0);
     }
 
-    hash_map->size -= 1;
+    // the buckets of chaining are independent, open addressing probes
+    // across ranges so it links on one thread.
+    size_t n_parts = backend == HASHMAP_CHAINING ? n_threads : 1;
+
+    build_task tasks[PARALLEL_MAX_THREADS];
+    for (size_t t = 0; t < n_threads; ++t) {
+        build_task task = {hash_map, pairs, entries, order,
+                           n * t / n_threads, n * (t + 1) / n_threads, t,
+                           n_parts, {0}, 0, 0,
+                           (flags & HASHMAP_BUILD_UNIQUE) != 0, 0, false};
+        tasks[t] = task;
+    }
 
-    // now check if a resizing of the hash map is required
-    if (hashmap_get_load_factor(hash_map) < HASH_MAP_MIN_LOAD_FACTOR){
+    int is_success = build_run(build_copy, tasks, n_threads);
 
-        hash_map->capacity /= HASH_MAP_GROWTH_FACTOR;
+    if (is_success){
 
-        int is_success = assign_all_pairs(hash_map, DELETE);
+        // every part gets its own range of order, so each link task walks
+        // only the entries of its buckets.
+        build_offsets(tasks, n_threads, n_parts);
+        build_run(build_order, tasks, n_threads);
 
-        if (!is_success){
+        is_success = build_run(build_link, tasks, n_parts);
+        for (size_t t = 0; t < n_parts; ++t) {
+            hash_map->size += tasks[t].linked;
+        }
+    }
 
-            // the reassign wasn't successful, so everything must be back in
-            // place
-            hash_map->size += 1;
-            hash_map->capacity *= HASH_MAP_GROWTH_FACTOR;
-            vector_push_back(proper_vector, cur_pair);
-            return false;
+    if (!is_success){
 
+        // whatever was not linked yet is freed here, the rest with the map.
+        for (size_t i = 0; i < n; ++i) {
+            entry_free(&entries[i], &hash_map->ops, &hash_map->mem);
         }
+        hashmap_free(&hash_map);
+    }
 
-        // if we got here then the re assign was successful and the
-        // pair is of the hash map
-        return true;
+    free(entries);
+    free(order);
+    return hash_map;
+}
+
+/**
+ * Fills the probe length statistics of the pairs stored in the hash map.
+ * Only HASHMAP_ROBIN_HOOD keeps probe lengths. Takes a pass over the slots.
+ * @param hash_map a hash map.
+ * @param stats the statistics to fill.
+ * @return 1 on success, 0 otherwise.
+ */
+int hashmap_get_probe_stats (const hashmap *hash_map,
+                             hashmap_probe_stats *stats){
 
+    if (hash_map == NULL || stats == NULL ||
+        hash_map->engine->probe_stats == NULL){
+        return false;
     }
 
+    hash_map->engine->probe_stats(hash_map, stats);
     return true;
 }
 
@@ -394,6 +1319,83 @@ double hashmap_get_load_factor (const hashmap *hash_map){
 
 
 
+/**
+ * Starts a walk over the pairs of a hash map, in no particular order
+ * (insertion order for HASHMAP_COMPACT):
+ *   hashmap_iter iter = hashmap_iter_begin(map);
+ *   while (hashmap_iter_next(&iter, &key, &value)) { ... }
+ * A walk skips the empty parts of the storage a word or a group at a time,
+ * so it costs about the number of pairs rather than the capacity. Pairs
+ * must not be inserted and other pairs not erased while walking, the pair
+ * returned last can be erased by hashmap_iter_erase.
+ * @param hash_map a hash map, NULL for an empty walk.
+ * @return the walk, before its first pair.
+ */
+hashmap_iter hashmap_iter_begin (hashmap *hash_map){
+    hashmap_iter iter = {hash_map, {0, 0, 0}, NULL};
+    return iter;
+}
+
+/**
+ * Moves a walk to its next pair.
+ * @param iter a walk started by hashmap_iter_begin.
+ * @param key set to the key of the pair (the stored one, not to be
+ * modified), may be NULL.
+ * @param value set to the value of the pair (the stored one), may be NULL.
+ * @return 1 if there was a next pair, 0 at the end of the walk.
+ */
+int hashmap_iter_next (hashmap_iter *iter, const_keyT *key, valueT *value){
+
+    if (iter == NULL || iter->hash_map == NULL){
+        return false;
+    }
+
+    iter->slot = iter->hash_map->engine->next(iter->hash_map, &iter->cursor);
+
+    if (iter->slot == NULL){
+        return false;
+    }
+
+    if (key != NULL){
+        *key = (*iter->slot)->key;
+    }
+    if (value != NULL){
+        *value = (*iter->slot)->value;
+    }
+    return true;
+}
+
+/**
+ * Erases the pair hashmap_iter_next returned last and frees it. The walk
+ * goes on with the pairs it has not returned yet, each one once. The hash
+ * map does not shrink during the walk, a later hashmap_erase may shrink it.
+ * @param iter a walk started by hashmap_iter_begin.
+ * @return 1 if the pair was erased, 0 otherwise (no pair returned yet, or
+ * it was already erased).
+ */
+int hashmap_iter_erase (hashmap_iter *iter){
+
+    if (iter == NULL || iter->slot == NULL){
+        return false;
+    }
+
+    hashmap *hash_map = iter->hash_map;
+
+    // no rehash step and no shrink here, they would move the pairs under
+    // the walk.
+    entry *old_entry = hash_map->engine->erase(hash_map, iter->slot);
+    entry_free(&old_entry, &hash_map->ops, &hash_map->mem);
+    if (hash_map->engine->erased != NULL){
+        hash_map->engine->erased(hash_map, &iter->cursor);
+    }
+    iter->slot = NULL;
+
+    hash_map->size -= 1;
+    count_since_resize(hash_map);
+
+    return true;
+}
+
 /**
  * This function receives a hashmap and 2 functions, the first checks a condition on the keys,
  * and the seconds apply some modification on the values. The function should apply the modification
@@ -412,27 +1414,153 @@ int hashmap_apply_if (const hashmap *hash_map, keyT_func keyT_func,
 
     int changed_values = 0;
 
-    for (int i = 0; i < hash_map->capacity ; ++i) {
+    if (hash_map == NULL || keyT_func == NULL || valT_func == NULL){
+        return changed_values;
+    }
+
+    hashmap_cursor cursor = {0, 0, 0};
+    entry **slot;
+
+    while ((slot = hash_map->engine->next(hash_map, &cursor)) != NULL) {
+
+        //get the cur entry
+        entry* cur_entry = *slot;
+
+        // check if the condition applies on the cur entry key
+        if (keyT_func(cur_entry->key) == true){
+
+            // the condition applies so activate the val func on the cur
+            // entry value.
+            valT_func(cur_entry->value);
+            changed_values += 1;
+        }
+    }
+
+    return changed_values;
+}
+
+/**
+ * @struct apply_job
+ * the work hashmap_apply_if_parallel shares between its threads.
+ * @param hash_map, keyT_func, valT_func the arguments of the call.
+ * @param positions the number of buckets (or slots) of the storage.
+ * @param chunk_size the number of buckets a thread takes at a time.
+ * @param next_chunk the first bucket no thread took yet.
+ * @param changed_values the number of values the threads changed.
+ */
+typedef struct apply_job {
+    const hashmap *hash_map;
+    keyT_func keyT_func;
+    valueT_func valT_func;
+    size_t positions;
+    size_t chunk_size;
+    _Atomic size_t next_chunk;
+    _Atomic size_t changed_values;
+} apply_job;
+
+/**
+ * takes chunks of buckets until there are none left, and applies the
+ * functions of the job on their pairs.
+ */
+static void *apply_chunks (void *arg){
 
-        //get the current vector
-        vector* cur_vector = hash_map->buckets[i];
+    apply_job *job = arg;
+    size_t changed_values = 0;
 
-        for (int j = 0; j < cur_vector->size; ++j) {
+    for (;;) {
 
-            //get the cur pair
-            pair* cur_pair = vector_at(cur_vector, j);
+        size_t first = atomic_fetch_add_explicit(&job->next_chunk,
+                                                 job->chunk_size,
+                                                 memory_order_relaxed);
+        if (first >= job->positions){
+            break;
+        }
 
-            // check if the condition applies on the cur pair key
-            if (keyT_func(cur_pair->key) == true){
+        size_t end = job->positions - first > job->chunk_size ?
+                     first + job->chunk_size : job->positions;
+        hashmap_cursor cursor = {first, 0, end};
+        entry **slot;
 
-                // the condition applies so activate the val func on the cur
-                // pair value.
-                valT_func(cur_pair->value);
+        while ((slot = job->hash_map->engine->next(job->hash_map,
+                                                   &cursor)) != NULL) {
+            if (job->keyT_func((*slot)->key) == true){
+                job->valT_func((*slot)->value);
                 changed_values += 1;
             }
-
         }
     }
 
-    return changed_values;
+    atomic_fetch_add_explicit(&job->changed_values, changed_values,
+                              memory_order_relaxed);
+    return NULL;
+}
+
+/**
+ * Like hashmap_apply_if, on several threads: the buckets (or slots) are
+ * cut into chunks of chunk_size, every thread takes the next chunk nobody
+ * took yet until there are none left, so threads that hit dense chunks
+ * don't hold the others back.
+ *
+ * keyT_func and valT_func are called from all the threads at once, on
+ * distinct pairs: each value is changed by one thread, but anything else
+ * the functions share (counters, allocators, other maps) needs its own
+ * synchronization. The hash map must not be changed until the call
+ * returns.
+ * @param hash_map a hashmap
+ * @param keyT_func a function that checks a condition on keyT and return 1 if true, 0 else
+ * @param valT_func a function that modifies valueT, in-place
+ * @param n_threads the number of threads, the calling one included. 0 for
+ * one per core.
+ * @param chunk_size the number of buckets a thread takes at a time, 0 for
+ * HASH_MAP_APPLY_CHUNK.
+ * @return number of changed values, summed over the threads
+ */
+size_t hashmap_apply_if_parallel (const hashmap *hash_map,
+                                  keyT_func keyT_func, valueT_func valT_func,
+                                  size_t n_threads, size_t chunk_size){
+
+    if (hash_map == NULL || keyT_func == NULL || valT_func == NULL){
+        return 0;
+    }
+
+    size_t positions = hash_map->engine->positions(hash_map);
+
+    if (positions == 0){
+        return 0;
+    }
+
+    if (chunk_size == 0){
+        chunk_size = HASH_MAP_APPLY_CHUNK;
+    }
+    if (chunk_size > positions){
+        chunk_size = positions;
+    }
+
+    // no more threads than chunks.
+    n_threads = thread_count(n_threads);
+    size_t n_chunks = (positions + chunk_size - 1) / chunk_size;
+    if (n_threads > n_chunks){
+        n_threads = n_chunks;
+    }
+
+    apply_job job = {hash_map, keyT_func, valT_func, positions, chunk_size,
+                     0, 0};
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    size_t started = 0;
+
+    while (started + 1 < n_threads &&
+           pthread_create(&threads[started], NULL, apply_chunks,
+                          &job) == 0) {
+        started += 1;
+    }
+
+    // the calling thread takes chunks too, and all of them if no thread
+    // could be started.
+    apply_chunks(&job);
+
+    for (size_t t = 0; t < started; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+
+    return atomic_load(&job.changed_values);
 }
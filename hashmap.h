@@ -2,8 +2,11 @@
 #define HASHMAP_H_
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "vector.h"
 #include "pair.h"
+#include "entry.h"
+#include "allocator.h"
 
 /**
  * @def HASH_MAP_INITIAL_CAP
@@ -41,6 +44,52 @@
  */
 #define HASH_MAP_MAX_LOAD_FACTOR 0.75
 
+/**
+ * @def HASH_MAP_REHASH_STEP
+ * The number of buckets an insert or an erase moves to the new buckets
+ * array while an incremental rehash is in progress.
+ */
+#define HASH_MAP_REHASH_STEP 4UL
+
+/**
+ * @def HASH_MAP_BATCH_WINDOW
+ * The number of keys the batch functions hash ahead of their lookups.
+ */
+#define HASH_MAP_BATCH_WINDOW 64UL
+
+/**
+ * @def HASH_MAP_PREFETCH_DISTANCE
+ * The number of lookups between two prefetch levels of one key in the
+ * batch functions, enough for a cache miss to arrive meanwhile.
+ */
+#define HASH_MAP_PREFETCH_DISTANCE 4UL
+
+/**
+ * @def HASHMAP_BUILD_UNIQUE, HASHMAP_BUILD_PARALLEL
+ * Flags of hashmap_from_array.
+ * HASHMAP_BUILD_UNIQUE - the caller guarantees the keys are unique, so they
+ * are not checked for duplicates.
+ * HASHMAP_BUILD_PARALLEL - the pairs are copied (and, for HASHMAP_CHAINING,
+ * linked) by one thread per core. The hash function and the functions of
+ * the pairs must be thread safe.
+ */
+#define HASHMAP_BUILD_UNIQUE 1U
+#define HASHMAP_BUILD_PARALLEL 2U
+
+/**
+ * @def HASH_MAP_APPLY_CHUNK
+ * The number of buckets (or slots) a thread of hashmap_apply_if_parallel
+ * takes at a time, when asked for 0.
+ */
+#define HASH_MAP_APPLY_CHUNK 4096UL
+
+/**
+ * @def HASH_MAP_PARALLEL_MIN_PAIRS
+ * hashmap_from_array builds smaller maps on one thread, even with
+ * HASHMAP_BUILD_PARALLEL.
+ */
+#define HASH_MAP_PARALLEL_MIN_PAIRS 4096UL
+
 /**
  * @typedef hash_func
  * This type of function receives a keyT and returns
@@ -63,28 +112,289 @@ typedef int (*keyT_func) (const_keyT);
  */
 typedef void (*valueT_func) (valueT);
 
+/**
+ * @enum hashmap_backend
+ * The storage engine a hash map keeps its pairs in.
+ * HASHMAP_CHAINING - an array of buckets, every bucket is a vector of pairs.
+ * HASHMAP_SWISS - open addressing over a flat slot array, with one control
+ * byte per slot holding a 7 bit tag of the key's hash. The control bytes are
+ * probed in groups, so most lookups touch one group and one pair.
+ * HASHMAP_ROBIN_HOOD - open addressing with linear probing, every slot
+ * keeps the probe length of its pair. An insert takes the slot of any pair
+ * closer to its home slot than the new pair, so probe lengths stay short and
+ * even up to a max load factor of 0.95: a lookup of a missing key stops at
+ * the first such pair, and erase shifts the pairs after it back instead of
+ * leaving tombstones.
+ * HASHMAP_CUCKOO - bucketized cuckoo hashing: every pair is in one of two
+ * buckets of 4 slots (one cache line each) picked by two mixes of its hash,
+ * or in a small stash, so a lookup reads at most two buckets. An insert into
+ * two full buckets moves pairs to their other bucket along the shortest
+ * path found by a breadth first search; with no path and a full stash the
+ * hash map grows.
+ * HASHMAP_COMPACT - the pairs are appended to a dense array of entries, in
+ * insertion order, and found through a sparse index of 8, 16, 32 or 64 bit
+ * positions into it (the smallest width that fits the capacity), probed
+ * linearly. Walks (hashmap_iter_next, hashmap_apply_if) return the pairs in
+ * insertion order. Erasing leaves a hole in the dense array until the next
+ * rehash compacts it.
+ */
+typedef enum hashmap_backend {
+    HASHMAP_CHAINING,
+    HASHMAP_SWISS,
+    HASHMAP_ROBIN_HOOD,
+    HASHMAP_CUCKOO,
+    HASHMAP_COMPACT
+} hashmap_backend;
+
+/**
+ * @typedef hashmap_engine
+ * The operations of a storage engine, see hashmap_engine.h.
+ */
+typedef struct hashmap_engine hashmap_engine;
+
+/**
+ * @struct hashmap_cursor
+ * A position inside the storage of a hash map, used to walk over its pairs.
+ * A zeroed cursor points before the first pair.
+ * @param bucket the bucket (or slot) index.
+ * @param index the index inside the bucket for engines that chain pairs,
+ * engine defined otherwise.
+ * @param end the walk stops before this bucket, 0 to walk to the end of
+ * the storage. A cursor starting at bucket b with end e walks the pairs of
+ * [b, e), so walks over distinct ranges never share a pair.
+ */
+typedef struct hashmap_cursor {
+    size_t bucket;
+    size_t index;
+    size_t end;
+} hashmap_cursor;
+
+/**
+ * @typedef cuckoo_table
+ * The storage of a HASHMAP_CUCKOO hash map, see cuckoo_table.c.
+ */
+typedef struct cuckoo_table cuckoo_table;
+
+/**
+ * @typedef compact_table
+ * The storage of a HASHMAP_COMPACT hash map, see compact_table.c.
+ */
+typedef struct compact_table compact_table;
+
+/**
+ * @struct hashmap_probe_stats
+ * How many slots the lookups of the stored pairs compare.
+ * @param max_probe_length the most slots a lookup of a stored pair compares,
+ * 0 for an empty hash map.
+ * @param mean_probe_length the mean over the stored pairs.
+ */
+typedef struct hashmap_probe_stats {
+    size_t max_probe_length;
+    double mean_probe_length;
+} hashmap_probe_stats;
+
+/**
+ * @struct hashmap_config
+ * How a hash map is stored and when it grows or shrinks. A zeroed
+ * hashmap_config gives the defaults: the HASH_MAP_* macros above.
+ * @param backend the storage engine.
+ * @param initial_capacity the capacity to start with, rounded up to a power
+ * of 2. 0 for HASH_MAP_INITIAL_CAP.
+ * @param growth_factor the factor the capacity grows (and shrinks) by, a
+ * power of 2. 0 for HASH_MAP_GROWTH_FACTOR.
+ * @param max_load_factor the hash map grows when its load factor goes above
+ * it. 0 for HASH_MAP_MAX_LOAD_FACTOR. Chaining takes any positive value
+ * (above 1 for denser maps), the other backends at most their own maximum:
+ * 0.875 for swiss and compact, 0.95 for Robin Hood and cuckoo.
+ * @param min_load_factor the hash map shrinks when its load factor drops
+ * below it. 0 for HASH_MAP_MIN_LOAD_FACTOR. A shrink must leave the load
+ * factor below max_load_factor: min_load_factor * growth_factor has to be
+ * smaller than max_load_factor, unless no_shrink is set.
+ * @param no_shrink 1 to never shrink, e.g. for latency sensitive maps.
+ * @param hysteresis the number of inserts and erases that must follow a
+ * resize before the hash map may shrink, so maps that churn around
+ * min_load_factor don't shrink and grow back over and over.
+ * @param incremental_rehash 1 to rehash incrementally (see
+ * hashmap_set_incremental_rehash).
+ * @param ops the functions of the keys and the values, NULL to take them
+ * from the first pair inserted (see hashmap_alloc_ops).
+ * @param mem the allocator, NULL for malloc (see hashmap_alloc_allocator).
+ */
+typedef struct hashmap_config {
+    hashmap_backend backend;
+    size_t initial_capacity;
+    size_t growth_factor;
+    double max_load_factor;
+    double min_load_factor;
+    int no_shrink;
+    size_t hysteresis;
+    int incremental_rehash;
+    const pair_ops *ops;
+    const allocator *mem;
+} hashmap_config;
+
 /**
  * @struct hashmap
- * @param buckets dynamic array of vectors which stores the values.
+ * @param buckets dynamic array of vectors which stores the values
+ * (HASHMAP_CHAINING only).
+ * @param occupied one bit per bucket, set for every bucket that may hold
+ * pairs, so walks skip the empty ones (HASHMAP_CHAINING only).
  * @param size the number of elements (pairs) stored in the hash map.
- * @param capacity the number of buckets in the hash map.
+ * @param capacity the number of buckets (or slots) in the hash map.
  * @param hash_func a function which "hashes" keys.
+ * @param backend the storage engine the hash map was allocated with.
+ * @param engine the operations of that storage engine.
+ * @param ctrl one control byte per slot (HASHMAP_SWISS only).
+ * @param probe_lens the probe length of the pair in every slot, 0 for an
+ * empty slot (HASHMAP_ROBIN_HOOD only).
+ * @param cuckoo the buckets and the stash (HASHMAP_CUCKOO only).
+ * @param compact the entries and their index (HASHMAP_COMPACT only).
+ * @param slots the flat slot array of entries (open addressing engines only).
+ * @param tombstones the number of slots marked as deleted (for
+ * HASHMAP_COMPACT, the holes of the entries array).
+ * @param incremental_rehash 1 if resizes move the buckets a few at a time,
+ * see hashmap_set_incremental_rehash.
+ * @param old_buckets the buckets array being moved away from, while an
+ * incremental rehash is in progress (NULL otherwise).
+ * @param old_capacity the number of buckets in old_buckets.
+ * @param rehash_index the old buckets below this index were already moved.
+ * @param mem the allocator the hash map, its storage and its entries come
+ * from (zeroed for malloc).
+ * @param ops the functions of the keys and the values, shared by all the
+ * entries.
+ * @param has_ops 0 until ops is known: a hash map allocated without
+ * pair_ops takes them from the first pair inserted.
+ * @param growth_factor, max_load_factor, min_load_factor, no_shrink,
+ * hysteresis the resize policy, see hashmap_config.
+ * @param since_resize the number of inserts and erases since the last
+ * resize, up to hysteresis.
  */
 typedef struct hashmap {
     vector **buckets;
+    uint64_t *occupied;
     size_t size;
     size_t capacity; // num of buckets
     hash_func hash_func;
+    hashmap_backend backend;
+    const hashmap_engine *engine;
+    uint8_t *ctrl;
+    uint16_t *probe_lens;
+    entry **slots;
+    cuckoo_table *cuckoo;
+    compact_table *compact;
+    size_t tombstones;
+    int incremental_rehash;
+    vector **old_buckets;
+    size_t old_capacity;
+    size_t rehash_index;
+    allocator mem;
+    pair_ops ops;
+    int has_ops;
+    size_t growth_factor;
+    double max_load_factor;
+    double min_load_factor;
+    int no_shrink;
+    size_t hysteresis;
+    size_t since_resize;
 } hashmap;
 
 /**
- * Allocates dynamically new hash map element.
+ * @struct hashmap_iter
+ * A walk over the pairs of a hash map, see hashmap_iter_begin.
+ * @param hash_map the hash map walked over.
+ * @param cursor the position of the walk in the storage.
+ * @param slot the slot of the pair returned last, NULL before the first
+ * pair and after it was erased.
+ */
+typedef struct hashmap_iter {
+    hashmap *hash_map;
+    hashmap_cursor cursor;
+    entry **slot;
+} hashmap_iter;
+
+/**
+ * Allocates dynamically new hash map element, that stores its pairs in
+ * vectors chained from the buckets (HASHMAP_CHAINING).
  * @param func a function which "hashes" keys.
  * @return pointer to dynamically allocated hashmap.
  * @if_fail return NULL.
  */
 hashmap *hashmap_alloc (hash_func func);
 
+/**
+ * Allocates dynamically new hash map element, with the given storage engine.
+ * All the other hashmap functions behave the same for every engine.
+ * @param func a function which "hashes" keys.
+ * @param backend the storage engine of the new hash map.
+ * @return pointer to dynamically allocated hashmap.
+ * @if_fail return NULL.
+ */
+hashmap *hashmap_alloc_backend (hash_func func, hashmap_backend backend);
+
+/**
+ * Allocates a new hash map element with the given storage engine, that
+ * draws all its memory (the hash map itself, its buckets, vectors and pairs)
+ * from the given allocator, e.g. arena_allocator of an arena (see arena.h).
+ * Keys and values are still copied by key_cpy and value_cpy.
+ * @param func a function which "hashes" keys.
+ * @param backend the storage engine of the new hash map.
+ * @param mem the allocator, NULL for malloc. Its ctx must outlive the map.
+ * @return pointer to the allocated hashmap.
+ * @if_fail return NULL.
+ */
+hashmap *hashmap_alloc_allocator (hash_func func, hashmap_backend backend,
+                                  const allocator *mem);
+
+/**
+ * Allocates a new hash map element, whose keys and values all share the
+ * given functions. The hash map stores every pair as an entry (key, value
+ * and hash) and keeps the functions once, instead of in every pair. The
+ * functions of the pairs inserted later are ignored.
+ * @param func a function which "hashes" keys.
+ * @param backend the storage engine of the new hash map.
+ * @param ops the functions of the keys and the values, NULL to take them
+ * from the first pair inserted.
+ * @param mem the allocator, NULL for malloc. Its ctx must outlive the map.
+ * @return pointer to the allocated hashmap.
+ * @if_fail return NULL.
+ */
+hashmap *hashmap_alloc_ops (hash_func func, hashmap_backend backend,
+                            const pair_ops *ops, const allocator *mem);
+
+/**
+ * Allocates a new hash map element, configured by config: its storage
+ * engine, its functions and allocator, and when it grows and shrinks.
+ * @param func a function which "hashes" keys.
+ * @param config the configuration, NULL for the defaults.
+ * @return pointer to the allocated hashmap.
+ * @if_fail return NULL, also for an invalid configuration.
+ */
+hashmap *hashmap_alloc_config (hash_func func, const hashmap_config *config);
+
+/**
+ * Turns incremental rehashing on or off. When it is on, growing or
+ * shrinking the hash map only allocates the new buckets array; the pairs
+ * move there HASH_MAP_REHASH_STEP buckets at a time, by the following
+ * inserts and erases (or by hashmap_rehash_step). Until then lookups search
+ * both arrays, and capacity already reports the new number of buckets.
+ * Turning it off finishes a rehash in progress.
+ * Only HASHMAP_CHAINING supports it.
+ * @param hash_map a hash map.
+ * @param enabled 1 to turn it on, 0 to turn it off.
+ * @return 1 on success, 0 otherwise.
+ */
+int hashmap_set_incremental_rehash (hashmap *hash_map, int enabled);
+
+/**
+ * Moves the pairs of up to n old buckets of an incremental rehash in
+ * progress, e.g. to finish it while the hash map is idle.
+ * hashmap_at never moves pairs, so it is safe to call it from many readers.
+ * @param hash_map a hash map.
+ * @param n the number of old buckets to move.
+ * @return 1 if a rehash is still in progress afterwards, 0 otherwise.
+ */
+int hashmap_rehash_step (hashmap *hash_map, size_t n);
+
 /**
  * Frees a hash map and the elements the hash map itself allocated.
  * @param p_hash_map pointer to dynamically allocated pointer to hash_map.
@@ -94,13 +404,61 @@ void hashmap_free (hashmap **p_hash_map);
 /**
  * Inserts a new in_pair to the hash map.
  * The function inserts *new*, *copied*, *dynamically allocated* in_pair,
- * NOT the in_pair it receives as a parameter.
+ * NOT the in_pair it receives as a parameter. The key and the value are
+ * copied with the hash map's pair_ops (the ones of the first pair, unless it
+ * was allocated with hashmap_alloc_ops).
  * @param hash_map the hash map to be inserted with new element.
  * @param in_pair a in_pair the hash map would contain.
  * @return returns 1 for successful insertion, 0 otherwise.
  */
 int hashmap_insert (hashmap *hash_map, const pair *in_pair);
 
+/**
+ * Inserts the key and the value of in_pair to the hash map, without copying
+ * them. Build in_pair with pair_alloc, or with pair_adopt to hand over a key
+ * and a value that are already allocated.
+ * @param hash_map the hash map to be inserted with new element.
+ * @param in_pair a dynamically allocated pair. On success the hash map owns
+ * its key and value (and frees them on erase or on hashmap_free) and frees
+ * the pair struct itself, on failure the caller still owns all of it.
+ * @return returns 1 for successful insertion, 0 otherwise (e.g. when the key
+ * is already in the hash map).
+ */
+int hashmap_insert_take (hashmap *hash_map, pair *in_pair);
+
+/**
+ * Returns the value of key, inserting key with a copy of value first if it
+ * is not in the hash map yet. The key is hashed once and looked up once, so
+ * a counter is updated in place without hashmap_at before hashmap_insert:
+ *   int zero = 0;
+ *   int *count = hashmap_find_or_insert(map, word, &zero, NULL);
+ *   *count += 1;
+ * @param hash_map a hash map that knows its pair_ops (allocated with
+ * hashmap_alloc_ops, or after its first insert).
+ * @param key the key to be looked up, copied only when inserted.
+ * @param value the value of a new pair, copied only when inserted.
+ * @param inserted if not NULL, set to 1 when the pair was inserted, else 0.
+ * @return the value of key in the hash map (the value itself, which may be
+ * modified in place until the pair is erased), NULL on failure.
+ */
+valueT hashmap_find_or_insert (hashmap *hash_map, const_keyT key,
+                               const_valueT value, int *inserted);
+
+/**
+ * Inserts a copy of in_pair to the hash map, or, if its key is already
+ * there, replaces the value of that key with a copy of the value of
+ * in_pair. Like hashmap_find_or_insert, the key is hashed and looked up
+ * once.
+ * @param hash_map the hash map to be inserted with new element.
+ * @param in_pair a in_pair the hash map would contain.
+ * @param inserted if not NULL, set to 1 when the pair was inserted, 0 when
+ * the value was assigned.
+ * @return returns 1 for successful insertion or assignment, 0 otherwise
+ * (then the hash map is left as it was).
+ */
+int hashmap_insert_or_assign (hashmap *hash_map, const pair *in_pair,
+                              int *inserted);
+
 /**
  * The function returns the value associated with the given key.
  * @param hash_map a hash map.
@@ -119,6 +477,107 @@ valueT hashmap_at (const hashmap *hash_map, const_keyT key);
  */
 int hashmap_erase (hashmap *hash_map, const_keyT key);
 
+/**
+ * Like hashmap_at, for a key given as raw bytes: parsers can look keys up
+ * straight from their input, without building a key object. The stored
+ * keys are compared with the bytes by the key_cmp_bytes of the pair_ops of
+ * the hash map (see hashmap_alloc_ops).
+ * @param hash_map a hash map whose pair_ops have key_cmp_bytes.
+ * @param bytes the bytes of the key.
+ * @param len the number of bytes.
+ * @param hash the hash of the key, the one hash_func gives for its key
+ * object (e.g. hash_bytes(bytes, len, HASH_DEFAULT_SEED) for hash_string).
+ * @return the value associated with the key if exists, NULL otherwise (the
+ * value itself, not a copy of it).
+ */
+valueT hashmap_at_bytes (const hashmap *hash_map, const void *bytes,
+                         size_t len, size_t hash);
+
+/**
+ * Like hashmap_erase, for a key given as raw bytes (see hashmap_at_bytes).
+ * @param hash_map a hash map whose pair_ops have key_cmp_bytes.
+ * @param bytes the bytes of the key.
+ * @param len the number of bytes.
+ * @param hash the hash of the key, the one hash_func gives for its key
+ * object.
+ * @return 1 if the erasing was done successfully, 0 otherwise.
+ */
+int hashmap_erase_bytes (hashmap *hash_map, const void *bytes, size_t len,
+                         size_t hash);
+
+/**
+ * Looks up n keys at once, like calling hashmap_at for each of them, but
+ * faster for big maps: the keys are hashed first, then the memory of every
+ * lookup is prefetched a few lookups ahead, so many cache misses are in
+ * flight at the same time instead of one after the other.
+ * @param hash_map a hash map.
+ * @param keys the keys to be checked.
+ * @param n the number of keys.
+ * @param out_values out_values[i] is set to the value of keys[i] (the value
+ * itself, not a copy of it), or to NULL if it is not in the hash map.
+ * @return the number of keys found, 0 if the function failed.
+ */
+size_t hashmap_at_batch (const hashmap *hash_map, const_keyT *keys, size_t n,
+                         valueT *out_values);
+
+/**
+ * Inserts copies of n pairs, like calling hashmap_insert for each of them,
+ * prefetching like hashmap_at_batch.
+ * @param hash_map the hash map to be inserted with new elements.
+ * @param pairs the pairs the hash map would contain.
+ * @param n the number of pairs.
+ * @return the number of pairs inserted (a pair whose key is already in the
+ * hash map is not), 0 if the function failed.
+ */
+size_t hashmap_insert_batch (hashmap *hash_map, pair *const *pairs,
+                             size_t n);
+
+/**
+ * Erases the pairs of n keys, like calling hashmap_erase for each of them,
+ * prefetching like hashmap_at_batch.
+ * @param hash_map a hash map.
+ * @param keys the keys of the pairs to be erased.
+ * @param n the number of keys.
+ * @return the number of pairs erased, 0 if the function failed.
+ */
+size_t hashmap_erase_batch (hashmap *hash_map, const_keyT *keys, size_t n);
+
+/**
+ * Makes room for n pairs: grows the hash map once to the capacity n pairs
+ * need, so the next inserts up to n pairs don't rehash. A hash map that is
+ * already big enough is left as it is.
+ * @param hash_map a hash map.
+ * @param n the number of pairs the hash map will hold.
+ * @return 1 on success, 0 otherwise (then the hash map is left untouched).
+ */
+int hashmap_reserve (hashmap *hash_map, size_t n);
+
+/**
+ * Builds a hash map of copies of n pairs at once: the storage is sized once
+ * for all of them, so it is never rehashed. Like inserting the pairs one by
+ * one, the first pair of every key wins.
+ * @param pairs the pairs, NULL ones are skipped. All of them share the
+ * functions of the first one.
+ * @param n the number of pairs.
+ * @param func a function which "hashes" keys.
+ * @param backend the storage engine of the new hash map.
+ * @param flags HASHMAP_BUILD_UNIQUE, HASHMAP_BUILD_PARALLEL or 0.
+ * @return pointer to dynamically allocated hashmap.
+ * @if_fail return NULL.
+ */
+hashmap *hashmap_from_array (pair *const *pairs, size_t n, hash_func func,
+                             hashmap_backend backend, unsigned flags);
+
+/**
+ * Fills the probe length statistics of the pairs stored in the hash map.
+ * Only HASHMAP_ROBIN_HOOD keeps probe lengths. Takes a pass over the slots.
+ * @param hash_map a hash map.
+ * @param stats the statistics to fill.
+ * @return 1 on success, 0 otherwise.
+ */
+int hashmap_get_probe_stats (const hashmap *hash_map,
+                             hashmap_probe_stats *stats);
+
 /**
  * This function returns the load factor of the hash map.
  * @param hash_map a hash map.
@@ -126,6 +585,40 @@ int hashmap_erase (hashmap *hash_map, const_keyT key);
  */
 double hashmap_get_load_factor (const hashmap *hash_map);
 
+/**
+ * Starts a walk over the pairs of a hash map, in no particular order
+ * (insertion order for HASHMAP_COMPACT):
+ *   hashmap_iter iter = hashmap_iter_begin(map);
+ *   while (hashmap_iter_next(&iter, &key, &value)) { ... }
+ * A walk skips the empty parts of the storage a word or a group at a time,
+ * so it costs about the number of pairs rather than the capacity. Pairs
+ * must not be inserted and other pairs not erased while walking, the pair
+ * returned last can be erased by hashmap_iter_erase.
+ * @param hash_map a hash map, NULL for an empty walk.
+ * @return the walk, before its first pair.
+ */
+hashmap_iter hashmap_iter_begin (hashmap *hash_map);
+
+/**
+ * Moves a walk to its next pair.
+ * @param iter a walk started by hashmap_iter_begin.
+ * @param key set to the key of the pair (the stored one, not to be
+ * modified), may be NULL.
+ * @param value set to the value of the pair (the stored one), may be NULL.
+ * @return 1 if there was a next pair, 0 at the end of the walk.
+ */
+int hashmap_iter_next (hashmap_iter *iter, const_keyT *key, valueT *value);
+
+/**
+ * Erases the pair hashmap_iter_next returned last and frees it. The walk
+ * goes on with the pairs it has not returned yet, each one once. The hash
+ * map does not shrink during the walk, a later hashmap_erase may shrink it.
+ * @param iter a walk started by hashmap_iter_begin.
+ * @return 1 if the pair was erased, 0 otherwise (no pair returned yet, or
+ * it was already erased).
+ */
+int hashmap_iter_erase (hashmap_iter *iter);
+
 /**
  * This function receives a hashmap and 2 functions, the first checks a condition on the keys,
  * and the seconds apply some modification on the values. The function should apply the modification
@@ -140,4 +633,28 @@ double hashmap_get_load_factor (const hashmap *hash_map);
  * @return number of changed values
  */
 int hashmap_apply_if (const hashmap *hash_map, keyT_func keyT_func, valueT_func valT_func);//const
+
+/**
+ * Like hashmap_apply_if, on several threads: the buckets (or slots) are
+ * cut into chunks of chunk_size, every thread takes the next chunk nobody
+ * took yet until there are none left, so threads that hit dense chunks
+ * don't hold the others back.
+ *
+ * keyT_func and valT_func are called from all the threads at once, on
+ * distinct pairs: each value is changed by one thread, but anything else
+ * the functions share (counters, allocators, other maps) needs its own
+ * synchronization. The hash map must not be changed until the call
+ * returns.
+ * @param hash_map a hashmap
+ * @param keyT_func a function that checks a condition on keyT and return 1 if true, 0 else
+ * @param valT_func a function that modifies valueT, in-place
+ * @param n_threads the number of threads, the calling one included. 0 for
+ * one per core.
+ * @param chunk_size the number of buckets a thread takes at a time, 0 for
+ * HASH_MAP_APPLY_CHUNK.
+ * @return number of changed values, summed over the threads
+ */
+size_t hashmap_apply_if_parallel (const hashmap *hash_map,
+                                  keyT_func keyT_func, valueT_func valT_func,
+                                  size_t n_threads, size_t chunk_size);
 #endif //HASHMAP_H_
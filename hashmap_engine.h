@@ -0,0 +1,155 @@
+#ifndef HASHMAP_ENGINE_H_
+#define HASHMAP_ENGINE_H_
+
+#include "hashmap.h"
+#include "entry.h"
+
+/**
+ * @def HASHMAP_PREFETCH_LEVELS
+ * The number of levels of hashmap_engine.prefetch.
+ */
+#define HASHMAP_PREFETCH_LEVELS 4
+
+/**
+ * @def HASHMAP_PREFETCH
+ * Hints the CPU to start loading the cache line of an address.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define HASHMAP_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define HASHMAP_PREFETCH(addr) ((void) (addr))
+#endif
+
+/**
+ * @typedef engine_key_match
+ * compares the key of a stored pair with the key an engine looks for: a key
+ * object (len is unused) or len raw bytes. returns 1 if same, else 0.
+ * Engines search through one function for both, and find and find_bytes
+ * pass engine_match_key or engine_match_bytes.
+ */
+typedef int (*engine_key_match) (const hashmap *hash_map, const_keyT stored,
+                                 const void *key, size_t len);
+
+static inline int engine_match_key(const hashmap *hash_map, const_keyT stored,
+                                   const void *key, size_t len){
+    (void) len;
+    return hash_map->ops.key_cmp(stored, key) == 1;
+}
+
+static inline int engine_match_bytes(const hashmap *hash_map,
+                                     const_keyT stored, const void *key,
+                                     size_t len){
+    return hash_map->ops.key_cmp_bytes(stored, key, len) == 1;
+}
+
+/**
+ * @struct hashmap_engine
+ * The operations every storage engine implements. hashmap.c owns the
+ * policy (when to grow or shrink, duplicates check, counting the size),
+ * the engine only owns the memory layout.
+ * @param min_capacity the smallest capacity the engine can work with.
+ * @param max_load_factor the highest max load factor the engine can work
+ * with, 0 for no limit.
+ * @param init allocates the storage for hash_map->capacity buckets,
+ * returns 1 on success, 0 otherwise.
+ * @param destroy frees the storage and every pair stored in it.
+ * @param find returns the slot holding the pair with the given key, NULL if
+ * there is no such pair.
+ * @param find_bytes like find, for a key given as len raw bytes, compared
+ * by the key_cmp_bytes of the hash map.
+ * @param insert links new_entry (which the engine now owns) to the storage.
+ * The key of new_entry must not be in the hash map. returns 1 on success,
+ * 0 otherwise (then the caller still owns new_entry), e.g. when the storage
+ * has no room left for it: engines never grow on their own, see
+ * hashmap_engine_insert.
+ * @param erase unlinks the pair in the given slot (as returned by find) and
+ * returns it, the caller frees it.
+ * @param rehash moves all pairs to a new storage of new_capacity buckets
+ * (or, with incremental rehashing, starts moving them) and updates
+ * hash_map->capacity. returns 1 on success, 0 otherwise (then the hash map
+ * is left untouched).
+ * @param next returns the slot of the pair at the cursor and advances the
+ * cursor, NULL when there are no more pairs before cursor->end.
+ * @param rehash_step moves the pairs of up to n buckets of an incremental
+ * rehash in progress, returns 1 if the rehash is still in progress.
+ * NULL for engines that always rehash at once.
+ * @param prefetch starts loading the memory a find of hash will read, one
+ * level of pointers at a time: level 0 only computes addresses, every next
+ * level reads what the level before prefetched. Called for levels 0 to
+ * HASHMAP_PREFETCH_LEVELS - 1, far enough apart for each level to arrive.
+ * @param probe_stats fills the probe length statistics of the stored pairs.
+ * NULL for engines that don't keep probe lengths.
+ * @param erased called after the pair the cursor returned last was erased:
+ * moves the cursor back if erase moved a pair the cursor has not returned
+ * yet to where the cursor already went, so next returns every pair once.
+ * NULL for engines whose erase moves no pair.
+ * @param positions returns the number of buckets a cursor walks over,
+ * cursor->bucket goes from 0 up to it.
+ */
+struct hashmap_engine {
+    size_t min_capacity;
+    double max_load_factor;
+    int (*init) (hashmap *hash_map);
+    void (*destroy) (hashmap *hash_map);
+    entry **(*find) (const hashmap *hash_map, size_t hash, const_keyT key);
+    entry **(*find_bytes) (const hashmap *hash_map, size_t hash,
+                           const void *bytes, size_t len);
+    int (*insert) (hashmap *hash_map, size_t hash, entry *new_entry);
+    entry *(*erase) (hashmap *hash_map, entry **slot);
+    int (*rehash) (hashmap *hash_map, size_t new_capacity);
+    entry **(*next) (const hashmap *hash_map, hashmap_cursor *cursor);
+    int (*rehash_step) (hashmap *hash_map, size_t n);
+    void (*prefetch) (const hashmap *hash_map, size_t hash, int level);
+    void (*probe_stats) (const hashmap *hash_map, hashmap_probe_stats *stats);
+    void (*erased) (const hashmap *hash_map, hashmap_cursor *cursor);
+    size_t (*positions) (const hashmap *hash_map);
+};
+
+/**
+ * The engine of HASHMAP_CHAINING, see chain_table.c.
+ */
+extern const hashmap_engine chain_engine;
+
+/**
+ * hashmap_insert, hashmap_at and hashmap_erase for the wrappers of this
+ * library that hash the keys themselves (e.g. concurrent_hashmap picks a
+ * stripe by the hash), so the user hash function runs once per operation.
+ * hash must be the hash_func of the hash map applied to the key.
+ */
+int hashmap_insert_hashed (hashmap *hash_map, const pair *in_pair,
+                           size_t hash);
+valueT hashmap_at_hashed (const hashmap *hash_map, const_keyT key,
+                          size_t hash);
+int hashmap_erase_hashed (hashmap *hash_map, const_keyT key, size_t hash);
+
+/**
+ * Links new_entry (which the hash map owns on success) to the storage of
+ * the hash map through hashmap_engine.insert. If the engine has no room for
+ * it, the hash map grows by its growth factor (resetting the hysteresis
+ * count, like every resize) and the engine tries once more. Does not count
+ * the pair in hash_map->size.
+ * @return 1 on success, 0 otherwise (then the caller still owns new_entry).
+ */
+int hashmap_engine_insert (hashmap *hash_map, entry *new_entry);
+
+/**
+ * The engine of HASHMAP_SWISS, see swiss_table.c.
+ */
+extern const hashmap_engine swiss_engine;
+
+/**
+ * The engine of HASHMAP_ROBIN_HOOD, see robin_table.c.
+ */
+extern const hashmap_engine robin_engine;
+
+/**
+ * The engine of HASHMAP_CUCKOO, see cuckoo_table.c.
+ */
+extern const hashmap_engine cuckoo_engine;
+
+/**
+ * The engine of HASHMAP_COMPACT, see compact_table.c.
+ */
+extern const hashmap_engine compact_engine;
+
+#endif //HASHMAP_ENGINE_H_
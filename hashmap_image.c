@@ -0,0 +1,397 @@
+#include "hashmap_image.h"
+#include "hashmap_engine.h"
+#include "hash_funcs.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @def IMAGE_MAGIC
+ * The first bytes of every image.
+ */
+#define IMAGE_MAGIC "HMAPIMG"
+
+/**
+ * @def IMAGE_BYTE_ORDER
+ * Written in the byte order of the writer, an image written on a machine
+ * of the other byte order does not read back as it.
+ */
+#define IMAGE_BYTE_ORDER 0x01020304U
+
+/**
+ * @def IMAGE_MIN_CAPACITY
+ * The smallest number of slots of an image.
+ */
+#define IMAGE_MIN_CAPACITY 8UL
+
+/**
+ * @def IMAGE_RECORD_HEADER
+ * The size of the key size and the value size in front of every record.
+ */
+#define IMAGE_RECORD_HEADER (2 * sizeof(uint64_t))
+
+/**
+ * @def IMAGE_TMP_SUFFIX
+ * The mkstemp template suffix of the temporary file an image is written to.
+ */
+#define IMAGE_TMP_SUFFIX ".XXXXXX"
+
+/**
+ * @def IMAGE_MODE
+ * The permissions of an image file: written by its owner, read by anyone.
+ * Set with fchmod, so the umask of the process does not apply.
+ */
+#define IMAGE_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)
+
+/**
+ * @struct hashmap_image_header
+ * @param magic IMAGE_MAGIC.
+ * @param version HASHMAP_IMAGE_VERSION.
+ * @param byte_order IMAGE_BYTE_ORDER.
+ * @param size the number of pairs.
+ * @param capacity the number of slots.
+ * @param slots_offset the offset of the slots from the start of the image.
+ * @param length the size of the whole image.
+ */
+struct hashmap_image_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;
+    uint64_t capacity;
+    uint64_t slots_offset;
+    uint64_t length;
+};
+
+/**
+ * rounds n up to a multiple of HASHMAP_IMAGE_ALIGN.
+ */
+static size_t image_align(size_t n){
+    return (n + HASHMAP_IMAGE_ALIGN - 1) & ~(HASHMAP_IMAGE_ALIGN - 1);
+}
+
+/**
+ * the slot a pair with the given hash would like to be in.
+ */
+static size_t image_home(uint64_t hash, size_t capacity){
+    return (size_t) hash_mix64(hash) & (capacity - 1);
+}
+
+/**
+ * the number of slots for size pairs: a power of 2 that keeps the load
+ * factor under HASH_MAP_MAX_LOAD_FACTOR, so probe sequences stay short and
+ * always end at an empty slot.
+ */
+static size_t image_capacity(size_t size){
+    size_t capacity = IMAGE_MIN_CAPACITY;
+    while ((double) size > (double) capacity * HASH_MAP_MAX_LOAD_FACTOR) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/**
+ * writes n zero bytes.
+ * @return 1 on success, 0 otherwise.
+ */
+static int write_padding(FILE *file, size_t n){
+    static const unsigned char zeros[HASHMAP_IMAGE_ALIGN] = {0};
+    return n == 0 || fwrite(zeros, 1, n, file) == n;
+}
+
+/**
+ * writes the header, the slots and the records of the pairs. The records
+ * are written in the order the slots were filled, so their offsets match.
+ * @return 1 on success, 0 otherwise.
+ */
+static int write_records(const hashmap *hash_map, FILE *file,
+                         const hashmap_image_header *header,
+                         const hashmap_image_slot *slots,
+                         pair_key_size key_size, pair_value_size value_size){
+
+    if (fwrite(header, sizeof(*header), 1, file) != 1 ||
+        !write_padding(file, header->slots_offset - sizeof(*header)) ||
+        fwrite(slots, sizeof(hashmap_image_slot), header->capacity,
+               file) != header->capacity){
+        return false;
+    }
+
+    hashmap_cursor cursor = {0, 0, 0};
+    entry **slot;
+
+    while ((slot = hash_map->engine->next(hash_map, &cursor)) != NULL) {
+
+        uint64_t sizes[2] = {key_size((*slot)->key),
+                             value_size((*slot)->value)};
+
+        if (fwrite(sizes, sizeof(sizes), 1, file) != 1 ||
+            fwrite((*slot)->key, 1, sizes[0], file) != sizes[0] ||
+            !write_padding(file, image_align(sizes[0]) - sizes[0]) ||
+            fwrite((*slot)->value, 1, sizes[1], file) != sizes[1] ||
+            !write_padding(file, image_align(sizes[1]) - sizes[1])){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Writes the pairs of a hash map to a file as an image. The file is written
+ * to a new temporary file next to path and renamed over it once complete,
+ * so processes that mapped an older image at path keep reading it unharmed,
+ * and processes writing the same image at once never mix their files.
+ * @param hash_map a hash map, not modified meanwhile.
+ * @param path the path of the file.
+ * @param key_size returns the number of bytes of a key.
+ * @param value_size returns the number of bytes of a value.
+ * @return 1 on success, 0 otherwise (then path is left as it was).
+ */
+int hashmap_write_image (const hashmap *hash_map, const char *path,
+                         pair_key_size key_size, pair_value_size value_size){
+
+    if (hash_map == NULL || path == NULL){
+        return false;
+    }
+
+    // the size functions the pairs were stored by come first.
+    if (hash_map->ops.key_size != NULL){
+        key_size = hash_map->ops.key_size;
+    }
+    if (hash_map->ops.value_size != NULL){
+        value_size = hash_map->ops.value_size;
+    }
+    if (key_size == NULL || value_size == NULL){
+        return false;
+    }
+
+    hashmap_image_header header = {IMAGE_MAGIC, HASHMAP_IMAGE_VERSION,
+                                   IMAGE_BYTE_ORDER, hash_map->size,
+                                   image_capacity(hash_map->size),
+                                   image_align(sizeof(hashmap_image_header)),
+                                   0};
+
+    hashmap_image_slot *slots = calloc(header.capacity,
+                                       sizeof(hashmap_image_slot));
+    if (slots == NULL){
+        return false;
+    }
+
+    // first pass: the offset of every record, and its slot.
+    size_t offset = header.slots_offset +
+                    header.capacity * sizeof(hashmap_image_slot);
+    size_t mask = header.capacity - 1;
+    hashmap_cursor cursor = {0, 0, 0};
+    entry **slot;
+
+    while ((slot = hash_map->engine->next(hash_map, &cursor)) != NULL) {
+
+        size_t i = image_home((*slot)->hash, header.capacity);
+        while (slots[i].offset != 0) {
+            i = (i + 1) & mask;
+        }
+        slots[i].hash = (*slot)->hash;
+        slots[i].offset = offset;
+
+        offset += IMAGE_RECORD_HEADER +
+                  image_align(key_size((*slot)->key)) +
+                  image_align(value_size((*slot)->value));
+    }
+    header.length = offset;
+
+    // second pass: write it all to a temporary file of its own next to
+    // path, so writers of the same image never share one.
+    size_t path_len = strlen(path);
+    char *tmp_path = malloc(path_len + sizeof(IMAGE_TMP_SUFFIX));
+    if (tmp_path == NULL){
+        free(slots);
+        return false;
+    }
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, IMAGE_TMP_SUFFIX, sizeof(IMAGE_TMP_SUFFIX));
+
+    int fd = mkstemp(tmp_path);
+    if (fd < 0){
+        free(tmp_path);
+        free(slots);
+        return false;
+    }
+
+    // mkstemp makes the file private, images are read by other processes.
+    FILE *file = fchmod(fd, IMAGE_MODE) == 0 ? fdopen(fd, "wb") : NULL;
+    if (file == NULL){
+        close(fd);
+    }
+    int is_success = file != NULL &&
+                     write_records(hash_map, file, &header, slots, key_size,
+                                   value_size);
+
+    if (file != NULL && fclose(file) != 0){
+        is_success = false;
+    }
+    if (is_success && rename(tmp_path, path) != 0){
+        is_success = false;
+    }
+    if (!is_success){
+        remove(tmp_path);
+    }
+
+    free(tmp_path);
+    free(slots);
+    return is_success;
+}
+
+/**
+ * checks the header of a mapping of the given length.
+ * @return 1 if it is a valid image, 0 otherwise.
+ */
+static int check_header(const hashmap_image_header *header, size_t length){
+
+    if (memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+        header->version != HASHMAP_IMAGE_VERSION ||
+        header->byte_order != IMAGE_BYTE_ORDER ||
+        header->length != length){
+        return false;
+    }
+
+    uint64_t capacity = header->capacity;
+    if (capacity < IMAGE_MIN_CAPACITY || (capacity & (capacity - 1)) != 0 ||
+        header->size >= capacity ||
+        header->slots_offset % HASHMAP_IMAGE_ALIGN != 0 ||
+        header->slots_offset > length ||
+        capacity > (length - header->slots_offset) /
+                   sizeof(hashmap_image_slot)){
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Maps an image written by hashmap_write_image, read-only. Only the header
+ * is read, the pages of the pairs are read by the lookups that need them.
+ * @param path the path of the file.
+ * @param func the hash function of the hash map the image was written from.
+ * @param key_cmp compares the keys, like the key_cmp of its pairs.
+ * @return pointer to dynamically allocated hashmap_image.
+ * @if_fail return NULL, also for a file that is not a valid image.
+ */
+hashmap_image *hashmap_open_mmap (const char *path, hash_func func,
+                                  pair_key_cmp key_cmp){
+
+    if (path == NULL || func == NULL || key_cmp == NULL){
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        st.st_size < (off_t) sizeof(hashmap_image_header)){
+        close(fd);
+        return NULL;
+    }
+
+    size_t length = (size_t) st.st_size;
+    void *base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+
+    // the mapping keeps the file open by itself.
+    close(fd);
+
+    if (base == MAP_FAILED){
+        return NULL;
+    }
+
+    const hashmap_image_header *header = base;
+    hashmap_image *image = malloc(sizeof(hashmap_image));
+
+    if (image == NULL || !check_header(header, length)){
+        free(image);
+        munmap(base, length);
+        return NULL;
+    }
+
+    image->base = base;
+    image->length = length;
+    image->size = header->size;
+    image->capacity = header->capacity;
+    image->slots = (const hashmap_image_slot *) (image->base +
+                                                 header->slots_offset);
+    image->hash_func = func;
+    image->key_cmp = key_cmp;
+
+    return image;
+}
+
+/**
+ * Unmaps an image and frees it. The values it returned are invalid after.
+ * @param p_image pointer to dynamically allocated pointer to the image.
+ */
+void hashmap_image_close (hashmap_image **p_image){
+
+    if (p_image == NULL || *p_image == NULL){
+        return;
+    }
+
+    munmap((void *) (*p_image)->base, (*p_image)->length);
+    free(*p_image);
+    *p_image = NULL;
+}
+
+/**
+ * The function returns the value associated with the given key, like
+ * hashmap_at. It only reads the image, so many threads may call it at once.
+ * @param image an image.
+ * @param key the key to be checked.
+ * @return the value associated with key inside the mapping if exists, NULL
+ * otherwise.
+ */
+const_valueT hashmap_image_at (const hashmap_image *image, const_keyT key){
+
+    if (image == NULL || key == NULL){
+        return NULL;
+    }
+
+    uint64_t hash = image->hash_func(key);
+    size_t mask = image->capacity - 1;
+    size_t i = image_home(hash, image->capacity);
+
+    // the records are checked against the length of the mapping, so a
+    // damaged image fails lookups instead of reading past its end.
+    for (size_t probes = 0; probes < image->capacity;
+         ++probes, i = (i + 1) & mask) {
+
+        const hashmap_image_slot *slot = &image->slots[i];
+        if (slot->offset == 0){
+            return NULL;
+        }
+        if (slot->hash != hash ||
+            slot->offset > image->length - IMAGE_RECORD_HEADER){
+            continue;
+        }
+
+        const unsigned char *record = image->base + slot->offset;
+        uint64_t sizes[2];
+        memcpy(sizes, record, sizeof(sizes));
+
+        size_t rest = image->length - slot->offset - IMAGE_RECORD_HEADER;
+        if (sizes[0] > rest || image_align(sizes[0]) > rest ||
+            sizes[1] > rest - image_align(sizes[0])){
+            continue;
+        }
+
+        const unsigned char *record_key = record + IMAGE_RECORD_HEADER;
+        if (image->key_cmp(record_key, key) == true){
+            return record_key + image_align(sizes[0]);
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,132 @@
+#ifndef HASHMAP_IMAGE_H_
+#define HASHMAP_IMAGE_H_
+
+#include <stdint.h>
+#include "hashmap.h"
+
+/**
+ * @file
+ * A read-only, on-disk copy of a hash map that is looked up in place.
+ *
+ * hashmap_write_image writes the pairs of a hash map to a file as an image:
+ * a header, a table of slots, then the keys and values as raw bytes. The
+ * image holds offsets from its start and no pointers, so it can be mapped
+ * at any address. hashmap_open_mmap maps it read-only and shared, and
+ * lookups read the mapped pages directly: opening costs one mmap whatever
+ * the number of pairs, nothing is allocated per pair, and every process
+ * that opens the same file shares one copy of it in the page cache.
+ *
+ * Keys and values are written as the bytes of their objects, so they must
+ * be flat (no pointers inside), like chars, ints or strings. The value
+ * returned by a lookup points into the mapping: it must not be modified and
+ * is valid until hashmap_image_close.
+ *
+ * Usage:
+ *   hashmap_write_image(map, "table.img", key_size, value_size);
+ *   ...
+ *   hashmap_image *image = hashmap_open_mmap("table.img", hash_func, cmp);
+ *   const_valueT value = hashmap_image_at(image, key);
+ *   hashmap_image_close(&image);
+ */
+
+/**
+ * @def HASHMAP_IMAGE_VERSION
+ * The version of the image format, checked by hashmap_open_mmap.
+ */
+#define HASHMAP_IMAGE_VERSION 1U
+
+/**
+ * @def HASHMAP_IMAGE_ALIGN
+ * The alignment of the keys and the values inside an image.
+ */
+#define HASHMAP_IMAGE_ALIGN 16UL
+
+/**
+ * @struct hashmap_image_slot
+ * A slot of the table of an image, probed linearly from the mixed hash of
+ * a key like the open addressing engines.
+ * @param hash the full hash of the key of the pair.
+ * @param offset the offset of the record of the pair from the start of the
+ * image, 0 for an empty slot. A record is the key size and the value size
+ * (8 bytes each), the key bytes, then the value bytes, each of them at a
+ * multiple of HASHMAP_IMAGE_ALIGN.
+ */
+typedef struct hashmap_image_slot {
+    uint64_t hash;
+    uint64_t offset;
+} hashmap_image_slot;
+
+/**
+ * @typedef hashmap_image_header
+ * The first bytes of an image, see hashmap_image.c.
+ */
+typedef struct hashmap_image_header hashmap_image_header;
+
+/**
+ * @struct hashmap_image
+ * An image mapped by hashmap_open_mmap.
+ * @param base the start of the mapping.
+ * @param length the length of the mapping, the size of the file.
+ * @param size the number of pairs.
+ * @param capacity the number of slots, a power of 2.
+ * @param slots the table of slots, inside the mapping.
+ * @param hash_func the hash function the image was written with.
+ * @param key_cmp compares a key of the image with a looked up key.
+ */
+typedef struct hashmap_image {
+    const unsigned char *base;
+    size_t length;
+    size_t size;
+    size_t capacity;
+    const hashmap_image_slot *slots;
+    hash_func hash_func;
+    pair_key_cmp key_cmp;
+} hashmap_image;
+
+/**
+ * Writes the pairs of a hash map to a file as an image. The file is written
+ * to a new temporary file next to path and renamed over it once complete,
+ * so processes that mapped an older image at path keep reading it unharmed,
+ * and processes writing the same image at once never mix their files.
+ * The file is always readable by everyone (0644), whatever the umask, since
+ * images are meant to be mapped by other processes.
+ * @param hash_map a hash map, not modified meanwhile.
+ * @param path the path of the file.
+ * @param key_size returns the number of bytes of a key, used only if the
+ * pair_ops of the hash map have no key_size. May then be NULL.
+ * @param value_size returns the number of bytes of a value, used only if
+ * the pair_ops of the hash map have no value_size. May then be NULL.
+ * @return 1 on success, 0 otherwise (then path is left as it was).
+ */
+int hashmap_write_image (const hashmap *hash_map, const char *path,
+                         pair_key_size key_size, pair_value_size value_size);
+
+/**
+ * Maps an image written by hashmap_write_image, read-only. Only the header
+ * is read, the pages of the pairs are read by the lookups that need them.
+ * @param path the path of the file.
+ * @param func the hash function of the hash map the image was written from.
+ * @param key_cmp compares the keys, like the key_cmp of its pairs.
+ * @return pointer to dynamically allocated hashmap_image.
+ * @if_fail return NULL, also for a file that is not a valid image.
+ */
+hashmap_image *hashmap_open_mmap (const char *path, hash_func func,
+                                  pair_key_cmp key_cmp);
+
+/**
+ * Unmaps an image and frees it. The values it returned are invalid after.
+ * @param p_image pointer to dynamically allocated pointer to the image.
+ */
+void hashmap_image_close (hashmap_image **p_image);
+
+/**
+ * The function returns the value associated with the given key, like
+ * hashmap_at. It only reads the image, so many threads may call it at once.
+ * @param image an image.
+ * @param key the key to be checked.
+ * @return the value associated with key inside the mapping if exists, NULL
+ * otherwise.
+ */
+const_valueT hashmap_image_at (const hashmap_image *image, const_keyT key);
+
+#endif //HASHMAP_IMAGE_H_
@@ -0,0 +1,440 @@
+#include "hashmap_stream.h"
+#include "hashmap_engine.h"
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+/**
+ * @def STREAM_MAGIC
+ * The first bytes of every snapshot.
+ */
+#define STREAM_MAGIC "HMAPSNP"
+
+/**
+ * @def STREAM_BYTE_ORDER
+ * Written in the byte order of the writer, a snapshot written on a machine
+ * of the other byte order does not read back as it.
+ */
+#define STREAM_BYTE_ORDER 0x01020304U
+
+/**
+ * @def STREAM_MAX_VARINT
+ * The most bytes a varint of 64 bits takes.
+ */
+#define STREAM_MAX_VARINT 10
+
+/**
+ * @def STREAM_MAX_SPARSITY
+ * The most slots per pair (plus HASH_MAP_INITIAL_CAP) a snapshot may ask
+ * for, so a damaged header can not allocate a huge table before any pair
+ * is read.
+ */
+#define STREAM_MAX_SPARSITY 64UL
+
+/**
+ * @struct stream_header
+ * @param magic STREAM_MAGIC.
+ * @param version HASHMAP_STREAM_VERSION.
+ * @param byte_order STREAM_BYTE_ORDER.
+ * @param first_hash the hash of the first saved key, 0 without pairs.
+ * hashmap_load hashes that key again with its hash function, so a snapshot
+ * read with another hash function than the one it was saved with fails.
+ * @param size the number of pairs that follow.
+ * @param capacity, backend, growth_factor, max_load_factor,
+ * min_load_factor, no_shrink, hysteresis those of the saved hash map.
+ */
+typedef struct stream_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t first_hash;
+    uint64_t size;
+    uint64_t capacity;
+    uint32_t backend;
+    uint32_t no_shrink;
+    uint64_t growth_factor;
+    uint64_t hysteresis;
+    double max_load_factor;
+    double min_load_factor;
+} stream_header;
+
+/**
+ * @struct stream_writer
+ * @param file the file written to.
+ * @param buf the bytes not written to the file yet.
+ * @param pos the number of bytes in buf.
+ * @param scratch where keys and values are saved before they are copied to
+ * buf behind their length.
+ * @param scratch_size the size of scratch.
+ * @param failed whether a write or an allocation failed.
+ */
+typedef struct stream_writer {
+    FILE *file;
+    unsigned char *buf;
+    size_t pos;
+    unsigned char *scratch;
+    size_t scratch_size;
+    int failed;
+} stream_writer;
+
+/**
+ * @struct stream_reader
+ * @param file the file read from.
+ * @param buf the bytes read from the file and not taken yet, from start to
+ * end.
+ * @param size the size of buf, more than HASHMAP_STREAM_BUFFER only while
+ * a bigger key or value is taken.
+ */
+typedef struct stream_reader {
+    FILE *file;
+    unsigned char *buf;
+    size_t size;
+    size_t start;
+    size_t end;
+} stream_reader;
+
+static void writer_flush(stream_writer *writer){
+    if (writer->pos > 0 &&
+        fwrite(writer->buf, 1, writer->pos, writer->file) != writer->pos){
+        writer->failed = true;
+    }
+    writer->pos = 0;
+}
+
+static void writer_put(stream_writer *writer, const void *data, size_t n){
+
+    if (n > HASHMAP_STREAM_BUFFER - writer->pos){
+        writer_flush(writer);
+    }
+
+    // a key or value bigger than the buffer goes straight to the file.
+    if (n > HASHMAP_STREAM_BUFFER){
+        if (fwrite(data, 1, n, writer->file) != n){
+            writer->failed = true;
+        }
+        return;
+    }
+
+    memcpy(writer->buf + writer->pos, data, n);
+    writer->pos += n;
+}
+
+static void writer_varint(stream_writer *writer, uint64_t n){
+    unsigned char bytes[STREAM_MAX_VARINT];
+    size_t len = 0;
+
+    while (n >= 0x80) {
+        bytes[len++] = (unsigned char) (n | 0x80);
+        n >>= 7;
+    }
+    bytes[len++] = (unsigned char) n;
+
+    writer_put(writer, bytes, len);
+}
+
+/**
+ * writes the bytes save gives for object, behind their length.
+ */
+static void writer_object(stream_writer *writer, pair_key_save save,
+                          const void *object){
+
+    size_t n = save(object, writer->scratch, writer->scratch_size);
+
+    if (n > writer->scratch_size){
+        unsigned char *scratch = realloc(writer->scratch, n);
+        if (scratch == NULL){
+            writer->failed = true;
+            return;
+        }
+        writer->scratch = scratch;
+        writer->scratch_size = n;
+        save(object, writer->scratch, writer->scratch_size);
+    }
+
+    writer_varint(writer, n);
+    writer_put(writer, writer->scratch, n);
+}
+
+/**
+ * Writes a snapshot of a hash map to file, from its current position.
+ * @param hash_map a hash map whose pair_ops have key_save and value_save
+ * (see hashmap_alloc_ops), not modified meanwhile.
+ * @param file a file open for writing.
+ * @return 1 on success, 0 otherwise (then part of the snapshot may have
+ * been written).
+ */
+int hashmap_save (const hashmap *hash_map, FILE *file){
+
+    if (hash_map == NULL || file == NULL ||
+        (hash_map->size > 0 && (!hash_map->has_ops ||
+                                hash_map->ops.key_save == NULL ||
+                                hash_map->ops.value_save == NULL))){
+        return false;
+    }
+
+    stream_writer writer = {file, malloc(HASHMAP_STREAM_BUFFER), 0,
+                            malloc(HASHMAP_STREAM_BUFFER),
+                            HASHMAP_STREAM_BUFFER, false};
+
+    if (writer.buf == NULL || writer.scratch == NULL){
+        free(writer.buf);
+        free(writer.scratch);
+        return false;
+    }
+
+    hashmap_cursor first = {0, 0, 0};
+    entry **first_slot = hash_map->engine->next(hash_map, &first);
+
+    stream_header header = {STREAM_MAGIC, HASHMAP_STREAM_VERSION,
+                            STREAM_BYTE_ORDER,
+                            first_slot == NULL ? 0 : (*first_slot)->hash,
+                            hash_map->size, hash_map->capacity,
+                            (uint32_t) hash_map->backend,
+                            (uint32_t) hash_map->no_shrink,
+                            hash_map->growth_factor, hash_map->hysteresis,
+                            hash_map->max_load_factor,
+                            hash_map->min_load_factor};
+    writer_put(&writer, &header, sizeof(header));
+
+    hashmap_cursor cursor = {0, 0, 0};
+    entry **slot;
+
+    while (!writer.failed &&
+           (slot = hash_map->engine->next(hash_map, &cursor)) != NULL) {
+        writer_object(&writer, hash_map->ops.key_save, (*slot)->key);
+        writer_object(&writer, hash_map->ops.value_save, (*slot)->value);
+    }
+
+    writer_flush(&writer);
+
+    free(writer.buf);
+    free(writer.scratch);
+    return !writer.failed;
+}
+
+/**
+ * takes the next n bytes of the file.
+ * @return a pointer to them, valid until the next take. NULL if the file
+ * ends before them or an allocation failed.
+ */
+static const unsigned char *reader_take(stream_reader *reader, size_t n){
+
+    if (reader->end - reader->start < n){
+
+        memmove(reader->buf, reader->buf + reader->start,
+                reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+
+        if (n > reader->size){
+            unsigned char *buf = realloc(reader->buf, n);
+            if (buf == NULL){
+                return NULL;
+            }
+            reader->buf = buf;
+            reader->size = n;
+        }
+
+        while (reader->end < n) {
+            size_t got = fread(reader->buf + reader->end, 1,
+                               reader->size - reader->end, reader->file);
+            if (got == 0){
+                return NULL;
+            }
+            reader->end += got;
+        }
+    }
+
+    const unsigned char *bytes = reader->buf + reader->start;
+    reader->start += n;
+    return bytes;
+}
+
+/**
+ * reads a varint.
+ * @return 1 on success, 0 if the file ended or the varint is too long.
+ */
+static int reader_varint(stream_reader *reader, uint64_t *n){
+
+    *n = 0;
+    for (int shift = 0; shift < 7 * STREAM_MAX_VARINT; shift += 7) {
+        const unsigned char *byte = reader_take(reader, 1);
+        if (byte == NULL){
+            return false;
+        }
+        *n |= (uint64_t) (*byte & 0x7f) << shift;
+        if ((*byte & 0x80) == 0){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * reads a length-prefixed object and allocates it with load.
+ * @return the object, NULL on failure.
+ */
+static void *reader_object(stream_reader *reader, pair_key_load load){
+
+    uint64_t n;
+    if (!reader_varint(reader, &n) || n > SIZE_MAX){
+        return NULL;
+    }
+
+    const unsigned char *bytes = reader_take(reader, (size_t) n);
+    return bytes == NULL ? NULL : load(bytes, (size_t) n);
+}
+
+/**
+ * the largest capacity a hash map loaded from header may start with: the
+ * capacity hashmap_reserve picks for its pairs under its max load factor,
+ * times its growth factor, so a saved hash map that grew just before it was
+ * saved keeps its capacity.
+ * @return the capacity, 0 if the header asks for too sparse a table.
+ */
+static size_t stream_capacity_limit(const stream_header *header){
+
+    if (header->size > SIZE_MAX / STREAM_MAX_SPARSITY - HASH_MAP_INITIAL_CAP ||
+        header->growth_factor < 2 || !(header->max_load_factor > 0)){
+        return 0;
+    }
+
+    size_t most = ((size_t) header->size + HASH_MAP_INITIAL_CAP) *
+                  STREAM_MAX_SPARSITY;
+    size_t capacity = HASH_MAP_INITIAL_CAP;
+
+    while ((double) header->size >
+           (double) capacity * header->max_load_factor) {
+        if (capacity > most / header->growth_factor){
+            return 0;
+        }
+        capacity *= (size_t) header->growth_factor;
+    }
+
+    return capacity > most / header->growth_factor ? most :
+           capacity * (size_t) header->growth_factor;
+}
+
+/**
+ * reads the pairs of a snapshot into a hash map presized for them.
+ * @param first_hash the hash the first key had when it was saved.
+ * @return 1 on success, 0 otherwise.
+ */
+static int load_pairs(hashmap *hash_map, stream_reader *reader, size_t n,
+                      uint64_t first_hash){
+
+    const pair_ops *ops = &hash_map->ops;
+
+    for (size_t i = 0; i < n; ++i) {
+
+        keyT key = reader_object(reader, ops->key_load);
+        valueT value = key == NULL ? NULL :
+                       reader_object(reader, ops->value_load);
+        entry *new_entry = value == NULL ? NULL :
+                           entry_adopt(ops, &hash_map->mem, key, value,
+                                       hash_map->hash_func(key));
+
+        if (new_entry == NULL){
+            if (key != NULL){
+                ops->key_free(&key);
+            }
+            if (value != NULL){
+                ops->value_free(&value);
+            }
+            return false;
+        }
+
+        // the keys of a snapshot are unique, unless it was damaged, and
+        // hash the same as when they were saved, unless func differs.
+        if ((i == 0 && new_entry->hash != first_hash) ||
+            hash_map->engine->find(hash_map, new_entry->hash,
+                                   new_entry->key) != NULL ||
+            !hashmap_engine_insert(hash_map, new_entry)){
+            entry_free(&new_entry, ops, &hash_map->mem);
+            return false;
+        }
+        hash_map->size += 1;
+    }
+
+    return true;
+}
+
+/**
+ * Reads a snapshot written by hashmap_save, from the current position of
+ * file, into a new hash map with the saved storage engine, capacity and
+ * resize policy. The pairs are linked without resizing. A saved capacity
+ * far above what the pairs need is lowered: at most the capacity
+ * hashmap_reserve would pick for them, times the growth factor.
+ * @param file a file open for reading. When it can seek, it is left right
+ * after the snapshot, so several snapshots can follow each other (the load
+ * fails if it can not seek back to there). A file that can not seek at all,
+ * like a pipe, is read ahead, so it holds only one snapshot.
+ * @param func the hash function of the saved hash map. Keys are hashed
+ * again, so it must give the same hashes. The hash of the first key is
+ * saved and checked, so a different func (or another HASH_DEFAULT_SEED)
+ * fails the load, unless it happens to hash that one key the same.
+ * @param ops the functions of the keys and the values, with key_load and
+ * value_load.
+ * @return pointer to dynamically allocated hashmap.
+ * @if_fail return NULL, also for a damaged or truncated snapshot.
+ */
+hashmap *hashmap_load (FILE *file, hash_func func, const pair_ops *ops){
+
+    if (file == NULL || func == NULL || ops == NULL ||
+        ops->key_load == NULL || ops->value_load == NULL){
+        return NULL;
+    }
+
+    stream_reader reader = {file, malloc(HASHMAP_STREAM_BUFFER),
+                            HASHMAP_STREAM_BUFFER, 0, 0};
+    if (reader.buf == NULL){
+        return NULL;
+    }
+
+    stream_header header;
+    const unsigned char *bytes = reader_take(&reader, sizeof(header));
+    hashmap *hash_map = NULL;
+    size_t limit;
+
+    if (bytes != NULL){
+        memcpy(&header, bytes, sizeof(header));
+    }
+
+    if (bytes != NULL &&
+        memcmp(header.magic, STREAM_MAGIC, sizeof(STREAM_MAGIC)) == 0 &&
+        header.version == HASHMAP_STREAM_VERSION &&
+        header.byte_order == STREAM_BYTE_ORDER &&
+        (limit = stream_capacity_limit(&header)) != 0){
+
+        hashmap_config config = {0};
+        config.backend = (hashmap_backend) header.backend;
+        config.initial_capacity = header.capacity < limit ?
+                                  (size_t) header.capacity : limit;
+        config.growth_factor = (size_t) header.growth_factor;
+        config.max_load_factor = header.max_load_factor;
+        config.min_load_factor = header.min_load_factor;
+        config.no_shrink = (int) header.no_shrink;
+        config.hysteresis = (size_t) header.hysteresis;
+        config.ops = ops;
+
+        // the saved capacity fits the pairs unless it was lowered.
+        hash_map = hashmap_alloc_config(func, &config);
+        if (hash_map != NULL &&
+            (!hashmap_reserve(hash_map, (size_t) header.size) ||
+             !load_pairs(hash_map, &reader, (size_t) header.size,
+                         header.first_hash))){
+            hashmap_free(&hash_map);
+        }
+    }
+
+    // give back what was read ahead of the snapshot, for whatever follows.
+    if (reader.end > reader.start &&
+        fseek(file, -(long) (reader.end - reader.start), SEEK_CUR) != 0 &&
+        errno != ESPIPE){
+        hashmap_free(&hash_map);
+    }
+
+    free(reader.buf);
+    return hash_map;
+}
@@ -0,0 +1,71 @@
+#ifndef HASHMAP_STREAM_H_
+#define HASHMAP_STREAM_H_
+
+#include <stdio.h>
+#include "hashmap.h"
+
+/**
+ * @file
+ * Snapshots of hash maps, streamed to and from a FILE.
+ *
+ * A snapshot is a header (the storage engine, the capacity, the resize
+ * policy, the number of pairs and the hash of the first key), then every
+ * pair as a length-prefixed key and a length-prefixed value. Lengths are
+ * varints, so a small key costs one byte more than its own bytes. Keys and
+ * values are turned into bytes and back by the key_save, value_save,
+ * key_load and value_load functions of the pair_ops of the hash map.
+ *
+ * Both ways go through a buffer of HASHMAP_STREAM_BUFFER bytes, and
+ * hashmap_load allocates the storage once at the saved capacity, so loading
+ * never resizes: a snapshot loads at the speed of the file.
+ *
+ * Usage:
+ *   hashmap_save(map, file);
+ *   ...
+ *   hashmap *copy = hashmap_load(file, hash_func, &ops);
+ */
+
+/**
+ * @def HASHMAP_STREAM_VERSION
+ * The version of the snapshot format, checked by hashmap_load.
+ */
+#define HASHMAP_STREAM_VERSION 2U
+
+/**
+ * @def HASHMAP_STREAM_BUFFER
+ * The size of the buffer of hashmap_save and hashmap_load.
+ */
+#define HASHMAP_STREAM_BUFFER (64UL * 1024UL)
+
+/**
+ * Writes a snapshot of a hash map to file, from its current position.
+ * @param hash_map a hash map whose pair_ops have key_save and value_save
+ * (see hashmap_alloc_ops), not modified meanwhile.
+ * @param file a file open for writing.
+ * @return 1 on success, 0 otherwise (then part of the snapshot may have
+ * been written).
+ */
+int hashmap_save (const hashmap *hash_map, FILE *file);
+
+/**
+ * Reads a snapshot written by hashmap_save, from the current position of
+ * file, into a new hash map with the saved storage engine, capacity and
+ * resize policy. The pairs are linked without resizing. A saved capacity
+ * far above what the pairs need is lowered: at most the capacity
+ * hashmap_reserve would pick for them, times the growth factor.
+ * @param file a file open for reading. When it can seek, it is left right
+ * after the snapshot, so several snapshots can follow each other (the load
+ * fails if it can not seek back to there). A file that can not seek at all,
+ * like a pipe, is read ahead, so it holds only one snapshot.
+ * @param func the hash function of the saved hash map. Keys are hashed
+ * again, so it must give the same hashes. The hash of the first key is
+ * saved and checked, so a different func (or another HASH_DEFAULT_SEED)
+ * fails the load, unless it happens to hash that one key the same.
+ * @param ops the functions of the keys and the values, with key_load and
+ * value_load.
+ * @return pointer to dynamically allocated hashmap.
+ * @if_fail return NULL, also for a damaged or truncated snapshot.
+ */
+hashmap *hashmap_load (FILE *file, hash_func func, const pair_ops *ops);
+
+#endif //HASHMAP_STREAM_H_
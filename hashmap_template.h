@@ -0,0 +1,278 @@
+#ifndef HASHMAP_TEMPLATE_H_
+#define HASHMAP_TEMPLATE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "hashmap.h"
+
+/**
+ * @file
+ * Type specialized hash maps, generated at compile time.
+ *
+ * HASHMAP_DECLARE(name, key_type, value_type, hash, eq) declares the type
+ * "name" and its functions (name_alloc, name_free, name_insert, name_at,
+ * name_erase, name_get_load_factor, name_apply_if). Keys and values are
+ * stored by value inside the slots, and hash/eq are called directly, so
+ * they get inlined: there are no per pair allocations nor function pointers.
+ * It grows and shrinks like hashmap (HASH_MAP_* in hashmap.h).
+ *
+ * @param name the prefix of the generated type and functions.
+ * @param key_type, value_type any copyable types.
+ * @param hash a function or a function-like macro: size_t hash(key_type).
+ * The identity is fine, the hash is mixed before use.
+ * @param eq a function or a function-like macro: int eq(key_type, key_type),
+ * nonzero if the keys are equal. HASHMAP_EQ compares with ==.
+ *
+ * Example: HASHMAP_DECLARE(char_int_map, char, int, HASHMAP_HASH, HASHMAP_EQ)
+ */
+
+/**
+ * @def HASHMAP_HASH
+ * A hash for integral keys: the value itself.
+ */
+#define HASHMAP_HASH(key) ((size_t) (key))
+
+/**
+ * @def HASHMAP_EQ
+ * Equality for keys that compare with ==.
+ */
+#define HASHMAP_EQ(key_1, key_2) ((key_1) == (key_2))
+
+/**
+ * @def HASHMAP_TEMPLATE_EMPTY, HASHMAP_TEMPLATE_DELETED
+ * Control bytes of slots without a pair. A full slot holds the 7 bit tag
+ * of its key's hash.
+ */
+#define HASHMAP_TEMPLATE_EMPTY 0x80
+#define HASHMAP_TEMPLATE_DELETED 0xFE
+
+#define HASHMAP_DECLARE(name, key_type, value_type, hash, eq)                  \
+                                                                               \
+/**                                                                            \
+ * @struct name##_slot                                                         \
+ * a key and its value, stored inline.                                         \
+ */                                                                            \
+typedef struct name##_slot {                                                   \
+    key_type key;                                                              \
+    value_type value;                                                          \
+} name##_slot;                                                                 \
+                                                                               \
+/**                                                                            \
+ * @struct name                                                                \
+ * @param ctrl one control byte per slot.                                      \
+ * @param slots the slots.                                                     \
+ * @param size the number of pairs stored.                                    \
+ * @param capacity the number of slots.                                        \
+ * @param tombstones the number of deleted slots.                              \
+ */                                                                            \
+typedef struct name {                                                          \
+    uint8_t *ctrl;                                                             \
+    name##_slot *slots;                                                        \
+    size_t size;                                                               \
+    size_t capacity;                                                           \
+    size_t tombstones;                                                         \
+} name;                                                                        \
+                                                                               \
+static inline size_t name##_mix(key_type key){                                 \
+    uint64_t x = (uint64_t) (hash(key));                                       \
+    x ^= x >> 33;                                                              \
+    x *= 0xff51afd7ed558ccdULL;                                                \
+    x ^= x >> 33;                                                              \
+    return (size_t) x;                                                         \
+}                                                                              \
+                                                                               \
+static inline uint8_t name##_tag(size_t mixed){                                \
+    return (uint8_t) (mixed >> (sizeof(size_t) * 8 - 7));                      \
+}                                                                              \
+                                                                               \
+/**                                                                            \
+ * returns the slot of the key, or capacity if it is not in the map.          \
+ */                                                                            \
+static inline size_t name##_find(const name *map, key_type key,                \
+                                 size_t mixed){                                \
+    size_t mask = map->capacity - 1;                                           \
+    uint8_t tag = name##_tag(mixed);                                           \
+    for (size_t i = mixed & mask, n = 0; n < map->capacity;                    \
+         i = (i + 1) & mask, ++n) {                                            \
+        if (map->ctrl[i] == HASHMAP_TEMPLATE_EMPTY){                           \
+            break;                                                             \
+        }                                                                      \
+        if (map->ctrl[i] == tag && eq(map->slots[i].key, key)){                \
+            return i;                                                          \
+        }                                                                      \
+    }                                                                          \
+    return map->capacity;                                                      \
+}                                                                              \
+                                                                               \
+/**                                                                            \
+ * moves every pair to new storage of new_capacity slots.                      \
+ * @return 1 on success, 0 otherwise (then the map is left untouched).        \
+ */                                                                            \
+static inline int name##_rehash(name *map, size_t new_capacity){               \
+    uint8_t *ctrl = malloc(new_capacity);                                      \
+    name##_slot *slots = malloc(new_capacity * sizeof(name##_slot));           \
+    if (ctrl == NULL || slots == NULL){                                        \
+        free(ctrl);                                                            \
+        free(slots);                                                           \
+        return 0;                                                              \
+    }                                                                          \
+    memset(ctrl, HASHMAP_TEMPLATE_EMPTY, new_capacity);                        \
+    for (size_t i = 0; map->ctrl != NULL && i < map->capacity; ++i) {          \
+        if (map->ctrl[i] & HASHMAP_TEMPLATE_EMPTY){                            \
+            continue;                                                          \
+        }                                                                      \
+        size_t j = name##_mix(map->slots[i].key) & (new_capacity - 1);         \
+        while (ctrl[j] != HASHMAP_TEMPLATE_EMPTY) {                            \
+            j = (j + 1) & (new_capacity - 1);                                  \
+        }                                                                      \
+        ctrl[j] = map->ctrl[i];                                                \
+        slots[j] = map->slots[i];                                              \
+    }                                                                          \
+    free(map->ctrl);                                                           \
+    free(map->slots);                                                          \
+    map->ctrl = ctrl;                                                          \
+    map->slots = slots;                                                        \
+    map->capacity = new_capacity;                                              \
+    map->tombstones = 0;                                                       \
+    return 1;                                                                  \
+}                                                                              \
+                                                                               \
+/**                                                                            \
+ * Allocates dynamically a new map.                                            \
+ * @return pointer to dynamically allocated map, NULL on failure.             \
+ */                                                                            \
+static inline name *name##_alloc(void){                                        \
+    name *map = calloc(1, sizeof(name));                                       \
+    if (map == NULL){                                                          \
+        return NULL;                                                           \
+    }                                                                          \
+    if (!name##_rehash(map, HASH_MAP_INITIAL_CAP)){                            \
+        free(map);                                                             \
+        return NULL;                                                           \
+    }                                                                          \
+    return map;                                                                \
+}                                                                              \
+                                                                               \
+/**                                                                            \
+ * Frees a map.                                                                \
+ * @param p_map pointer to dynamically allocated pointer to map.              \
+ */                                                                            \
+static inline void name##_free(name **p_map){                                  \
+    if (p_map == NULL || *p_map == NULL){                                      \
+        return;                                                                \
+    }                                                                          \
+    free((*p_map)->ctrl);                                                      \
+    free((*p_map)->slots);                                                     \
+    free(*p_map);                                                              \
+    *p_map = NULL;                                                             \
+}                                                                              \
+                                                                               \
+/**                                                                            \
+ * Returns the load factor of the map, -1 for a NULL map.                      \
+ */                                                                            \
+static inline double name##_get_load_factor(const name *map){                  \
+    if (map == NULL){                                                          \
+        return -1;                                                             \
+    }                                                                          \
+    return (double) map->size / (double) map->capacity;                        \
+}                                                                              \
+                                                                               \
+/**                                                                            \
+ * Inserts a copy of key and value.                                            \
+ * @return 1 for successful insertion, 0 otherwise (e.g. the key is already   \
+ * in the map).                                                                \
+ */                                                                            \
+static inline int name##_insert(name *map, key_type key, value_type value){    \
+    if (map == NULL){                                                          \
+        return 0;                                                              \
+    }                                                                          \
+    size_t mixed = name##_mix(key);                                            \
+    if (name##_find(map, key, mixed) != map->capacity){                        \
+        return 0;                                                              \
+    }                                                                          \
+    /* keep an empty slot at the end of every probe sequence. */              \
+    if ((map->size + map->tombstones + 1) * 8 > map->capacity * 7 &&           \
+        !name##_rehash(map, map->capacity)){                                   \
+        return 0;                                                              \
+    }                                                                          \
+    size_t i = mixed & (map->capacity - 1);                                    \
+    while (!(map->ctrl[i] & HASHMAP_TEMPLATE_EMPTY)) {                         \
+        i = (i + 1) & (map->capacity - 1);                                     \
+    }                                                                          \
+    if (map->ctrl[i] == HASHMAP_TEMPLATE_DELETED){                             \
+        map->tombstones -= 1;                                                  \
+    }                                                                          \
+    map->ctrl[i] = name##_tag(mixed);                                          \
+    map->slots[i].key = key;                                                   \
+    map->slots[i].value = value;                                               \
+    map->size += 1;                                                            \
+    if (name##_get_load_factor(map) > HASH_MAP_MAX_LOAD_FACTOR &&              \
+        !name##_rehash(map, map->capacity * HASH_MAP_GROWTH_FACTOR)){          \
+        map->ctrl[i] = HASHMAP_TEMPLATE_DELETED;                               \
+        map->tombstones += 1;                                                  \
+        map->size -= 1;                                                        \
+        return 0;                                                              \
+    }                                                                          \
+    return 1;                                                                  \
+}                                                                              \
+                                                                               \
+/**                                                                            \
+ * Returns a pointer to the value of key (valid until the next insert or      \
+ * erase), NULL if the key is not in the map.                                  \
+ */                                                                            \
+static inline value_type *name##_at(const name *map, key_type key){            \
+    if (map == NULL){                                                          \
+        return NULL;                                                           \
+    }                                                                          \
+    size_t i = name##_find(map, key, name##_mix(key));                         \
+    return i == map->capacity ? NULL : &map->slots[i].value;                   \
+}                                                                              \
+                                                                               \
+/**                                                                            \
+ * Erases the pair of key.                                                     \
+ * @return 1 if the erasing was done successfully, 0 otherwise.               \
+ */                                                                            \
+static inline int name##_erase(name *map, key_type key){                       \
+    if (map == NULL){                                                          \
+        return 0;                                                              \
+    }                                                                          \
+    size_t i = name##_find(map, key, name##_mix(key));                         \
+    if (i == map->capacity){                                                   \
+        return 0;                                                              \
+    }                                                                          \
+    /* the next slot empty means no probe sequence goes on past this one. */  \
+    if (map->ctrl[(i + 1) & (map->capacity - 1)] == HASHMAP_TEMPLATE_EMPTY){   \
+        map->ctrl[i] = HASHMAP_TEMPLATE_EMPTY;                                 \
+    }                                                                          \
+    else {                                                                     \
+        map->ctrl[i] = HASHMAP_TEMPLATE_DELETED;                               \
+        map->tombstones += 1;                                                  \
+    }                                                                          \
+    map->size -= 1;                                                            \
+    if (name##_get_load_factor(map) < HASH_MAP_MIN_LOAD_FACTOR &&              \
+        map->capacity / HASH_MAP_GROWTH_FACTOR >= HASH_MAP_INITIAL_CAP){       \
+        name##_rehash(map, map->capacity / HASH_MAP_GROWTH_FACTOR);            \
+    }                                                                          \
+    return 1;                                                                  \
+}                                                                              \
+                                                                               \
+/**                                                                            \
+ * Applies value_func on the values whose keys fulfill key_func.              \
+ * @return number of changed values.                                          \
+ */                                                                            \
+static inline int name##_apply_if(const name *map,                             \
+                                  int (*key_func) (key_type),                  \
+                                  void (*value_func) (value_type *)){          \
+    int changed_values = 0;                                                    \
+    for (size_t i = 0; map != NULL && i < map->capacity; ++i) {                \
+        if (!(map->ctrl[i] & HASHMAP_TEMPLATE_EMPTY) &&                        \
+            key_func(map->slots[i].key)){                                      \
+            value_func(&map->slots[i].value);                                  \
+            changed_values += 1;                                               \
+        }                                                                      \
+    }                                                                          \
+    return changed_values;                                                     \
+}
+
+#endif //HASHMAP_TEMPLATE_H_
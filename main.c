@@ -8,6 +8,28 @@ int main ()
   test_hash_map_at();
   test_hash_map_get_load_factor();
   test_hash_map_apply_if();
+  test_hash_map_backends();
+  test_hash_map_incremental_rehash();
+  test_hash_map_insert_take();
+  test_hash_map_allocator();
+  test_hash_map_template();
+  test_hash_map_pair_ops();
+  test_hash_funcs();
+  test_concurrent_hashmap();
+  test_epoch_hashmap();
+  test_hash_map_batch();
+  test_hash_map_bulk_build();
+  test_hash_map_config();
+  test_hash_map_robin_hood();
+  test_hash_map_cuckoo();
+  test_hash_map_iter();
+  test_hash_map_apply_if_parallel();
+  test_hash_map_compact();
+  test_hash_map_image();
+  test_hash_map_stream();
+  test_hash_map_bytes_lookup();
+  test_hash_map_inline();
+  test_hash_map_find_or_insert();
 
   return 0;
 }
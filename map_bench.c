@@ -0,0 +1,641 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "hashmap.h"
+#include "hash_funcs.h"
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+/**
+ * @file
+ * Micro-benchmarks of the core hash map operations.
+ *
+ * For every combination of the given backends, key types, distributions
+ * and sizes, a map of size keys is built with hashmap_insert, queried with
+ * hashmap_at (and hashmap_at_batch), scanned with hashmap_apply_if and
+ * emptied with hashmap_erase.
+ * Every measurement is printed as one JSON object per line:
+ *
+ * {"op":"at","backend":"swiss","keys":"int","dist":"zipf","size":100000,
+ *  "hit_ratio":0.9,"ops":1000000,"ns_per_op":85.1,"p50":80.2,"p90":95.0,
+ *  "p99":130.4,"p999":210.9,"max":3021.5,"allocs_per_op":0.0,
+ *  "resizes":0,"resize_batch_ns":0,"peak_rss_kb":10240,"inline":0}
+ *
+ * Operations are timed in batches of BENCH_BATCH (BENCH_AT_BATCH for
+ * at_batch, one hashmap_at_batch call per batch), the keys of a batch are
+ * made before its timer starts. The percentiles are per operation, over the
+ * batches (a sample of BENCH_SAMPLES of them). "resizes" counts the batches
+ * that grew or shrank the map, "resize_batch_ns" is their mean time per
+ * operation. Allocations count both the map's memory and the copies of the
+ * keys and values.
+ *
+ * Usage: map_bench [--backend=chaining,swiss,robin,cuckoo,compact]
+ *                  [--keys=int,char,string]
+ *                  [--dist=seq,uniform,zipf] [--size=1K,100K,...]
+ *                  [--ops=N] [--hit=RATIO] [--seed=N] [--inline=N]
+ * Sizes take K and M suffixes. --inline sets the inline_size of the pairs
+ * (see entry.h), 0 by default: keys and values that fit are then stored in
+ * their entries and not copied by the copy functions. Char maps hold at
+ * most BENCH_CHAR_KEYS keys.
+ * Inserts and erases visit every key once: in order for seq, shuffled
+ * otherwise. Lookups draw ops keys from the distribution, a 1 - hit share
+ * of them absent from the map.
+ */
+
+#define BENCH_BATCH 16
+#define BENCH_AT_BATCH 256
+#define BENCH_SAMPLES (1 << 20)
+#define BENCH_CHAR_KEYS 128
+#define BENCH_ZIPF_THETA 0.99
+#define BENCH_KEY_LEN 24
+#define BENCH_MAX_LIST 16
+
+/**
+ * @enum bench_keys, bench_dist
+ * the key types and key distributions.
+ */
+typedef enum bench_keys { KEYS_INT, KEYS_CHAR, KEYS_STRING } bench_keys;
+typedef enum bench_dist { DIST_SEQ, DIST_UNIFORM, DIST_ZIPF } bench_dist;
+
+static const char *keys_names[] = {"int", "char", "string"};
+static const char *dist_names[] = {"seq", "uniform", "zipf"};
+static const char *backend_names[] = {"chaining", "swiss", "robin",
+                                     "cuckoo", "compact"};
+
+/**
+ * the number of allocations made since the start.
+ */
+static size_t bench_allocs = 0;
+
+static void *bench_malloc(size_t size){
+    bench_allocs += 1;
+    return malloc(size);
+}
+
+static void *counting_alloc(void *ctx, size_t size){
+    (void) ctx;
+    return bench_malloc(size);
+}
+
+static void counting_free(void *ctx, void *ptr, size_t size){
+    (void) ctx;
+    (void) size;
+    free(ptr);
+}
+
+static void *int_cpy(const void *p){
+    int *copy = bench_malloc(sizeof(int));
+    if (copy != NULL){
+        *copy = *(const int *) p;
+    }
+    return copy;
+}
+
+static void *char_cpy(const void *p){
+    char *copy = bench_malloc(sizeof(char));
+    if (copy != NULL){
+        *copy = *(const char *) p;
+    }
+    return copy;
+}
+
+static void *string_cpy(const void *p){
+    size_t len = strlen(p) + 1;
+    char *copy = bench_malloc(len);
+    if (copy != NULL){
+        memcpy(copy, p, len);
+    }
+    return copy;
+}
+
+static size_t int_size(const void *p){
+    (void) p;
+    return sizeof(int);
+}
+
+static size_t char_size(const void *p){
+    (void) p;
+    return sizeof(char);
+}
+
+static size_t string_size(const void *p){
+    return strlen(p) + 1;
+}
+
+static int int_eq(const void *p1, const void *p2){
+    return *(const int *) p1 == *(const int *) p2;
+}
+
+static int char_eq(const void *p1, const void *p2){
+    return *(const char *) p1 == *(const char *) p2;
+}
+
+static int string_eq(const void *p1, const void *p2){
+    return strcmp(p1, p2) == 0;
+}
+
+static void any_free(void **p){
+    free(*p);
+    *p = NULL;
+}
+
+static int any_key(const void *p){
+    (void) p;
+    return 1;
+}
+
+static void touch_value(void *p){
+    *(int *) p += 1;
+}
+
+/**
+ * a key of any of the key types.
+ */
+typedef union bench_key {
+    int i;
+    char c;
+    char s[BENCH_KEY_LEN];
+} bench_key;
+
+/**
+ * fills key with the key of the given index.
+ */
+static void make_key(bench_keys keys, size_t index, bench_key *key){
+    switch (keys) {
+        case KEYS_INT:
+            key->i = (int) index;
+            break;
+        case KEYS_CHAR:
+            key->c = (char) index;
+            break;
+        case KEYS_STRING:
+            snprintf(key->s, sizeof(key->s), "key_%zu", index);
+            break;
+    }
+}
+
+/**
+ * a random number generator (splitmix64).
+ */
+static uint64_t rng_state;
+
+static uint64_t rng_next(void){
+    rng_state += 0x9e3779b97f4a7c15ULL;
+    return hash_mix64(rng_state);
+}
+
+static double rng_unit(void){
+    return (double) (rng_next() >> 11) / (double) (1ULL << 53);
+}
+
+/**
+ * a Zipfian generator over [0, n), rank 0 being the most frequent (after
+ * Gray et al., "Quickly generating billion-record synthetic databases").
+ */
+typedef struct zipf {
+    size_t n;
+    double alpha, zetan, eta, half_pow;
+} zipf;
+
+static void zipf_init(zipf *z, size_t n){
+    double zeta2 = 1.0 + pow(0.5, BENCH_ZIPF_THETA);
+    z->n = n;
+    z->zetan = 0;
+    for (size_t i = 1; i <= n; ++i) {
+        z->zetan += 1.0 / pow((double) i, BENCH_ZIPF_THETA);
+    }
+    z->alpha = 1.0 / (1.0 - BENCH_ZIPF_THETA);
+    z->eta = (1.0 - pow(2.0 / (double) n, 1.0 - BENCH_ZIPF_THETA)) /
+             (1.0 - zeta2 / z->zetan);
+    z->half_pow = 1.0 + pow(0.5, BENCH_ZIPF_THETA);
+}
+
+static size_t zipf_next(const zipf *z){
+    double u = rng_unit();
+    double uz = u * z->zetan;
+    if (uz < 1.0 || z->n < 2){
+        return 0;
+    }
+    if (uz < z->half_pow){
+        return 1;
+    }
+    size_t rank = (size_t) ((double) z->n *
+                            pow(z->eta * u - z->eta + 1.0, z->alpha));
+    return rank < z->n ? rank : z->n - 1;
+}
+
+/**
+ * the batch times of one measurement.
+ */
+typedef struct bench_stats {
+    double *samples;
+    size_t n_samples;
+    size_t n_batches;
+    size_t ops;
+    double total_ns;
+    double max_ns;
+    size_t resizes;
+    double resize_ns;
+    size_t allocs;
+} bench_stats;
+
+static double now_ns(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static void stats_reset(bench_stats *stats, double *samples){
+    memset(stats, 0, sizeof(*stats));
+    stats->samples = samples;
+    stats->allocs = bench_allocs;
+}
+
+/**
+ * records a batch of n operations that took ns, reservoir sampling the
+ * batches beyond BENCH_SAMPLES.
+ */
+static void stats_add(bench_stats *stats, double ns, size_t n, int resized){
+    double per_op = ns / (double) n;
+    stats->ops += n;
+    stats->total_ns += ns;
+    if (per_op > stats->max_ns){
+        stats->max_ns = per_op;
+    }
+    if (resized){
+        stats->resizes += 1;
+        stats->resize_ns += per_op;
+    }
+    stats->n_batches += 1;
+    if (stats->n_samples < BENCH_SAMPLES){
+        stats->samples[stats->n_samples++] = per_op;
+    }
+    else {
+        size_t j = rng_next() % stats->n_batches;
+        if (j < BENCH_SAMPLES){
+            stats->samples[j] = per_op;
+        }
+    }
+}
+
+static int cmp_double(const void *p1, const void *p2){
+    double d1 = *(const double *) p1, d2 = *(const double *) p2;
+    return (d1 > d2) - (d1 < d2);
+}
+
+static double percentile(const bench_stats *stats, double q){
+    if (stats->n_samples == 0){
+        return 0;
+    }
+    return stats->samples[(size_t) (q * (double) (stats->n_samples - 1))];
+}
+
+static long peak_rss_kb(void){
+#ifdef __unix__
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0){
+        return usage.ru_maxrss;
+    }
+#endif
+    return -1;
+}
+
+/**
+ * the configuration of one measurement.
+ */
+typedef struct bench_config {
+    hashmap_backend backend;
+    bench_keys keys;
+    bench_dist dist;
+    size_t size;
+    size_t ops;
+    double hit;
+    size_t inline_size;
+} bench_config;
+
+static void stats_print(const char *op, const bench_config *config,
+                        bench_stats *stats){
+    qsort(stats->samples, stats->n_samples, sizeof(double), cmp_double);
+    double ops = stats->ops > 0 ? (double) stats->ops : 1;
+    printf("{\"op\":\"%s\",\"backend\":\"%s\",\"keys\":\"%s\","
+           "\"dist\":\"%s\",\"size\":%zu,\"hit_ratio\":%.3f,\"ops\":%zu,"
+           "\"ns_per_op\":%.2f,\"p50\":%.2f,\"p90\":%.2f,\"p99\":%.2f,"
+           "\"p999\":%.2f,\"max\":%.2f,\"allocs_per_op\":%.3f,"
+           "\"resizes\":%zu,\"resize_batch_ns\":%.2f,\"peak_rss_kb\":%ld,"
+           "\"inline\":%zu}\n",
+           op, backend_names[config->backend], keys_names[config->keys],
+           dist_names[config->dist], config->size, config->hit, stats->ops,
+           stats->total_ns / ops, percentile(stats, 0.5),
+           percentile(stats, 0.9), percentile(stats, 0.99),
+           percentile(stats, 0.999), stats->max_ns,
+           (double) (bench_allocs - stats->allocs) / ops, stats->resizes,
+           stats->resizes > 0 ? stats->resize_ns / (double) stats->resizes :
+           0, peak_rss_kb(), config->inline_size);
+    fflush(stdout);
+}
+
+/**
+ * returns the order inserts and erases visit the key indexes in.
+ */
+static size_t *visit_order(const bench_config *config){
+    size_t *order = malloc(config->size * sizeof(size_t));
+    if (order == NULL){
+        return NULL;
+    }
+    for (size_t i = 0; i < config->size; ++i) {
+        order[i] = i;
+    }
+    for (size_t i = config->size; config->dist != DIST_SEQ && i > 1; --i) {
+        size_t j = rng_next() % i;
+        size_t tmp = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = tmp;
+    }
+    return order;
+}
+
+/**
+ * inserts (erases) the keys of order, from first to end.
+ */
+static void run_updates(hashmap *map, const bench_config *config,
+                        const size_t *order, int erase, bench_stats *stats){
+    bench_key keys[BENCH_BATCH];
+    int value = 0;
+    pair batch_pair = {0};
+
+    for (size_t first = 0; first < config->size; first += BENCH_BATCH) {
+        size_t n = config->size - first < BENCH_BATCH ?
+                   config->size - first : BENCH_BATCH;
+        for (size_t i = 0; i < n; ++i) {
+            make_key(config->keys, order[first + i], &keys[i]);
+        }
+        size_t capacity = map->capacity;
+        double start = now_ns();
+        for (size_t i = 0; i < n; ++i) {
+            if (erase){
+                hashmap_erase(map, &keys[i]);
+            }
+            else {
+                batch_pair.key = &keys[i];
+                batch_pair.value = &value;
+                hashmap_insert(map, &batch_pair);
+            }
+        }
+        stats_add(stats, now_ns() - start, n, map->capacity != capacity);
+    }
+}
+
+/**
+ * keeps the compiler from dropping the lookups.
+ */
+static volatile size_t bench_sink;
+
+/**
+ * looks up config->ops keys drawn from the distribution, one at a time with
+ * hashmap_at, or batch keys at a time with hashmap_at_batch.
+ */
+static void run_lookups(const hashmap *map, const bench_config *config,
+                        const zipf *z, bench_stats *stats, size_t batch){
+    static bench_key keys[BENCH_AT_BATCH];
+    static const_keyT key_ptrs[BENCH_AT_BATCH];
+    static valueT values[BENCH_AT_BATCH];
+    size_t found = 0;
+
+    for (size_t done = 0; done < config->ops; done += batch) {
+        size_t n = config->ops - done < batch ? config->ops - done : batch;
+        for (size_t i = 0; i < n; ++i) {
+            size_t index;
+            switch (config->dist) {
+                case DIST_SEQ:
+                    index = (done + i) % config->size;
+                    break;
+                case DIST_UNIFORM:
+                    index = rng_next() % config->size;
+                    break;
+                default:
+                    index = zipf_next(z);
+                    break;
+            }
+            if (rng_unit() >= config->hit){
+                index += config->size;
+            }
+            make_key(config->keys, index, &keys[i]);
+            key_ptrs[i] = &keys[i];
+        }
+        double start = now_ns();
+        if (batch > BENCH_BATCH){
+            found += hashmap_at_batch(map, key_ptrs, n, values);
+        }
+        for (size_t i = 0; batch <= BENCH_BATCH && i < n; ++i) {
+            found += hashmap_at(map, &keys[i]) != NULL;
+        }
+        stats_add(stats, now_ns() - start, n, 0);
+    }
+
+    bench_sink = found;
+}
+
+/**
+ * scans the map with hashmap_apply_if until ops pairs were visited, one
+ * batch per scan.
+ */
+static void run_scans(const hashmap *map, const bench_config *config,
+                      bench_stats *stats){
+    size_t visited = 0;
+    while (visited < config->ops && map->size > 0) {
+        double start = now_ns();
+        hashmap_apply_if(map, any_key, touch_value);
+        stats_add(stats, now_ns() - start, map->size, 0);
+        visited += map->size;
+    }
+}
+
+/**
+ * runs all the measurements of one configuration.
+ */
+static void run_config(bench_config config, double *samples){
+    static const pair_ops ops_of[] = {
+            {.key_cpy = int_cpy, .value_cpy = int_cpy, .key_cmp = int_eq,
+             .value_cmp = int_eq, .key_free = any_free,
+             .value_free = any_free, .key_size = int_size,
+             .value_size = int_size},
+            {.key_cpy = char_cpy, .value_cpy = int_cpy, .key_cmp = char_eq,
+             .value_cmp = int_eq, .key_free = any_free,
+             .value_free = any_free, .key_size = char_size,
+             .value_size = int_size},
+            {.key_cpy = string_cpy, .value_cpy = int_cpy,
+             .key_cmp = string_eq, .value_cmp = int_eq, .key_free = any_free,
+             .value_free = any_free, .key_size = string_size,
+             .value_size = int_size}
+    };
+    static const hash_func hash_of[] = {hash_int, hash_char, hash_string};
+    allocator mem = {counting_alloc, counting_free, NULL};
+    bench_stats stats;
+    zipf z;
+
+    if (config.keys == KEYS_CHAR && config.size > BENCH_CHAR_KEYS){
+        config.size = BENCH_CHAR_KEYS;
+    }
+    if (config.size == 0){
+        return;
+    }
+
+    pair_ops ops = ops_of[config.keys];
+    ops.inline_size = config.inline_size;
+    hashmap *map = hashmap_alloc_ops(hash_of[config.keys], config.backend,
+                                     &ops, &mem);
+    size_t *order = visit_order(&config);
+    if (map == NULL || order == NULL){
+        fprintf(stderr, "map_bench: out of memory at size %zu\n",
+                config.size);
+        hashmap_free(&map);
+        free(order);
+        return;
+    }
+    if (config.dist == DIST_ZIPF){
+        zipf_init(&z, config.size);
+    }
+
+    stats_reset(&stats, samples);
+    run_updates(map, &config, order, 0, &stats);
+    stats_print("insert", &config, &stats);
+
+    stats_reset(&stats, samples);
+    run_lookups(map, &config, &z, &stats, BENCH_BATCH);
+    stats_print("at", &config, &stats);
+
+    stats_reset(&stats, samples);
+    run_lookups(map, &config, &z, &stats, BENCH_AT_BATCH);
+    stats_print("at_batch", &config, &stats);
+
+    stats_reset(&stats, samples);
+    run_scans(map, &config, &stats);
+    stats_print("apply_if", &config, &stats);
+
+    stats_reset(&stats, samples);
+    run_updates(map, &config, order, 1, &stats);
+    stats_print("erase", &config, &stats);
+
+    hashmap_free(&map);
+    free(order);
+}
+
+/**
+ * parses a size with an optional K or M suffix.
+ */
+static size_t parse_size(const char *s){
+    char *end;
+    double n = strtod(s, &end);
+    if (*end == 'K' || *end == 'k'){
+        n *= 1e3;
+    }
+    else if (*end == 'M' || *end == 'm'){
+        n *= 1e6;
+    }
+    return (size_t) n;
+}
+
+/**
+ * parses a comma separated list of names (or sizes, if names is NULL).
+ * @return the number of items parsed.
+ */
+static size_t parse_list(const char *s, const char **names, size_t n_names,
+                         size_t *out){
+    size_t count = 0;
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", s);
+    for (char *tok = strtok(buffer, ","); tok != NULL && count <
+            BENCH_MAX_LIST; tok = strtok(NULL, ",")) {
+        if (names == NULL){
+            out[count++] = parse_size(tok);
+            continue;
+        }
+        for (size_t i = 0; i < n_names; ++i) {
+            if (strcmp(tok, names[i]) == 0){
+                out[count++] = i;
+            }
+        }
+    }
+    return count;
+}
+
+int main(int argc, char **argv){
+    size_t backends[BENCH_MAX_LIST] = {HASHMAP_CHAINING, HASHMAP_SWISS,
+                                        HASHMAP_ROBIN_HOOD, HASHMAP_CUCKOO,
+                                        HASHMAP_COMPACT};
+    size_t keys[BENCH_MAX_LIST] = {KEYS_INT, KEYS_STRING};
+    size_t dists[BENCH_MAX_LIST] = {DIST_SEQ, DIST_UNIFORM, DIST_ZIPF};
+    size_t sizes[BENCH_MAX_LIST] = {1000, 100000};
+    size_t n_backends = 5, n_keys = 2, n_dists = 3, n_sizes = 2;
+    size_t ops = 1000000;
+    double hit = 1.0;
+    size_t inline_size = 0;
+    rng_state = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = strchr(arg, '=');
+        value = value == NULL ? "" : value + 1;
+        if (strncmp(arg, "--backend=", 10) == 0){
+            n_backends = parse_list(value, backend_names, 5, backends);
+        }
+        else if (strncmp(arg, "--keys=", 7) == 0){
+            n_keys = parse_list(value, keys_names, 3, keys);
+        }
+        else if (strncmp(arg, "--dist=", 7) == 0){
+            n_dists = parse_list(value, dist_names, 3, dists);
+        }
+        else if (strncmp(arg, "--size=", 7) == 0){
+            n_sizes = parse_list(value, NULL, 0, sizes);
+        }
+        else if (strncmp(arg, "--ops=", 6) == 0){
+            ops = parse_size(value);
+        }
+        else if (strncmp(arg, "--hit=", 6) == 0){
+            hit = strtod(value, NULL);
+        }
+        else if (strncmp(arg, "--seed=", 7) == 0){
+            rng_state = strtoull(value, NULL, 10);
+        }
+        else if (strncmp(arg, "--inline=", 9) == 0){
+            inline_size = parse_size(value);
+        }
+        else {
+            fprintf(stderr, "usage: %s "
+                            "[--backend=chaining,swiss,robin,cuckoo,"
+                            "compact] "
+                            "[--keys=int,char,string] "
+                            "[--dist=seq,uniform,zipf] [--size=1K,100K] "
+                            "[--ops=N] [--hit=RATIO] [--seed=N] "
+                            "[--inline=N]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    double *samples = malloc(BENCH_SAMPLES * sizeof(double));
+    if (samples == NULL){
+        return EXIT_FAILURE;
+    }
+
+    for (size_t b = 0; b < n_backends; ++b) {
+        for (size_t k = 0; k < n_keys; ++k) {
+            for (size_t d = 0; d < n_dists; ++d) {
+                for (size_t s = 0; s < n_sizes; ++s) {
+                    bench_config config = {
+                            (hashmap_backend) backends[b],
+                            (bench_keys) keys[k], (bench_dist) dists[d],
+                            sizes[s], ops, hit, inline_size
+                    };
+                    run_config(config, samples);
+                }
+            }
+        }
+    }
+
+    free(samples);
+    return EXIT_SUCCESS;
+}
@@ -26,6 +26,39 @@ pair *pair_alloc (
   return p;
 }
 
+/**
+ * Allocates dynamically a new pair around a key and a value that are already
+ * dynamically allocated, without copying them. The pair owns them from now
+ * on, and frees them with key_free and value_free.
+ * @param key, value - the key and value to adopt.
+ * @param key_cpy, value_cpy - copy functions for key and value.
+ * @param key_cmp, value_cmp - compare functions for key and value.
+ * @param key_free, value_free - free functions for key and value.
+ * @return dynamically allocated pair, NULL if the allocation failed (then
+ * the caller still owns key and value).
+ */
+pair *pair_adopt (
+    keyT key, valueT value,
+    const pair_key_cpy key_cpy, const pair_value_cpy value_cpy,
+    const pair_key_cmp key_cmp, const pair_value_cmp value_cmp,
+    const pair_key_free key_free, const pair_value_free value_free)
+{
+  pair *p = malloc (sizeof (pair));
+  if (!p)
+    {
+      return NULL;
+    }
+  p->key = key;
+  p->value = value;
+  p->key_cpy = key_cpy;
+  p->value_cpy = value_cpy;
+  p->key_cmp = key_cmp;
+  p->value_cmp = value_cmp;
+  p->key_free = key_free;
+  p->value_free = value_free;
+  return p;
+}
+
 /**
  * Creates a new (dynamically allocated) copy of the given old_pair.
  * @param old_pair old_pair to be copied.
@@ -45,7 +78,6 @@ void *pair_copy (const void *p)
   return new_pair;
 }
 
-
 int pair_cmp (const void *p1, const void *p2)
 {
   if (!p1 || !p2)
@@ -77,3 +109,16 @@ void pair_free (void ** p)
   free (*p_pair);
   *p_pair = NULL;
 }
+
+/**
+ * Returns the functions of the given pair.
+ * @param p a pair.
+ * @return its functions, as a pair_ops (without serialize functions).
+ */
+pair_ops pair_get_ops (const pair *p)
+{
+  pair_ops ops = {.key_cpy = p->key_cpy, .value_cpy = p->value_cpy,
+                  .key_cmp = p->key_cmp, .value_cmp = p->value_cmp,
+                  .key_free = p->key_free, .value_free = p->value_free};
+  return ops;
+}
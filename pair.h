@@ -26,6 +26,13 @@ typedef valueT (*pair_value_cpy) (const_valueT);
 typedef int (*pair_key_cmp) (const_keyT, const_keyT);
 typedef int (*pair_value_cmp) (const_valueT, const_valueT);
 
+/**
+ * @typedef pair_key_cmp_bytes
+ * Compares a key with a key given as len raw bytes (e.g. a string key with
+ * the bytes of a string, without its terminator). returns 1 if same, else - 0.
+ */
+typedef int (*pair_key_cmp_bytes) (const_keyT, const void *bytes, size_t len);
+
 /**
  * @typedef pair_key_free, pair_value_free
  * Free functions for the key and the value.
@@ -33,6 +40,33 @@ typedef int (*pair_value_cmp) (const_valueT, const_valueT);
 typedef void (*pair_key_free) (keyT *);
 typedef void (*pair_value_free) (valueT *);
 
+/**
+ * @typedef pair_key_save, pair_value_save
+ * Serialize functions for the key and the value: write the bytes of the
+ * key (or value) to buf if they fit in size bytes, and return their number
+ * either way (like snprintf), so a bigger buffer can be tried.
+ */
+typedef size_t (*pair_key_save) (const_keyT, void *buf, size_t size);
+typedef size_t (*pair_value_save) (const_valueT, void *buf, size_t size);
+
+/**
+ * @typedef pair_key_size, pair_value_size
+ * Size functions for the key and the value: return the number of bytes of
+ * the key (or value). Only for flat objects, that are copied byte by byte
+ * and own no other memory (e.g. an int, or a string with its terminator).
+ */
+typedef size_t (*pair_key_size) (const_keyT);
+typedef size_t (*pair_value_size) (const_valueT);
+
+/**
+ * @typedef pair_key_load, pair_value_load
+ * Deserialize functions for the key and the value: allocate (dynamically)
+ * a new key (or value) from the size bytes a save function wrote to buf.
+ * return NULL on failure.
+ */
+typedef keyT (*pair_key_load) (const void *buf, size_t size);
+typedef valueT (*pair_value_load) (const void *buf, size_t size);
+
 /**
  * @struct pair - represent a pair '''{key: value}'''.
  * @param key, value - the key and value.
@@ -51,6 +85,39 @@ typedef struct pair {
     pair_value_free value_free;
 } pair;
 
+/**
+ * @struct pair_ops - the functions of a key type and a value type, shared by
+ * all the pairs of a hash map instead of repeated in every one of them.
+ * @param key_cpy, value_cpy - copy functions for key and value.
+ * @param key_cmp, value_cmp - compare functions for key and value.
+ * @param key_free, value_free - free functions for key and value.
+ * @param key_save, value_save, key_load, value_load - serialize functions
+ * for key and value, used by hashmap_save and hashmap_load (see
+ * hashmap_stream.h). NULL for hash maps that are never saved.
+ * @param key_cmp_bytes - compares a key with raw bytes, used by
+ * hashmap_at_bytes and hashmap_erase_bytes. NULL if they are not used.
+ * @param key_size, value_size - size functions for key and value. NULL for
+ * keys (or values) that are never stored inline.
+ * @param inline_size - the number of bytes every entry has for storing keys
+ * and values inline (see entry.h), 0 for none.
+ */
+typedef struct pair_ops {
+    pair_key_cpy key_cpy;
+    pair_value_cpy value_cpy;
+    pair_key_cmp key_cmp;
+    pair_value_cmp value_cmp;
+    pair_key_free key_free;
+    pair_value_free value_free;
+    pair_key_save key_save;
+    pair_value_save value_save;
+    pair_key_load key_load;
+    pair_value_load value_load;
+    pair_key_cmp_bytes key_cmp_bytes;
+    pair_key_size key_size;
+    pair_value_size value_size;
+    size_t inline_size;
+} pair_ops;
+
 /**
  * Allocates dynamically a new pair.
  * @param key, value - the key and value.
@@ -65,6 +132,23 @@ pair *pair_alloc (
     pair_key_cmp key_cmp, pair_value_cmp value_cmp,
     pair_key_free key_free, pair_value_free value_free);
 
+/**
+ * Allocates dynamically a new pair around a key and a value that are already
+ * dynamically allocated, without copying them. The pair owns them from now
+ * on, and frees them with key_free and value_free.
+ * @param key, value - the key and value to adopt.
+ * @param key_cpy, value_cpy - copy functions for key and value.
+ * @param key_cmp, value_cmp - compare functions for key and value.
+ * @param key_free, value_free - free functions for key and value.
+ * @return dynamically allocated pair, NULL if the allocation failed (then
+ * the caller still owns key and value).
+ */
+pair *pair_adopt (
+    keyT key, valueT value,
+    pair_key_cpy key_cpy, pair_value_cpy value_cpy,
+    pair_key_cmp key_cmp, pair_value_cmp value_cmp,
+    pair_key_free key_free, pair_value_free value_free);
+
 /**
  * Creates a new (dynamically allocated) copy of the given old_pair.
  * @param old_pair old_pair to be copied.
@@ -86,4 +170,11 @@ int pair_cmp(const void *p1, const void *p2);
  */
 void pair_free (void **p);
 
+/**
+ * Returns the functions of the given pair.
+ * @param p a pair.
+ * @return its functions, as a pair_ops (without serialize functions).
+ */
+pair_ops pair_get_ops (const pair *p);
+
 #endif //PAIR_H_
@@ -46,6 +46,24 @@ int int_value_cmp (const_valueT val_1, const_valueT val_2)
   return *(int *) val_1 == *(int *) val_2;
 }
 
+/**
+ * Returns the size of the char key of the pair.
+ */
+size_t char_key_size (const_keyT key)
+{
+  (void) key;
+  return sizeof (char);
+}
+
+/**
+ * Returns the size of the int value of the pair.
+ */
+size_t int_value_size (const_valueT value)
+{
+  (void) value;
+  return sizeof (int);
+}
+
 /**
  * Frees the char key of the pair.
  */
@@ -0,0 +1,349 @@
+#include "hashmap_engine.h"
+#include "hash_funcs.h"
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * @def ROBIN_MIN_CAPACITY
+ * The smallest number of slots of a Robin Hood table.
+ */
+#define ROBIN_MIN_CAPACITY 8UL
+
+/**
+ * @def ROBIN_MAX_PROBE
+ * The longest probe length a slot can record. A pair that would be pushed
+ * further makes the table grow instead.
+ */
+#define ROBIN_MAX_PROBE UINT16_MAX
+
+/**
+ * @def ROBIN_MAX_LOAD_FACTOR
+ * The highest max load factor a Robin Hood hash map may be configured with.
+ * Probe lengths stay short and even up to it.
+ */
+#define ROBIN_MAX_LOAD_FACTOR 0.95
+
+/**
+ * the slot a pair with the given hash would like to be in. The user hash
+ * may well be the identity, so it is mixed before taking the low bits.
+ */
+static size_t robin_home(size_t hash, size_t capacity){
+    return (size_t) hash_mix64((uint64_t) hash) & (capacity - 1);
+}
+
+/**
+ * checks whether a pair whose home slot is home can be placed without
+ * pushing any pair beyond ROBIN_MAX_PROBE, by walking the same slots
+ * robin_place would. The table must have an empty slot.
+ * @return 1 if it can, 0 otherwise.
+ */
+static int robin_fits(const uint16_t *probe_lens, size_t capacity,
+                      size_t home){
+    size_t mask = capacity - 1;
+    uint16_t carried = 1;
+
+    for (size_t i = home; probe_lens[i] != 0; i = (i + 1) & mask) {
+        if (probe_lens[i] < carried){
+            carried = probe_lens[i];
+        }
+        if (carried == ROBIN_MAX_PROBE){
+            return false;
+        }
+        carried += 1;
+    }
+
+    return true;
+}
+
+/**
+ * places new_entry in a table with an empty slot. Every pair it passes
+ * that is closer to its own home slot than the carried pair gives its slot
+ * to the carried pair and is carried on instead, so the probe lengths stay
+ * even.
+ * @return 1 on success, 0 if a pair would have been pushed beyond
+ * ROBIN_MAX_PROBE (the table is then left inconsistent).
+ */
+static int robin_place(uint16_t *probe_lens, entry **slots, size_t capacity,
+                       entry *new_entry){
+    size_t mask = capacity - 1;
+    entry *carried_entry = new_entry;
+    uint16_t carried = 1;
+
+    for (size_t i = robin_home(new_entry->hash, capacity); ;
+         i = (i + 1) & mask) {
+
+        if (probe_lens[i] == 0){
+            probe_lens[i] = carried;
+            slots[i] = carried_entry;
+            return true;
+        }
+
+        if (probe_lens[i] < carried){
+            uint16_t len = probe_lens[i];
+            entry *cur_entry = slots[i];
+            probe_lens[i] = carried;
+            slots[i] = carried_entry;
+            carried = len;
+            carried_entry = cur_entry;
+        }
+
+        if (carried == ROBIN_MAX_PROBE){
+            return false;
+        }
+        carried += 1;
+    }
+}
+
+/**
+ * allocates the probe lengths and the slots for the given capacity, from
+ * the hash map's allocator.
+ * @return 1 on success, 0 otherwise.
+ */
+static int robin_alloc_storage(const hashmap *hash_map, size_t capacity,
+                               uint16_t **probe_lens, entry ***slots){
+    *probe_lens = allocator_malloc(&hash_map->mem,
+                                   capacity * sizeof(uint16_t));
+    *slots = allocator_malloc(&hash_map->mem, capacity * sizeof(entry *));
+
+    if (*probe_lens == NULL || *slots == NULL){
+        allocator_free(&hash_map->mem, *probe_lens,
+                       capacity * sizeof(uint16_t));
+        allocator_free(&hash_map->mem, *slots, capacity * sizeof(entry *));
+        return false;
+    }
+
+    memset(*probe_lens, 0, capacity * sizeof(uint16_t));
+    return true;
+}
+
+/**
+ * frees the probe lengths and the slots of the given capacity.
+ */
+static void robin_free_storage(const hashmap *hash_map, size_t capacity,
+                               uint16_t *probe_lens, entry **slots){
+    allocator_free(&hash_map->mem, probe_lens, capacity * sizeof(uint16_t));
+    allocator_free(&hash_map->mem, slots, capacity * sizeof(entry *));
+}
+
+static int robin_init(hashmap *hash_map){
+    return robin_alloc_storage(hash_map, hash_map->capacity,
+                               &hash_map->probe_lens, &hash_map->slots);
+}
+
+static void robin_destroy(hashmap *hash_map){
+    for (size_t i = 0; i < hash_map->capacity; ++i) {
+        if (hash_map->probe_lens[i] != 0){
+            entry_free(&hash_map->slots[i], &hash_map->ops, &hash_map->mem);
+        }
+    }
+    robin_free_storage(hash_map, hash_map->capacity, hash_map->probe_lens,
+                       hash_map->slots);
+    hash_map->probe_lens = NULL;
+    hash_map->slots = NULL;
+}
+
+static entry **robin_search(const hashmap *hash_map, size_t hash,
+                            engine_key_match match, const void *key,
+                            size_t len){
+
+    size_t mask = hash_map->capacity - 1;
+    size_t i = robin_home(hash, hash_map->capacity);
+
+    // the key would have taken the slot of any pair closer to its home than
+    // the key is to its own, so the first such pair (or an empty slot) ends
+    // the probe sequence.
+    for (size_t probe = 1; hash_map->probe_lens[i] >= probe;
+         ++probe, i = (i + 1) & mask) {
+
+        entry *cur_entry = hash_map->slots[i];
+        if (cur_entry->hash == hash &&
+            match(hash_map, cur_entry->key, key, len)){
+            return &hash_map->slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+static entry **robin_find(const hashmap *hash_map, size_t hash,
+                          const_keyT key){
+    return robin_search(hash_map, hash, engine_match_key, key, 0);
+}
+
+static entry **robin_find_bytes(const hashmap *hash_map, size_t hash,
+                                const void *bytes, size_t len){
+    return robin_search(hash_map, hash, engine_match_bytes, bytes, len);
+}
+
+static int robin_rehash(hashmap *hash_map, size_t new_capacity){
+
+    if (new_capacity <= hash_map->size){
+        return false;
+    }
+
+    uint16_t *new_probe_lens;
+    entry **new_slots;
+
+    if (!robin_alloc_storage(hash_map, new_capacity, &new_probe_lens,
+                             &new_slots)){
+        return false;
+    }
+
+    for (size_t i = 0; i < hash_map->capacity; ++i) {
+
+        if (hash_map->probe_lens[i] != 0 &&
+            robin_place(new_probe_lens, new_slots, new_capacity,
+                        hash_map->slots[i]) == false){
+            robin_free_storage(hash_map, new_capacity, new_probe_lens,
+                               new_slots);
+            return false;
+        }
+    }
+
+    robin_free_storage(hash_map, hash_map->capacity, hash_map->probe_lens,
+                       hash_map->slots);
+    hash_map->probe_lens = new_probe_lens;
+    hash_map->slots = new_slots;
+    hash_map->capacity = new_capacity;
+
+    return true;
+}
+
+static int robin_insert(hashmap *hash_map, size_t hash, entry *new_entry){
+
+    // a full table, or a pair that would push another one too far, needs
+    // more slots first, which the hash map grows.
+    if (hash_map->size >= hash_map->capacity ||
+        !robin_fits(hash_map->probe_lens, hash_map->capacity,
+                    robin_home(hash, hash_map->capacity))){
+        return false;
+    }
+
+    robin_place(hash_map->probe_lens, hash_map->slots, hash_map->capacity,
+                new_entry);
+    return true;
+}
+
+static entry *robin_erase(hashmap *hash_map, entry **slot){
+
+    size_t mask = hash_map->capacity - 1;
+    size_t erased = (size_t) (slot - hash_map->slots);
+    size_t i = erased;
+    entry *old_entry = *slot;
+
+    // backward shift: the pairs after the erased one move one slot closer
+    // to their home, up to an empty slot or a pair already in its home.
+    // no tombstone is left behind.
+    for (size_t j = (i + 1) & mask; j != erased &&
+                                    hash_map->probe_lens[j] > 1;
+         i = j, j = (j + 1) & mask) {
+        hash_map->probe_lens[i] = hash_map->probe_lens[j] - 1;
+        hash_map->slots[i] = hash_map->slots[j];
+    }
+    hash_map->probe_lens[i] = 0;
+
+    return old_entry;
+}
+
+/**
+ * walks the slots starting right after an empty one, so no cluster wraps
+ * around the end of the walk: a backward shift then only moves pairs the
+ * walk has not returned yet. cursor->index keeps that start plus 1, 0 until
+ * it is chosen.
+ */
+static entry **robin_next(const hashmap *hash_map, hashmap_cursor *cursor){
+
+    size_t mask = hash_map->capacity - 1;
+    size_t end = cursor->end != 0 ? cursor->end : hash_map->capacity;
+
+    if (cursor->index == 0){
+        size_t empty = 0;
+        while (empty < mask && hash_map->probe_lens[empty] != 0) {
+            empty += 1;
+        }
+        cursor->index = ((empty + 1) & mask) + 1;
+    }
+
+    for (; cursor->bucket < end; ++cursor->bucket) {
+        size_t i = (cursor->bucket + cursor->index - 1) & mask;
+        if (hash_map->probe_lens[i] != 0){
+            cursor->bucket += 1;
+            return &hash_map->slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * the backward shift may have moved the next pair into the erased slot.
+ */
+static void robin_erased(const hashmap *hash_map, hashmap_cursor *cursor){
+    (void) hash_map;
+    cursor->bucket -= 1;
+}
+
+static size_t robin_positions(const hashmap *hash_map){
+    return hash_map->capacity;
+}
+
+/**
+ * level 0 the home slot (its probe length and its entry pointer), 1 the
+ * entry in it, 2 its key. level 3 has nothing left to prefetch.
+ */
+static void robin_prefetch(const hashmap *hash_map, size_t hash, int level){
+
+    size_t home = robin_home(hash, hash_map->capacity);
+
+    if (level == 0){
+        HASHMAP_PREFETCH(hash_map->probe_lens + home);
+        HASHMAP_PREFETCH(hash_map->slots + home);
+        return;
+    }
+
+    if (hash_map->probe_lens[home] == 0 || level > 2){
+        return;
+    }
+
+    entry *cur_entry = hash_map->slots[home];
+    if (level == 1){
+        HASHMAP_PREFETCH(cur_entry);
+    }
+    else {
+        HASHMAP_PREFETCH(cur_entry->key);
+    }
+}
+
+static void robin_probe_stats(const hashmap *hash_map,
+                              hashmap_probe_stats *stats){
+
+    size_t longest = 0, total = 0;
+
+    for (size_t i = 0; i < hash_map->capacity; ++i) {
+        size_t len = hash_map->probe_lens[i];
+        longest = len > longest ? len : longest;
+        total += len;
+    }
+
+    stats->max_probe_length = longest;
+    stats->mean_probe_length = hash_map->size == 0 ? 0 :
+                               (double) total / (double) hash_map->size;
+}
+
+const hashmap_engine robin_engine = {
+    ROBIN_MIN_CAPACITY,
+    ROBIN_MAX_LOAD_FACTOR,
+    robin_init,
+    robin_destroy,
+    robin_find,
+    robin_find_bytes,
+    robin_insert,
+    robin_erase,
+    robin_rehash,
+    robin_next,
+    NULL,
+    robin_prefetch,
+    robin_probe_stats,
+    robin_erased,
+    robin_positions
+};
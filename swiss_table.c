@@ -0,0 +1,461 @@
+#include "hashmap_engine.h"
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SWISS_X86 1
+#endif
+
+/**
+ * @def GROUP_WIDTH, WIDE_GROUP_WIDTH
+ * The number of control bytes probed together: 16 (one SSE2 register, or the
+ * scalar fallback), or 32 (one AVX2 register) when the CPU has AVX2 and the
+ * table is big enough. The capacity is always a multiple of the width, and
+ * every group starts at a multiple of it.
+ */
+#define GROUP_WIDTH 16UL
+#define WIDE_GROUP_WIDTH 32UL
+
+/**
+ * @def CTRL_EMPTY, CTRL_DELETED
+ * Control bytes of slots without a pair. A slot holding a pair has its
+ * 7 bit hash tag as control byte, so the high bit tells free from full.
+ */
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xFE
+
+/**
+ * @def MAX_FILL_NUM, MAX_FILL_DEN
+ * Pairs and tombstones together never fill more than 7/8 of the slots,
+ * so every probe sequence reaches an empty slot.
+ */
+#define MAX_FILL_NUM 7
+#define MAX_FILL_DEN 8
+
+#define IS_FULL(ctrl) (((ctrl) & CTRL_EMPTY) == 0)
+
+/**
+ * Spreads the bits of a user hash (which may well be the identity) over the
+ * whole word, so both the group index and the tag get well mixed bits.
+ */
+static size_t swiss_mix(size_t hash){
+    uint64_t x = (uint64_t) hash;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (size_t) x;
+}
+
+/**
+ * the 7 bit tag kept in the control byte.
+ */
+static uint8_t swiss_tag(size_t mixed){
+    return (uint8_t) (mixed >> (sizeof(size_t) * 8 - 7));
+}
+
+/**
+ * @struct group_probe
+ * The group matching functions of one instruction set.
+ * @param width the number of control bytes in a group.
+ * @param match returns a mask with bit i set for every control byte i of the
+ * group that equals the given byte.
+ * @param match_free returns a mask with bit i set for every free (empty or
+ * deleted) control byte i of the group.
+ */
+typedef struct group_probe {
+    size_t width;
+    uint32_t (*match) (const uint8_t *group, uint8_t ctrl);
+    uint32_t (*match_free) (const uint8_t *group);
+} group_probe;
+
+static uint32_t scalar_match(const uint8_t *group, uint8_t ctrl){
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+        mask |= (uint32_t) (group[i] == ctrl) << i;
+    }
+    return mask;
+}
+
+static uint32_t scalar_match_free(const uint8_t *group){
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+        mask |= (uint32_t) ((group[i] & CTRL_EMPTY) != 0) << i;
+    }
+    return mask;
+}
+
+static const group_probe scalar_probe = {
+    GROUP_WIDTH, scalar_match, scalar_match_free
+};
+
+#ifdef SWISS_X86
+
+__attribute__((target("sse2")))
+static uint32_t sse2_match(const uint8_t *group, uint8_t ctrl){
+    __m128i bytes = _mm_loadu_si128((const __m128i *) group);
+    __m128i eq = _mm_cmpeq_epi8(bytes, _mm_set1_epi8((char) ctrl));
+    return (uint32_t) _mm_movemask_epi8(eq);
+}
+
+// free control bytes are exactly the ones with the high bit set.
+__attribute__((target("sse2")))
+static uint32_t sse2_match_free(const uint8_t *group){
+    __m128i bytes = _mm_loadu_si128((const __m128i *) group);
+    return (uint32_t) _mm_movemask_epi8(bytes);
+}
+
+__attribute__((target("avx2")))
+static uint32_t avx2_match(const uint8_t *group, uint8_t ctrl){
+    __m256i bytes = _mm256_loadu_si256((const __m256i *) group);
+    __m256i eq = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8((char) ctrl));
+    return (uint32_t) _mm256_movemask_epi8(eq);
+}
+
+__attribute__((target("avx2")))
+static uint32_t avx2_match_free(const uint8_t *group){
+    __m256i bytes = _mm256_loadu_si256((const __m256i *) group);
+    return (uint32_t) _mm256_movemask_epi8(bytes);
+}
+
+static const group_probe sse2_probe = {
+    GROUP_WIDTH, sse2_match, sse2_match_free
+};
+
+static const group_probe avx2_probe = {
+    WIDE_GROUP_WIDTH, avx2_match, avx2_match_free
+};
+
+#endif
+
+/**
+ * @var narrow_probe, wide_probe
+ * The probes picked for this CPU by select_probes, wide_probe is NULL when
+ * there is no 32 byte probe.
+ */
+static const group_probe *narrow_probe = &scalar_probe;
+static const group_probe *wide_probe = NULL;
+
+/**
+ * picks the best probes the CPU supports. The environment variable
+ * HASHMAP_SIMD (scalar, sse2 or avx2) can lower the choice, to compare them.
+ * Runs once, through select_probes.
+ */
+static void pick_probes(void){
+#ifdef SWISS_X86
+    const char *limit = getenv("HASHMAP_SIMD");
+    int allow_sse2 = limit == NULL || strcmp(limit, "scalar") != 0;
+    int allow_avx2 = allow_sse2 && (limit == NULL ||
+            strcmp(limit, "sse2") != 0);
+
+    __builtin_cpu_init();
+    if (allow_sse2 && __builtin_cpu_supports("sse2")){
+        narrow_probe = &sse2_probe;
+    }
+    if (allow_avx2 && __builtin_cpu_supports("avx2")){
+        wide_probe = &avx2_probe;
+    }
+#endif
+}
+
+/**
+ * makes sure the probes are picked. Called once per allocated table;
+ * pthread_once orders the picking before every table, so a table never
+ * sees the probes change.
+ */
+static void select_probes(void){
+    static pthread_once_t picked = PTHREAD_ONCE_INIT;
+    pthread_once(&picked, pick_probes);
+}
+
+/**
+ * returns the probe used for a table of the given capacity. The choice only
+ * depends on the capacity, so a table keeps its group width until it is
+ * rehashed.
+ */
+static const group_probe *probe_of(size_t capacity){
+    if (wide_probe != NULL && capacity >= wide_probe->width){
+        return wide_probe;
+    }
+    return narrow_probe;
+}
+
+/**
+ * finds a free slot for a key known not to be in the table.
+ */
+static size_t swiss_free_slot(const uint8_t *ctrl, size_t capacity,
+                              size_t mixed){
+    const group_probe *probe = probe_of(capacity);
+    size_t group_mask = capacity / probe->width - 1;
+    size_t group = mixed & group_mask;
+
+    // triangular probing visits every group once, since the number of
+    // groups is a power of 2.
+    for (size_t step = 1; ; ++step) {
+        uint32_t mask = probe->match_free(ctrl + group * probe->width);
+        if (mask != 0){
+            return group * probe->width + (size_t) __builtin_ctz(mask);
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+/**
+ * allocates the control bytes and the slots for the given capacity, from
+ * the hash map's allocator.
+ * @return 1 on success, 0 otherwise.
+ */
+static int swiss_alloc_storage(const hashmap *hash_map, size_t capacity,
+                               uint8_t **ctrl, entry ***slots){
+    *ctrl = allocator_malloc(&hash_map->mem, capacity);
+    *slots = allocator_malloc(&hash_map->mem, capacity * sizeof(entry *));
+
+    if (*ctrl == NULL || *slots == NULL){
+        allocator_free(&hash_map->mem, *ctrl, capacity);
+        allocator_free(&hash_map->mem, *slots, capacity * sizeof(entry *));
+        return false;
+    }
+
+    memset(*ctrl, CTRL_EMPTY, capacity);
+    return true;
+}
+
+/**
+ * frees the control bytes and the slots of the given capacity.
+ */
+static void swiss_free_storage(const hashmap *hash_map, size_t capacity,
+                               uint8_t *ctrl, entry **slots){
+    allocator_free(&hash_map->mem, ctrl, capacity);
+    allocator_free(&hash_map->mem, slots, capacity * sizeof(entry *));
+}
+
+static int swiss_init(hashmap *hash_map){
+    select_probes();
+    hash_map->tombstones = 0;
+    return swiss_alloc_storage(hash_map, hash_map->capacity, &hash_map->ctrl,
+                               &hash_map->slots);
+}
+
+static void swiss_destroy(hashmap *hash_map){
+    for (size_t i = 0; i < hash_map->capacity; ++i) {
+        if (IS_FULL(hash_map->ctrl[i])){
+            entry_free(&hash_map->slots[i], &hash_map->ops, &hash_map->mem);
+        }
+    }
+    swiss_free_storage(hash_map, hash_map->capacity, hash_map->ctrl,
+                       hash_map->slots);
+    hash_map->ctrl = NULL;
+    hash_map->slots = NULL;
+}
+
+static entry **swiss_search(const hashmap *hash_map, size_t hash,
+                            engine_key_match match, const void *key,
+                            size_t len){
+
+    const group_probe *probe = probe_of(hash_map->capacity);
+    size_t mixed = swiss_mix(hash);
+    uint8_t tag = swiss_tag(mixed);
+    size_t group_mask = hash_map->capacity / probe->width - 1;
+    size_t group = mixed & group_mask;
+
+    for (size_t step = 1; step <= group_mask + 1; ++step) {
+
+        const uint8_t *group_ctrl = hash_map->ctrl + group * probe->width;
+
+        // only slots with the same tag are compared by key, the tags of the
+        // whole group are compared at once.
+        for (uint32_t mask = probe->match(group_ctrl, tag); mask != 0;
+             mask &= mask - 1) {
+
+            size_t i = group * probe->width + (size_t) __builtin_ctz(mask);
+            entry *cur_entry = hash_map->slots[i];
+            if (cur_entry->hash == hash &&
+                match(hash_map, cur_entry->key, key, len)){
+                return &hash_map->slots[i];
+            }
+        }
+
+        // a group with an empty slot ends the probe sequence.
+        if (probe->match(group_ctrl, CTRL_EMPTY) != 0){
+            return NULL;
+        }
+        group = (group + step) & group_mask;
+    }
+
+    return NULL;
+}
+
+static entry **swiss_find(const hashmap *hash_map, size_t hash,
+                          const_keyT key){
+    return swiss_search(hash_map, hash, engine_match_key, key, 0);
+}
+
+static entry **swiss_find_bytes(const hashmap *hash_map, size_t hash,
+                                const void *bytes, size_t len){
+    return swiss_search(hash_map, hash, engine_match_bytes, bytes, len);
+}
+
+static int swiss_rehash(hashmap *hash_map, size_t new_capacity){
+
+    uint8_t *new_ctrl;
+    entry **new_slots;
+
+    if (!swiss_alloc_storage(hash_map, new_capacity, &new_ctrl, &new_slots)){
+        return false;
+    }
+
+    for (size_t i = 0; i < hash_map->capacity; ++i) {
+
+        if (!IS_FULL(hash_map->ctrl[i])){
+            continue;
+        }
+
+        entry *cur_entry = hash_map->slots[i];
+        size_t mixed = swiss_mix(cur_entry->hash);
+        size_t j = swiss_free_slot(new_ctrl, new_capacity, mixed);
+        new_ctrl[j] = swiss_tag(mixed);
+        new_slots[j] = cur_entry;
+    }
+
+    swiss_free_storage(hash_map, hash_map->capacity, hash_map->ctrl,
+                       hash_map->slots);
+    hash_map->ctrl = new_ctrl;
+    hash_map->slots = new_slots;
+    hash_map->capacity = new_capacity;
+    hash_map->tombstones = 0;
+
+    return true;
+}
+
+static int swiss_insert(hashmap *hash_map, size_t hash, entry *new_entry){
+
+    // too many tombstones would leave probe sequences without an empty
+    // slot, so clean them up by rehashing in place. without tombstones
+    // there is nothing to clean: the hash map grows right after the insert
+    // that fills it to its max load factor.
+    if (hash_map->tombstones > 0 &&
+        (hash_map->size + hash_map->tombstones + 1) * MAX_FILL_DEN >
+        hash_map->capacity * MAX_FILL_NUM &&
+        !swiss_rehash(hash_map, hash_map->capacity)){
+        return false;
+    }
+
+    size_t mixed = swiss_mix(hash);
+    size_t i = swiss_free_slot(hash_map->ctrl, hash_map->capacity, mixed);
+
+    if (hash_map->ctrl[i] == CTRL_DELETED){
+        hash_map->tombstones -= 1;
+    }
+    hash_map->ctrl[i] = swiss_tag(mixed);
+    hash_map->slots[i] = new_entry;
+
+    return true;
+}
+
+static entry *swiss_erase(hashmap *hash_map, entry **slot){
+
+    const group_probe *probe = probe_of(hash_map->capacity);
+    size_t i = (size_t) (slot - hash_map->slots);
+    const uint8_t *group_ctrl = hash_map->ctrl + (i & ~(probe->width - 1));
+
+    entry *old_entry = *slot;
+
+    // a group that still has an empty slot never made a probe sequence go
+    // on to the next group, so the slot can become empty again. otherwise
+    // it must stay a tombstone to keep those sequences going.
+    if (probe->match(group_ctrl, CTRL_EMPTY) != 0){
+        hash_map->ctrl[i] = CTRL_EMPTY;
+    }
+    else {
+        hash_map->ctrl[i] = CTRL_DELETED;
+        hash_map->tombstones += 1;
+    }
+
+    return old_entry;
+}
+
+static entry **swiss_next(const hashmap *hash_map, hashmap_cursor *cursor){
+
+    const group_probe *probe = probe_of(hash_map->capacity);
+    size_t end = cursor->end != 0 ? cursor->end : hash_map->capacity;
+
+    // the control bytes of a whole group are checked at once, so empty
+    // groups are skipped with one match each.
+    while (cursor->bucket < end) {
+
+        size_t first = cursor->bucket & ~(probe->width - 1);
+        uint32_t full = ~probe->match_free(hash_map->ctrl + first);
+        if (probe->width < 32){
+            full &= ((uint32_t) 1 << probe->width) - 1;
+        }
+        full &= ~(uint32_t) 0 << (cursor->bucket - first);
+
+        if (full != 0){
+            size_t i = first + (size_t) __builtin_ctz(full);
+            if (i >= end){
+                break;
+            }
+            cursor->bucket = i + 1;
+            return &hash_map->slots[i];
+        }
+        cursor->bucket = first + probe->width;
+    }
+
+    return NULL;
+}
+
+static size_t swiss_positions(const hashmap *hash_map){
+    return hash_map->capacity;
+}
+
+/**
+ * level 0 the first group of the probe sequence (its control bytes and its
+ * slots), 1 the entry of the first slot whose tag matches, 2 its key.
+ * level 3 has nothing left to prefetch.
+ */
+static void swiss_prefetch(const hashmap *hash_map, size_t hash, int level){
+
+    const group_probe *probe = probe_of(hash_map->capacity);
+    size_t mixed = swiss_mix(hash);
+    size_t group = mixed & (hash_map->capacity / probe->width - 1);
+    size_t first = group * probe->width;
+
+    if (level == 0){
+        HASHMAP_PREFETCH(hash_map->ctrl + first);
+        HASHMAP_PREFETCH(hash_map->slots + first);
+        return;
+    }
+
+    uint32_t mask = probe->match(hash_map->ctrl + first, swiss_tag(mixed));
+
+    if (mask == 0 || level > 2){
+        return;
+    }
+
+    entry *cur_entry = hash_map->slots[first + (size_t) __builtin_ctz(mask)];
+    if (level == 1){
+        HASHMAP_PREFETCH(cur_entry);
+    }
+    else {
+        HASHMAP_PREFETCH(cur_entry->key);
+    }
+}
+
+const hashmap_engine swiss_engine = {
+    GROUP_WIDTH,
+    (double) MAX_FILL_NUM / MAX_FILL_DEN,
+    swiss_init,
+    swiss_destroy,
+    swiss_find,
+    swiss_find_bytes,
+    swiss_insert,
+    swiss_erase,
+    swiss_rehash,
+    swiss_next,
+    NULL,
+    swiss_prefetch,
+    NULL,
+    NULL,
+    swiss_positions
+};
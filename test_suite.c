@@ -3,7 +3,15 @@
 #include "test_pairs.h"
 #include <assert.h>
 #include "test_suite.h"
+#include "arena.h"
+#include "hashmap_template.h"
+#include "concurrent_hashmap.h"
+#include "epoch_hashmap.h"
+#include "hashmap_image.h"
+#include "hashmap_stream.h"
 #include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #define TEST_KEY_STRING_1 "test1"
 #define FIRST_REHASH_UP 13
 #define TEST_KEY_2 'b'
@@ -34,6 +42,17 @@ void check_load_factor_after_rehash_up ();
 void check_load_factor_before_rehash_down ();
 void check_load_factor_after_rehash_down ();
 void check_invalid_load_factor ();
+
+/**
+ * hash of a double key, by its bits
+ */
+size_t double_bits_hash(double key){
+  uint64_t bits;
+  memcpy (&bits,&key,sizeof (bits));
+  return (size_t) bits;
+}
+HASHMAP_DECLARE(char_int_map, char, int, HASHMAP_HASH, HASHMAP_EQ)
+HASHMAP_DECLARE(double_int_map, double, int, double_bits_hash, HASHMAP_EQ)
 /**
  * This function checks the hashmap_insert function of the hashmap library.
  * If hashmap_insert fails at some points, the functions exits with exit code 1.
@@ -471,4 +490,2040 @@ void test_hash_map_apply_if(){
       assert(*(int*)hashmap_at (test_map,&i)==i*2);
     }
   hashmap_free (&test_map);
-}
\ No newline at end of file
+}
+
+/**
+ * checking insert, at, erase, rehash and apply_if on the given backend
+ * @param backend the storage engine to check
+ */
+void check_backend (hashmap_backend backend)
+{
+  hashmap *map = hashmap_alloc_backend (hash_char, backend);
+  assert(map!=NULL);
+  insert_n_pairs (map,0,FIRST_REHASH_UP-1);
+  assert(map->size==FIRST_REHASH_UP-1);
+  assert(map->capacity==HASH_MAP_INITIAL_CAP);
+  insert_n_pairs (map,FIRST_REHASH_UP-1,100);//rehash up twice
+  assert(map->size==100);
+  assert(map->capacity==HASH_MAP_INITIAL_CAP*16);
+  for(int i=0;i<100;i++){
+      assert(*(int*)hashmap_at (map,&i)==i);
+      insert_single_pair (map,(char*)&i,&i,0);//duplicate keys
+    }
+  int missing = 100;
+  assert(hashmap_at (map,&missing)==NULL);
+  assert(hashmap_apply_if (map,is_key_even,mult_int)==50);
+  for(int i=0;i<100;i+=2){
+      assert(hashmap_erase (map,&i)==1);
+      assert(hashmap_at (map,&i)==NULL);
+    }
+  for(int i=1;i<100;i+=2){
+      assert(*(int*)hashmap_at (map,&i)==i);
+    }
+  //churn on the same keys, leaves deleted slots behind
+  for(int round=0;round<20;round++){
+      for(int i=0;i<100;i+=2){
+          insert_single_pair (map,(char*)&i,&i,1);
+        }
+      for(int i=0;i<100;i+=2){
+          assert(hashmap_erase (map,&i)==1);
+        }
+    }
+  assert(map->size==50);
+  erase_n_pairs (map,1,2);
+  for(int i=3;i<100;i+=2){
+      assert(hashmap_erase (map,&i)==1);
+    }
+  assert(map->size==0);
+  assert(map->capacity>0);
+  insert_n_pairs (map,0,FIRST_REHASH_UP);
+  assert(*(int*)hashmap_at (map,&(int){FIRST_REHASH_DOWN})==FIRST_REHASH_DOWN);
+  hashmap_free (&map);
+  assert(map==NULL);
+}
+
+/**
+ * number of times counting_hash_char was called
+ */
+static int hash_calls = 0;
+/**
+ * hash_char, that counts its calls
+ * @param elem char key
+ * @return the hash of the key
+ */
+size_t counting_hash_char(const void *elem){
+  hash_calls++;
+  return hash_char (elem);
+}
+/**
+ * checking hash_func is called once per operation, never on rehash
+ * @param backend the storage engine to check
+ */
+void check_cached_hash (hashmap_backend backend)
+{
+  hashmap *map = hashmap_alloc_backend (counting_hash_char, backend);
+  hash_calls = 0;
+  insert_n_pairs (map,0,FIRST_REHASH_UP);//rehash up
+  assert(map->capacity==HASH_MAP_INITIAL_CAP*2);
+  assert(hash_calls==FIRST_REHASH_UP);
+  hash_calls = 0;
+  erase_n_pairs (map,FIRST_REHASH_DOWN-1,FIRST_REHASH_UP);//rehash down
+  assert(map->capacity==HASH_MAP_INITIAL_CAP);
+  assert(hash_calls==FIRST_REHASH_UP-FIRST_REHASH_DOWN+1);
+  hashmap_free (&map);
+}
+
+/**
+ * This function checks the hashmap functions on every storage engine
+ * hashmap_alloc_backend can select.
+ * If one of them fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_backends(void)
+{
+  check_backend (HASHMAP_CHAINING);
+  check_backend (HASHMAP_SWISS);
+  check_backend (HASHMAP_ROBIN_HOOD);
+  check_backend (HASHMAP_CUCKOO);
+  check_backend (HASHMAP_COMPACT);
+  check_cached_hash (HASHMAP_CHAINING);
+  check_cached_hash (HASHMAP_SWISS);
+  check_cached_hash (HASHMAP_ROBIN_HOOD);
+  check_cached_hash (HASHMAP_CUCKOO);
+  check_cached_hash (HASHMAP_COMPACT);
+}
+
+/**
+ * This function checks incremental rehashing of the hashmap library.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_incremental_rehash(void)
+{
+  hashmap *swiss = hashmap_alloc_backend (hash_char, HASHMAP_SWISS);
+  assert(hashmap_set_incremental_rehash (swiss,1)==0);//not supported
+  hashmap_free (&swiss);
+  assert(hashmap_set_incremental_rehash (NULL,1)==0);
+
+  hashmap *map = hashmap_alloc (hash_char);
+  assert(hashmap_set_incremental_rehash (map,1)==1);
+  insert_n_pairs (map,0,FIRST_REHASH_UP);//starts a rehash up
+  assert(map->capacity==HASH_MAP_INITIAL_CAP*2);
+  assert(map->old_buckets!=NULL);
+  for(int i=0;i<FIRST_REHASH_UP;i++){
+      assert(*(int*)hashmap_at (map,&i)==i);//found in both arrays
+      insert_single_pair (map,(char*)&i,&i,0);
+    }
+  assert(hashmap_apply_if (map,is_key_even,mult_int)==FIRST_REHASH_UP/2+1);
+  insert_n_pairs (map,FIRST_REHASH_UP,20);//moves the rest of the buckets
+  assert(map->old_buckets==NULL);
+  assert(map->size==20);
+  for(int i=0;i<20;i++){
+      assert(*(int*)hashmap_at (map,&i)==(i%2==0 && i<FIRST_REHASH_UP ?
+                                          i*2 : i));
+    }
+  erase_n_pairs (map,7,20);//starts a rehash down
+  assert(map->capacity==HASH_MAP_INITIAL_CAP);
+  assert(map->old_buckets!=NULL);
+  for(int i=0;i<7;i++){
+      assert(hashmap_at (map,&i)!=NULL);
+    }
+  int erased = 10;
+  assert(hashmap_at (map,&erased)==NULL);
+  assert(hashmap_rehash_step (map,1)==1);
+  assert(hashmap_rehash_step (map,HASH_MAP_INITIAL_CAP*2)==0);
+  assert(map->old_buckets==NULL);
+  insert_n_pairs (map,7,FIRST_REHASH_UP);//starts a rehash up again
+  assert(map->old_buckets!=NULL);
+  assert(hashmap_set_incremental_rehash (map,0)==1);//finishes it
+  assert(map->old_buckets==NULL);
+  for(int i=0;i<FIRST_REHASH_UP;i++){
+      assert(hashmap_at (map,&i)!=NULL);
+    }
+  insert_n_pairs (map,FIRST_REHASH_UP,30);//rehashes at once
+  assert(map->old_buckets==NULL);
+  assert(hashmap_set_incremental_rehash (map,1)==1);
+  insert_n_pairs (map,30,49);//leaves a rehash in progress for free
+  assert(map->old_buckets!=NULL);
+  hashmap_free (&map);
+}
+
+/**
+ * adopting a key and a value that are already allocated into a pair
+ * @param key key of pair
+ * @param val value of pair
+ * @return the pair, owning copies of key and val
+ */
+pair *adopt_single_pair(char key,int val){
+  char *new_key = char_key_cpy (&key);
+  int *new_val = int_value_cpy (&val);
+  return pair_adopt (new_key,new_val,char_key_cpy,int_value_cpy,
+                     char_key_cmp,int_value_cmp,char_key_free,
+                     int_value_free);
+}
+/**
+ * checking the pair and its value are taken by the map and not copied
+ * @param backend the storage engine to check
+ */
+void check_insert_take (hashmap_backend backend)
+{
+  hashmap *map = hashmap_alloc_backend (hash_char, backend);
+  assert(hashmap_insert_take (map,NULL)==0);
+  assert(hashmap_insert_take (NULL,NULL)==0);
+  valueT taken[50];
+  for(int i=0;i<50;i++){
+      pair *cur_pair = adopt_single_pair ((char)i,i);
+      taken[i] = cur_pair->value;
+      assert(hashmap_insert_take (map,cur_pair)==1);//frees the pair struct
+    }
+  assert(map->size==50);
+  for(int i=0;i<50;i++){//still the very same values, after rehashing
+      assert(hashmap_at (map,&i)==taken[i]);
+    }
+  pair *duplicate = adopt_single_pair (0,100);
+  assert(hashmap_insert_take (map,duplicate)==0);//caller still owns it
+  assert(*(int*)hashmap_at (map,&(int){0})==0);
+  pair_free ((void **) &duplicate);
+  erase_n_pairs (map,0,40);//freed by the map
+  assert(hashmap_at (map,&(int){45})==taken[45]);
+  hashmap_free (&map);
+}
+
+/**
+ * This function checks the hashmap_insert_take function of the hashmap library.
+ * If hashmap_insert_take fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_insert_take(void)
+{
+  check_insert_take (HASHMAP_CHAINING);
+  check_insert_take (HASHMAP_SWISS);
+  check_insert_take (HASHMAP_ROBIN_HOOD);
+  check_insert_take (HASHMAP_CUCKOO);
+  check_insert_take (HASHMAP_COMPACT);
+}
+
+/**
+ * blocks allocated and not freed yet by counting_alloc
+ */
+static long live_blocks = 0;
+/**
+ * malloc, that counts the live blocks
+ */
+void *counting_alloc(void *ctx, size_t size){
+  (void) ctx;
+  live_blocks++;
+  return malloc (size);
+}
+/**
+ * free, that counts the live blocks
+ */
+void counting_free(void *ctx, void *ptr, size_t size){
+  (void) ctx;
+  (void) size;
+  live_blocks--;
+  free (ptr);
+}
+/**
+ * checking every block the map allocates from its allocator is given back
+ * @param backend the storage engine to check
+ */
+void check_counting_allocator (hashmap_backend backend)
+{
+  allocator mem = {counting_alloc, counting_free, NULL};
+  live_blocks = 0;
+  hashmap *map = hashmap_alloc_allocator (hash_char, backend, &mem);
+  hashmap_set_incremental_rehash (map,1);
+  insert_n_pairs (map,0,50);
+  assert(hashmap_insert_take (map,adopt_single_pair (50,50))==1);
+  erase_n_pairs (map,10,51);
+  assert(live_blocks>0);
+  hashmap_free (&map);
+  assert(live_blocks==0);
+}
+/**
+ * checking maps drawing from an arena
+ * @param backend the storage engine to check
+ */
+void check_arena (hashmap_backend backend)
+{
+  arena *mem_arena = arena_alloc (0);
+  allocator mem = arena_allocator (mem_arena);
+  hashmap *map = hashmap_alloc_allocator (hash_char, backend, &mem);
+  insert_n_pairs (map,0,100);
+  for(int round=0;round<5;round++){
+      erase_n_pairs (map,0,100);
+      insert_n_pairs (map,0,100);
+    }
+  for(int i=0;i<100;i++){
+      assert(*(int*)hashmap_at (map,&i)==i);
+    }
+  assert(arena_slab_count (mem_arena)>0);
+  hashmap_free (&map);
+  arena_free (&mem_arena);
+  assert(mem_arena==NULL);
+}
+
+/**
+ * This function checks hash maps drawing from an allocator (and an arena).
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_allocator(void)
+{
+  allocator half = {counting_alloc, NULL, NULL};
+  assert(hashmap_alloc_allocator (hash_char, HASHMAP_CHAINING, &half)==NULL);
+  check_counting_allocator (HASHMAP_CHAINING);
+  check_counting_allocator (HASHMAP_SWISS);
+  check_counting_allocator (HASHMAP_ROBIN_HOOD);
+  check_counting_allocator (HASHMAP_CUCKOO);
+  check_counting_allocator (HASHMAP_COMPACT);
+  check_arena (HASHMAP_CHAINING);
+  check_arena (HASHMAP_SWISS);
+  check_arena (HASHMAP_ROBIN_HOOD);
+  check_arena (HASHMAP_CUCKOO);
+  check_arena (HASHMAP_COMPACT);
+}
+
+/**
+ * returns true if the char key is even in ascii
+ */
+int is_char_even(char key){
+  return key%2==0;
+}
+/**
+ * multiply the int value by 2
+ */
+void mult_int_value(int *val){
+  *val *= 2;
+}
+
+/**
+ * This function checks maps generated by HASHMAP_DECLARE.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_template(void)
+{
+  char_int_map *map = char_int_map_alloc ();
+  for(int i=0;i<FIRST_REHASH_UP-1;i++){
+      assert(char_int_map_insert (map,(char)i,i)==1);
+    }
+  assert(map->capacity==HASH_MAP_INITIAL_CAP);
+  assert(char_int_map_insert (map,0,5)==0);//duplicate key
+  assert(char_int_map_insert (map,FIRST_REHASH_UP-1,FIRST_REHASH_UP-1)==1);
+  assert(map->capacity==HASH_MAP_INITIAL_CAP*2);//rehash up
+  for(int i=FIRST_REHASH_DOWN;i<FIRST_REHASH_UP;i++){
+      assert(char_int_map_erase (map,(char)i)==1);
+    }
+  assert(map->capacity==HASH_MAP_INITIAL_CAP*2);//8/32, no rehash yet
+  assert(char_int_map_erase (map,FIRST_REHASH_DOWN-1)==1);
+  assert(map->capacity==HASH_MAP_INITIAL_CAP);//rehash down
+  assert(char_int_map_erase (map,FIRST_REHASH_UP)==0);
+  assert(char_int_map_at (map,FIRST_REHASH_DOWN-1)==NULL);
+  for(int i=0;i<FIRST_REHASH_DOWN-1;i++){
+      assert(*char_int_map_at (map,(char)i)==i);
+    }
+  assert(char_int_map_apply_if (map,is_char_even,mult_int_value)==4);
+  assert(*char_int_map_at (map,6)==12);
+  *char_int_map_at (map,1) = 100;//values are changed in place
+  assert(*char_int_map_at (map,1)==100);
+  for(int round=0;round<100;round++){//leaves deleted slots behind
+      assert(char_int_map_insert (map,'x',round)==1);
+      assert(char_int_map_erase (map,'x')==1);
+    }
+  assert(map->size==FIRST_REHASH_DOWN-1);
+  char_int_map_free (&map);
+  assert(map==NULL);
+
+  double_int_map *doubles = double_int_map_alloc ();
+  for(int i=0;i<1000;i++){
+      assert(double_int_map_insert (doubles,i/1000.0,i)==1);
+    }
+  for(int i=0;i<1000;i++){
+      assert(*double_int_map_at (doubles,i/1000.0)==i);
+    }
+  assert(double_int_map_at (doubles,2.0)==NULL);
+  assert(double_int_map_get_load_factor (doubles)<=HASH_MAP_MAX_LOAD_FACTOR);
+  double_int_map_free (&doubles);
+}
+
+/**
+ * number of values copied by counting_int_cpy
+ */
+static int value_copies = 0;
+/**
+ * int_value_cpy, that counts the copies
+ */
+void *counting_int_cpy (const_valueT value){
+  value_copies++;
+  return int_value_cpy (value);
+}
+/**
+ * checking a map allocated with pair_ops copies by them, not by the pairs
+ * @param backend the storage engine to check
+ */
+void check_pair_ops (hashmap_backend backend)
+{
+  pair_ops ops = {.key_cpy = char_key_cpy,
+                  .value_cpy = counting_int_cpy,
+                  .key_cmp = char_key_cmp,
+                  .value_cmp = int_value_cmp,
+                  .key_free = char_key_free,
+                  .value_free = int_value_free};
+  value_copies = 0;
+  hashmap *map = hashmap_alloc_ops (hash_char, backend, &ops, NULL);
+  assert(map->has_ops==1);
+  insert_n_pairs (map,0,50);
+  assert(value_copies==50);
+  erase_n_pairs (map,0,25);
+  for(int i=25;i<50;i++){
+      assert(*(int*)hashmap_at (map,&i)==i);
+    }
+  hashmap_free (&map);
+
+  map = hashmap_alloc_backend (hash_char, backend);
+  assert(map->has_ops==0);
+  insert_n_pairs (map,0,10);//takes the ops of the first pair
+  assert(map->has_ops==1);
+  assert(map->ops.value_cpy==int_value_cpy);
+  assert(value_copies==50);
+  hashmap_free (&map);
+}
+
+/**
+ * This function checks hash maps sharing one pair_ops for all their pairs.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_pair_ops(void)
+{
+  pair_ops partial = {.key_cpy = char_key_cpy,
+                      .value_cpy = int_value_cpy,
+                      .key_cmp = NULL,
+                      .value_cmp = int_value_cmp,
+                      .key_free = char_key_free,
+                      .value_free = int_value_free};
+  assert(hashmap_alloc_ops (hash_char, HASHMAP_CHAINING, &partial,
+                            NULL)==NULL);
+  assert(sizeof (entry)<sizeof (pair));
+  check_pair_ops (HASHMAP_CHAINING);
+  check_pair_ops (HASHMAP_SWISS);
+  check_pair_ops (HASHMAP_ROBIN_HOOD);
+  check_pair_ops (HASHMAP_CUCKOO);
+  check_pair_ops (HASHMAP_COMPACT);
+}
+
+/**
+ * number of buckets the distribution checks hash into
+ */
+#define DIST_BUCKETS 1024
+/**
+ * keys per bucket in the distribution checks
+ */
+#define DIST_PER_BUCKET 16
+/**
+ * the chi-squared statistic of the low bits of the given hashes, over
+ * DIST_BUCKETS buckets, divided by its degrees of freedom. a uniform hash
+ * gives about 1, the identity on strided keys gives hundreds.
+ * @param hashes DIST_BUCKETS*DIST_PER_BUCKET hashes
+ */
+double bucket_chi_squared (const size_t *hashes)
+{
+  static int counts[DIST_BUCKETS];
+  memset (counts,0,sizeof (counts));
+  for(int i=0;i<DIST_BUCKETS*DIST_PER_BUCKET;i++){
+      counts[hashes[i] & (DIST_BUCKETS-1)]++;
+    }
+  double chi = 0;
+  for(int i=0;i<DIST_BUCKETS;i++){
+      double diff = counts[i]-DIST_PER_BUCKET;
+      chi += diff*diff/DIST_PER_BUCKET;
+    }
+  return chi/(DIST_BUCKETS-1);
+}
+/**
+ * the average number of output bits that flip when one input bit of x flips,
+ * over all input bits. 32 is ideal.
+ */
+double avalanche (uint64_t x)
+{
+  int flipped = 0;
+  for(int bit=0;bit<64;bit++){
+      uint64_t diff = hash_mix64 (x) ^ hash_mix64 (x ^ (1ULL << bit));
+      flipped += __builtin_popcountll (diff);
+    }
+  return flipped/64.0;
+}
+/**
+ * This function checks the distribution of the hash functions of hash_funcs.h.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_funcs(void)
+{
+  static size_t hashes[DIST_BUCKETS*DIST_PER_BUCKET];
+  int n = DIST_BUCKETS*DIST_PER_BUCKET;
+  for(int i=0;i<n;i++){//sequential
+      hashes[i] = hash_int (&i);
+    }
+  assert(bucket_chi_squared (hashes)<1.5);
+  for(int i=0;i<n;i++){//strided, all multiples of the bucket count
+      int key = i*DIST_BUCKETS;
+      hashes[i] = hash_int (&key);
+    }
+  assert(bucket_chi_squared (hashes)<1.5);
+  for(int i=0;i<n;i++){//all in [0,1)
+      double key = (double) i/n;
+      hashes[i] = hash_double (&key);
+    }
+  assert(bucket_chi_squared (hashes)<1.5);
+  char key[32];
+  for(int i=0;i<n;i++){//strings that differ in a few characters
+      sprintf (key,"key_%d",i);
+      hashes[i] = hash_string (key);
+    }
+  assert(bucket_chi_squared (hashes)<1.5);
+  for(int i=0;i<n;i++){//long strings that differ in the middle
+      char long_key[100];
+      memset (long_key,'a',sizeof (long_key));
+      memcpy (long_key+50,&i,sizeof (i));
+      hashes[i] = (size_t) hash_bytes (long_key,sizeof (long_key),0);
+    }
+  assert(bucket_chi_squared (hashes)<1.5);
+
+  for(uint64_t x=1;x<1000;x*=3){
+      double flips = avalanche (x);
+      assert(flips>30 && flips<34);
+    }
+
+  double zero = 0.0, negative_zero = -0.0;
+  assert(hash_double (&zero)==hash_double (&negative_zero));
+  double half = 0.5, almost_half = 0.5000000001;
+  assert(hash_double (&half)!=hash_double (&almost_half));
+  char a1[] = "same string", a2[] = "same string";
+  assert(hash_string (a1)==hash_string (a2));
+  for(size_t len=0;len<=64;len++){//every read path of hash_bytes
+      char bytes[64] = {0};
+      assert(hash_bytes (bytes,len,0)==hash_bytes (bytes,len,0));
+      assert(hash_bytes (bytes,len,0)!=hash_bytes (bytes,len,1));
+      if(len>0){
+          uint64_t before = hash_bytes (bytes,len,0);
+          bytes[len-1] = 1;
+          assert(hash_bytes (bytes,len,0)!=before);
+        }
+    }
+}
+
+/**
+ * threads and keys per thread of the concurrent checks
+ */
+#define CONCURRENT_THREADS 8
+#define CONCURRENT_KEYS 2000
+/**
+ * the map the concurrent checks share
+ */
+static concurrent_hashmap *shared_map = NULL;
+/**
+ * inserts the keys of one writer, then erases their odd half
+ * @param arg pointer to the index of the writer
+ */
+void *concurrent_writer (void *arg)
+{
+  int first = *(int*)arg*CONCURRENT_KEYS;
+  for(int key=first;key<first+CONCURRENT_KEYS;key++){
+      pair *p = pair_alloc (&key,&key,int_value_cpy,int_value_cpy,
+                            int_value_cmp,int_value_cmp,int_value_free,
+                            int_value_free);
+      assert(concurrent_hashmap_insert (shared_map,p)==1);
+      pair_free ((void **) &p);
+    }
+  for(int key=first+1;key<first+CONCURRENT_KEYS;key+=2){
+      assert(concurrent_hashmap_erase (shared_map,&key)==1);
+    }
+  return NULL;
+}
+/**
+ * looks the keys up while the writers run, a value found must be its key
+ * @param arg unused
+ */
+void *concurrent_reader (void *arg)
+{
+  (void) arg;
+  for(int round=0;round<5;round++){
+      for(int key=0;key<CONCURRENT_THREADS*CONCURRENT_KEYS;key++){
+          int *value = concurrent_hashmap_at (shared_map,&key);
+          if(value!=NULL){
+              assert(*value==key);
+              int_value_free ((void **) &value);
+            }
+        }
+    }
+  return NULL;
+}
+/**
+ * checking a concurrent map under writers and readers
+ * @param backend the storage engine to check
+ */
+void check_concurrent (hashmap_backend backend)
+{
+  shared_map = concurrent_hashmap_alloc (hash_int,backend,0);
+  assert(shared_map->n_stripes==CONCURRENT_HASHMAP_DEFAULT_STRIPES);
+  pthread_t writers[CONCURRENT_THREADS], readers[CONCURRENT_THREADS/2];
+  int index[CONCURRENT_THREADS];
+  for(int i=0;i<CONCURRENT_THREADS;i++){
+      index[i] = i;
+      assert(pthread_create (&writers[i],NULL,concurrent_writer,
+                             &index[i])==0);
+    }
+  for(int i=0;i<CONCURRENT_THREADS/2;i++){
+      assert(pthread_create (&readers[i],NULL,concurrent_reader,NULL)==0);
+    }
+  for(int i=0;i<CONCURRENT_THREADS;i++){
+      pthread_join (writers[i],NULL);
+    }
+  for(int i=0;i<CONCURRENT_THREADS/2;i++){
+      pthread_join (readers[i],NULL);
+    }
+  assert(concurrent_hashmap_size (shared_map)==
+         CONCURRENT_THREADS*CONCURRENT_KEYS/2);
+  for(int key=0;key<CONCURRENT_THREADS*CONCURRENT_KEYS;key++){
+      assert(concurrent_hashmap_contains (shared_map,&key)==(key%2==0));
+    }
+  assert(concurrent_hashmap_apply_if (shared_map,is_key_even,mult_int)==
+         CONCURRENT_THREADS*CONCURRENT_KEYS/2);
+  int key = 10;
+  int *value = concurrent_hashmap_at (shared_map,&key);
+  assert(*value==20);
+  int_value_free ((void **) &value);
+  concurrent_hashmap_free (&shared_map);
+  assert(shared_map==NULL);
+}
+
+/**
+ * This function checks the concurrent hash map.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+/**
+ * hash_int, that counts its calls in hash_calls
+ */
+size_t counting_hash_int (const_keyT key)
+{
+  hash_calls++;
+  return hash_int (key);
+}
+
+void test_concurrent_hashmap(void)
+{
+  assert(concurrent_hashmap_alloc (NULL,HASHMAP_CHAINING,4)==NULL);
+  concurrent_hashmap *map = concurrent_hashmap_alloc (hash_int,
+                                                      HASHMAP_SWISS,5);
+  assert(map->n_stripes==8);
+  assert(concurrent_hashmap_at (map,&(int){1})==NULL);
+  concurrent_hashmap_free (&map);
+  map = concurrent_hashmap_alloc (hash_int,HASHMAP_SWISS,1);
+  assert(map->n_stripes==1);
+  concurrent_hashmap_free (&map);
+
+  // the key is hashed once per operation, for its stripe and its map.
+  map = concurrent_hashmap_alloc (counting_hash_int,HASHMAP_CHAINING,4);
+  int key = 7;
+  pair *p = pair_alloc (&key,&key,int_value_cpy,int_value_cpy,int_value_cmp,
+                        int_value_cmp,int_value_free,int_value_free);
+  hash_calls = 0;
+  assert(concurrent_hashmap_insert (map,p)==1 && hash_calls==1);
+  assert(concurrent_hashmap_contains (map,&key)==1 && hash_calls==2);
+  int *value = concurrent_hashmap_at (map,&key);
+  assert(*value==7 && hash_calls==3);
+  free (value);
+  assert(concurrent_hashmap_erase (map,&key)==1 && hash_calls==4);
+  pair_free ((void **) &p);
+  concurrent_hashmap_free (&map);
+  check_concurrent (HASHMAP_CHAINING);
+  check_concurrent (HASHMAP_SWISS);
+  check_concurrent (HASHMAP_ROBIN_HOOD);
+  check_concurrent (HASHMAP_CUCKOO);
+  check_concurrent (HASHMAP_COMPACT);
+}
+
+/**
+ * the map the epoch checks share, and whether its writer is done
+ */
+static epoch_hashmap *epoch_map = NULL;
+static atomic_int epoch_writer_done;
+/**
+ * inserts and erases keys over and over, growing and shrinking the map
+ * @param arg unused
+ */
+void *epoch_writer (void *arg)
+{
+  (void) arg;
+  for(int round=0;round<20;round++){
+      for(int key=0;key<CONCURRENT_KEYS;key++){
+          pair *p = pair_alloc (&key,&key,int_value_cpy,int_value_cpy,
+                                int_value_cmp,int_value_cmp,int_value_free,
+                                int_value_free);
+          assert(epoch_hashmap_insert (epoch_map,p)==1);
+          pair_free ((void **) &p);
+        }
+      for(int key=0;key<CONCURRENT_KEYS;key++){
+          assert(epoch_hashmap_erase (epoch_map,&key)==1);
+        }
+    }
+  atomic_store (&epoch_writer_done,1);
+  return NULL;
+}
+/**
+ * looks the keys up without locks until the writer is done, a value found
+ * must be its key and must still be readable
+ * @param arg unused
+ */
+void *epoch_reader_thread (void *arg)
+{
+  (void) arg;
+  epoch_reader *reader = epoch_hashmap_register (epoch_map);
+  assert(reader!=NULL);
+  while(!atomic_load (&epoch_writer_done)){
+      epoch_hashmap_enter (reader);
+      for(int key=0;key<CONCURRENT_KEYS;key+=7){
+          int *value = epoch_hashmap_at (epoch_map,&key);
+          assert(value==NULL || *value==key);
+        }
+      epoch_hashmap_exit (reader);
+    }
+  epoch_hashmap_unregister (epoch_map,reader);
+  return NULL;
+}
+
+/**
+ * This function checks the epoch hash map, whose lookups take no lock.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_epoch_hashmap(void)
+{
+  assert(epoch_hashmap_alloc (NULL,NULL)==NULL);
+  epoch_map = epoch_hashmap_alloc (hash_int,NULL);
+  epoch_reader *reader = epoch_hashmap_register (epoch_map);
+  int key = 3;
+  pair *p = pair_alloc (&key,&key,int_value_cpy,int_value_cpy,int_value_cmp,
+                        int_value_cmp,int_value_free,int_value_free);
+  assert(epoch_hashmap_insert (epoch_map,p)==1);
+  assert(epoch_hashmap_insert (epoch_map,p)==0);
+  pair_free ((void **) &p);
+  epoch_hashmap_enter (reader);
+  int *value = epoch_hashmap_at (epoch_map,&key);
+  assert(*value==3);
+  assert(epoch_hashmap_erase (epoch_map,&key)==1);
+  assert(*value==3);//not freed while the reader is inside
+  assert(epoch_hashmap_at (epoch_map,&key)==NULL);
+  epoch_hashmap_exit (reader);
+  assert(epoch_map->garbage!=NULL);
+  assert(epoch_hashmap_erase (epoch_map,&key)==0);
+  assert(epoch_map->garbage==NULL);//freed by the next writer
+  epoch_hashmap_unregister (epoch_map,reader);
+  assert(epoch_hashmap_register (epoch_map)==reader);//reused
+  epoch_hashmap_unregister (epoch_map,reader);
+
+  atomic_store (&epoch_writer_done,0);
+  pthread_t writer, readers[CONCURRENT_THREADS/2];
+  assert(pthread_create (&writer,NULL,epoch_writer,NULL)==0);
+  for(int i=0;i<CONCURRENT_THREADS/2;i++){
+      assert(pthread_create (&readers[i],NULL,epoch_reader_thread,NULL)==0);
+    }
+  pthread_join (writer,NULL);
+  for(int i=0;i<CONCURRENT_THREADS/2;i++){
+      pthread_join (readers[i],NULL);
+    }
+  assert(epoch_hashmap_size (epoch_map)==0);
+  epoch_hashmap_free (&epoch_map);
+  assert(epoch_map==NULL);
+}
+
+/**
+ * number of keys in the batch checks
+ */
+#define BATCH_KEYS 1000
+/**
+ * checking the batch functions give the results of the single ones
+ * @param backend the storage engine to check
+ * @param incremental whether to rehash incrementally
+ */
+void check_batch (hashmap_backend backend, int incremental)
+{
+  hashmap *map = hashmap_alloc_backend (hash_int, backend);
+  hashmap_set_incremental_rehash (map,incremental);
+  static int keys[2*BATCH_KEYS];
+  static pair *pairs[BATCH_KEYS+2];
+  static const_keyT key_ptrs[2*BATCH_KEYS+1];
+  static valueT values[2*BATCH_KEYS+1];
+  for(int i=0;i<2*BATCH_KEYS;i++){
+      keys[i] = i;
+      key_ptrs[i] = &keys[i];
+    }
+  key_ptrs[2*BATCH_KEYS] = NULL;
+  for(int i=0;i<BATCH_KEYS;i++){
+      pairs[i] = pair_alloc (&keys[i],&keys[i],int_value_cpy,int_value_cpy,
+                             int_value_cmp,int_value_cmp,int_value_free,
+                             int_value_free);
+    }
+  pairs[BATCH_KEYS] = pairs[0];//a duplicate
+  pairs[BATCH_KEYS+1] = NULL;
+  assert(hashmap_insert_batch (map,pairs,BATCH_KEYS+2)==BATCH_KEYS);
+  assert(map->size==BATCH_KEYS);
+  assert(hashmap_at_batch (map,key_ptrs,2*BATCH_KEYS+1,values)==BATCH_KEYS);
+  for(int i=0;i<2*BATCH_KEYS+1;i++){
+      assert(values[i]==hashmap_at (map,key_ptrs[i]));
+      assert(i>=BATCH_KEYS || *(int*)values[i]==i);
+    }
+  assert(hashmap_erase_batch (map,key_ptrs+BATCH_KEYS/2,BATCH_KEYS)==
+         BATCH_KEYS/2);
+  assert(map->size==BATCH_KEYS/2);
+  assert(hashmap_at_batch (map,key_ptrs,BATCH_KEYS,values)==BATCH_KEYS/2);
+  assert(hashmap_at_batch (map,key_ptrs,0,values)==0);
+  assert(hashmap_at_batch (NULL,key_ptrs,1,values)==0);
+  for(int i=0;i<BATCH_KEYS;i++){
+      pair_free ((void **) &pairs[i]);
+    }
+  hashmap_free (&map);
+}
+
+/**
+ * This function checks the batch functions of the hashmap library.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_batch(void)
+{
+  check_batch (HASHMAP_CHAINING,0);
+  check_batch (HASHMAP_CHAINING,1);
+  check_batch (HASHMAP_SWISS,0);
+  check_batch (HASHMAP_ROBIN_HOOD,0);
+  check_batch (HASHMAP_CUCKOO,0);
+  check_batch (HASHMAP_COMPACT,0);
+}
+
+/**
+ * checking a map built at once holds the first pair of every key
+ * @param backend the storage engine to check
+ * @param flags the flags of hashmap_from_array
+ */
+void check_from_array (hashmap_backend backend, unsigned flags)
+{
+  int n = 3*HASH_MAP_PARALLEL_MIN_PAIRS;
+  pair **pairs = malloc (n*sizeof (pair *));
+  for(int i=0;i<n;i++){
+      int key = (flags & HASHMAP_BUILD_UNIQUE) ? i : i%(n/2);
+      pairs[i] = i%7==3 ? NULL :
+                 pair_alloc (&key,&i,int_value_cpy,int_value_cpy,
+                             int_value_cmp,int_value_cmp,int_value_free,
+                             int_value_free);
+    }
+  hashmap *map = hashmap_from_array (pairs,n,hash_int,backend,flags);
+  assert(map!=NULL);
+  size_t capacity = map->capacity;
+  assert(hashmap_get_load_factor (map)<=HASH_MAP_MAX_LOAD_FACTOR);
+  int *first = malloc (n*sizeof (int));//the value of the first pair of a key
+  for(int key=0;key<n;key++){
+      first[key] = -1;
+    }
+  for(int i=n-1;i>=0;i--){
+      if(pairs[i]!=NULL){
+          first[*(int*)pairs[i]->key] = i;
+        }
+    }
+  int found = 0;
+  for(int key=0;key<n;key++){
+      int *value = hashmap_at (map,&key);
+      assert((value==NULL)==(first[key]==-1));
+      if(value!=NULL){
+          found++;
+          assert(*value==first[key]);
+        }
+    }
+  free (first);
+  assert((int) map->size==found);
+  assert(map->capacity==capacity);
+  for(int i=0;i<n;i++){
+      pair_free ((void **) &pairs[i]);
+    }
+  free (pairs);
+  hashmap_free (&map);
+}
+
+/**
+ * inserts the int key i with itself as value
+ * @return the result of hashmap_insert
+ */
+static int insert_int(hashmap *map, int i)
+{
+  pair *p = pair_alloc (&i,&i,int_value_cpy,int_value_cpy,int_value_cmp,
+                        int_value_cmp,int_value_free,int_value_free);
+  int is_success = hashmap_insert (map,p);
+  pair_free ((void **) &p);
+  return is_success;
+}
+
+/**
+ * inserts the int keys [start, end) to map, with themselves as values.
+ */
+static void insert_int_range(hashmap *map, int start, int end)
+{
+  for(int i=start;i<end;i++){
+      assert(insert_int (map,i)==1);
+    }
+}
+
+/**
+ * This function checks hashmap_reserve and hashmap_from_array.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_bulk_build(void)
+{
+  hashmap *map = hashmap_alloc_backend (hash_int, HASHMAP_SWISS);
+  assert(hashmap_reserve (NULL,10)==0);
+  assert(hashmap_reserve (map,10)==1);
+  assert(map->capacity==HASH_MAP_INITIAL_CAP);//already big enough
+  assert(hashmap_reserve (map,1000)==1);
+  assert(map->capacity==2048);
+  insert_int_range (map,0,1000);
+  assert(map->capacity==2048);//no rehash
+  hashmap_free (&map);
+
+  map = hashmap_from_array (NULL,0,hash_int,HASHMAP_CHAINING,0);
+  assert(map!=NULL && map->size==0);
+  hashmap_free (&map);
+  assert(hashmap_from_array (NULL,1,hash_int,HASHMAP_CHAINING,0)==NULL);
+  for(hashmap_backend backend=HASHMAP_CHAINING;backend<=HASHMAP_COMPACT;
+      backend++){
+      check_from_array (backend,0);
+      check_from_array (backend,HASHMAP_BUILD_UNIQUE);
+      check_from_array (backend,HASHMAP_BUILD_PARALLEL);
+      check_from_array (backend,HASHMAP_BUILD_PARALLEL|HASHMAP_BUILD_UNIQUE);
+    }
+}
+
+/**
+ * erases the int keys [start, end) from map.
+ */
+static void erase_int_range(hashmap *map, int start, int end)
+{
+  for(int i=start;i<end;i++){
+      assert(hashmap_erase (map,&i)==1);
+    }
+}
+
+/**
+ * blocks other than entries allocated by storage_alloc
+ */
+static int storage_allocs = 0;
+/**
+ * malloc, that counts the blocks that are not entries
+ */
+void *storage_alloc(void *ctx, size_t size){
+  (void) ctx;
+  storage_allocs += size!=sizeof (entry);
+  return malloc (size);
+}
+/**
+ * free, for storage_alloc
+ */
+void storage_free(void *ctx, void *ptr, size_t size){
+  (void) ctx;
+  (void) size;
+  free (ptr);
+}
+
+void test_hash_map_config(void)
+{
+  hashmap_config config = {0};
+  config.growth_factor = 3;
+  assert(hashmap_alloc_config (hash_int,&config)==NULL);//not a power of 2
+  config.growth_factor = 4;
+  config.max_load_factor = 0.9;
+  config.min_load_factor = 0.25;
+  assert(hashmap_alloc_config (hash_int,&config)==NULL);//would grow back
+  config.no_shrink = 1;
+  hashmap *map = hashmap_alloc_config (hash_int,&config);
+  assert(map!=NULL);
+  hashmap_free (&map);
+  config = (hashmap_config) {0};
+  config.backend = HASHMAP_SWISS;
+  config.max_load_factor = 0.9;
+  assert(hashmap_alloc_config (hash_int,&config)==NULL);//above the engine's
+  config.max_load_factor = 0.875;
+  config.incremental_rehash = 1;
+  assert(hashmap_alloc_config (hash_int,&config)==NULL);//no rehash_step
+  assert(hashmap_alloc_config (NULL,NULL)==NULL);
+
+  // NULL gives the defaults.
+  map = hashmap_alloc_config (hash_int,NULL);
+  assert(map!=NULL && map->capacity==HASH_MAP_INITIAL_CAP);
+  assert(map->max_load_factor==HASH_MAP_MAX_LOAD_FACTOR);
+  assert(map->min_load_factor==HASH_MAP_MIN_LOAD_FACTOR);
+  assert(map->growth_factor==HASH_MAP_GROWTH_FACTOR);
+  hashmap_free (&map);
+
+  config = (hashmap_config) {0};
+  config.initial_capacity = 100;
+  config.incremental_rehash = 1;
+  map = hashmap_alloc_config (hash_int,&config);
+  assert(map!=NULL && map->capacity==128 && map->incremental_rehash);
+  hashmap_free (&map);
+
+  // a dense chaining map: two pairs per bucket before it grows.
+  config = (hashmap_config) {0};
+  config.max_load_factor = 2.0;
+  map = hashmap_alloc_config (hash_int,&config);
+  insert_int_range (map,0,32);
+  assert(map->capacity==16);
+  insert_int_range (map,32,33);
+  assert(map->capacity==32);
+  hashmap_free (&map);
+
+  // growing by 4.
+  config = (hashmap_config) {0};
+  config.backend = HASHMAP_SWISS;
+  config.growth_factor = 4;
+  config.min_load_factor = 0.125;
+  map = hashmap_alloc_config (hash_int,&config);
+  insert_int_range (map,0,13);
+  assert(map->capacity==64);
+  erase_int_range (map,0,6);
+  assert(map->capacity==16);
+  hashmap_free (&map);
+
+  for(hashmap_backend backend=HASHMAP_CHAINING;backend<=HASHMAP_COMPACT;
+      backend++){
+      // no_shrink keeps the capacity.
+      config = (hashmap_config) {0};
+      config.backend = backend;
+      config.no_shrink = 1;
+      map = hashmap_alloc_config (hash_int,&config);
+      insert_int_range (map,0,100);
+      size_t capacity = map->capacity;
+      erase_int_range (map,0,100);
+      assert(map->size==0 && map->capacity==capacity);
+      hashmap_free (&map);
+
+      // hysteresis: no shrink before 20 inserts and erases since the grow.
+      config = (hashmap_config) {0};
+      config.backend = backend;
+      config.hysteresis = 20;
+      map = hashmap_alloc_config (hash_int,&config);
+      insert_int_range (map,0,13);
+      assert(map->capacity==32);
+      erase_int_range (map,0,13);
+      assert(map->capacity==32);
+      insert_int_range (map,0,7);
+      erase_int_range (map,0,1);
+      assert(map->capacity==16);
+      hashmap_free (&map);
+    }
+
+  // a swiss map at its highest load factor only rehashes to grow: one
+  // control array and one slot array per capacity, after the map itself.
+  allocator counted = {storage_alloc, storage_free, NULL};
+  hashmap_config dense = {0};
+  dense.backend = HASHMAP_SWISS;
+  dense.max_load_factor = 0.875;
+  dense.mem = &counted;
+  storage_allocs = 0;
+  map = hashmap_alloc_config (hash_int,&dense);
+  insert_int_range (map,0,1000);
+  assert(map->capacity==2048);
+  assert(storage_allocs==1+2*8);//the map, then 16, 32, ..., 2048
+  hashmap_free (&map);
+}
+
+/**
+ * a hash function that sends every key to the same slot
+ * @param elem a key
+ * @return 0
+ */
+size_t constant_hash(const void *elem)
+{
+  (void) elem;
+  return 0;
+}
+
+void test_hash_map_robin_hood(void)
+{
+  hashmap_probe_stats stats;
+  hashmap *map = hashmap_alloc (hash_int);
+  assert(hashmap_get_probe_stats (map,&stats)==0);//chaining keeps none
+  hashmap_free (&map);
+  assert(hashmap_get_probe_stats (NULL,&stats)==0);
+
+  hashmap_config config = {0};
+  config.backend = HASHMAP_ROBIN_HOOD;
+  config.max_load_factor = 0.96;
+  assert(hashmap_alloc_config (hash_int,&config)==NULL);
+  config.max_load_factor = 0.95;
+  map = hashmap_alloc_config (hash_int,&config);
+  assert(hashmap_get_probe_stats (map,&stats)==1);
+  assert(stats.max_probe_length==0 && stats.mean_probe_length==0);
+  insert_int_range (map,0,10000);
+  assert(hashmap_get_load_factor (map)>0.5);
+  for(int i=0;i<10000;i++){
+      assert(*(int*)hashmap_at (map,&i)==i);
+    }
+  for(int i=10000;i<20000;i++){
+      assert(hashmap_at (map,&i)==NULL);
+    }
+  assert(hashmap_get_probe_stats (map,&stats)==1);
+  assert(stats.max_probe_length>=1 && stats.max_probe_length<64);
+  assert(stats.mean_probe_length>=1 && stats.mean_probe_length<8);
+
+  // backward shift keeps every other pair reachable.
+  for(int i=0;i<10000;i+=2){
+      assert(hashmap_erase (map,&i)==1);
+    }
+  for(int i=0;i<10000;i++){
+      assert((hashmap_at (map,&i)!=NULL)==(i%2==1));
+    }
+  for(int i=1;i<10000;i+=2){
+      assert(hashmap_erase (map,&i)==1);
+    }
+  assert(hashmap_get_probe_stats (map,&stats)==1);
+  assert(map->size==0 && stats.max_probe_length==0);
+  hashmap_free (&map);
+
+  // a single probe sequence: every key has the same home slot.
+  map = hashmap_alloc_backend (constant_hash,HASHMAP_ROBIN_HOOD);
+  insert_int_range (map,0,300);
+  assert(hashmap_get_probe_stats (map,&stats)==1);
+  assert(stats.max_probe_length==300);
+  for(int i=0;i<300;i++){
+      assert(*(int*)hashmap_at (map,&i)==i);
+    }
+  for(int i=299;i>=0;i-=3){
+      assert(hashmap_erase (map,&i)==1);
+    }
+  for(int i=0;i<300;i++){
+      assert((hashmap_at (map,&i)!=NULL)==(i%3!=2));
+    }
+  assert(hashmap_get_probe_stats (map,&stats)==1);
+  assert(stats.max_probe_length==200);
+  hashmap_free (&map);
+}
+
+void test_hash_map_cuckoo(void)
+{
+  hashmap_config config = {0};
+  config.backend = HASHMAP_CUCKOO;
+  config.max_load_factor = 0.96;
+  assert(hashmap_alloc_config (hash_int,&config)==NULL);
+  config.max_load_factor = 0.95;
+  hashmap *map = hashmap_alloc_config (hash_int,&config);
+  insert_int_range (map,0,20000);
+  assert(hashmap_get_load_factor (map)>0.5);
+  for(int i=0;i<20000;i++){
+      assert(*(int*)hashmap_at (map,&i)==i);
+    }
+  for(int i=20000;i<40000;i++){
+      assert(hashmap_at (map,&i)==NULL);
+    }
+  for(int i=0;i<20000;i+=2){
+      assert(hashmap_erase (map,&i)==1);
+    }
+  for(int i=0;i<20000;i++){
+      assert((hashmap_at (map,&i)!=NULL)==(i%2==1));
+    }
+  hashmap_free (&map);
+
+  // every key in the same two buckets: 8 slots, then the stash.
+  map = hashmap_alloc_backend (constant_hash,HASHMAP_CUCKOO);
+  insert_int_range (map,0,12);
+  assert(insert_int (map,12)==0);//no path, full stash, growing won't help
+  assert(map->size==12);
+  for(int i=0;i<12;i++){
+      assert(*(int*)hashmap_at (map,&i)==i);
+    }
+  int key = 3;
+  assert(hashmap_erase (map,&key)==1);//a stashed pair takes its slot
+  assert(insert_int (map,12)==1);
+  for(int i=0;i<13;i++){
+      assert((hashmap_at (map,&i)!=NULL)==(i!=3));
+    }
+  hashmap_free (&map);
+
+  // the hash map grows an engine out of room by its own growth factor,
+  // and that restarts the hysteresis count like any resize.
+  config = (hashmap_config) {0};
+  config.backend = HASHMAP_CUCKOO;
+  config.growth_factor = 4;
+  config.min_load_factor = 0.125;
+  config.hysteresis = 20;
+  map = hashmap_alloc_config (constant_hash,&config);
+  insert_int_range (map,0,12);
+  size_t capacity = map->capacity;
+  assert(map->since_resize==12);
+  assert(insert_int (map,12)==0);
+  assert(map->capacity==4*capacity && map->since_resize==0);
+  assert(map->size==12);
+  hashmap_free (&map);
+}
+
+/**
+ * walks over a map of the int keys [0, n), erasing the keys erase_if
+ * selects during the walk, and checks every key is returned once
+ * @param map the map
+ * @param n the number of keys
+ * @param erase_mod the keys divisible by it are erased, 0 for none
+ */
+void check_iter (hashmap *map, int n, int erase_mod)
+{
+  int seen[20000] = {0};
+  assert(n<=20000);
+  hashmap_iter iter = hashmap_iter_begin (map);
+  assert(hashmap_iter_erase (&iter)==0);//nothing returned yet
+  const_keyT key;
+  valueT value;
+  size_t size = map->size, count = 0, erased = 0;
+  while(hashmap_iter_next (&iter,&key,&value)){
+      int i = *(const int*)key;
+      assert(i>=0 && i<n && *(int*)value==i && seen[i]==0);
+      seen[i] = 1;
+      count++;
+      if(erase_mod!=0 && i%erase_mod==0){
+          assert(hashmap_iter_erase (&iter)==1);
+          assert(hashmap_iter_erase (&iter)==0);
+          erased++;
+        }
+    }
+  assert(hashmap_iter_next (&iter,NULL,NULL)==0);
+  assert(count==size && map->size==size-erased);
+  for(int i=0;i<n;i++){
+      if(seen[i]){
+          assert((hashmap_at (map,&i)!=NULL)==(erase_mod==0||i%erase_mod!=0));
+        }
+    }
+}
+
+void test_hash_map_iter(void)
+{
+  hashmap_iter iter = hashmap_iter_begin (NULL);
+  assert(hashmap_iter_next (&iter,NULL,NULL)==0);
+  assert(hashmap_iter_erase (NULL)==0);
+
+  for(hashmap_backend backend=HASHMAP_CHAINING;backend<=HASHMAP_COMPACT;
+      backend++){
+      hashmap *map = hashmap_alloc_backend (hash_int,backend);
+      check_iter (map,0,0);
+      insert_int_range (map,0,1000);
+      check_iter (map,1000,0);
+      check_iter (map,1000,2);
+      check_iter (map,1000,3);
+      check_iter (map,1000,1);//erases all
+      assert(map->size==0);
+      hashmap_free (&map);
+
+      // a sparse map still returns exactly its pairs.
+      hashmap_config config = {0};
+      config.backend = backend;
+      config.no_shrink = 1;
+      map = hashmap_alloc_config (hash_int,&config);
+      insert_int_range (map,0,20000);
+      erase_int_range (map,10,20000);
+      check_iter (map,10,0);
+      hashmap_free (&map);
+
+      // a full map, whose clusters wrap around the end of the slots.
+      if(backend==HASHMAP_ROBIN_HOOD||backend==HASHMAP_CUCKOO){
+          config = (hashmap_config) {0};
+          config.backend = backend;
+          config.max_load_factor = 0.95;
+          map = hashmap_alloc_config (hash_int,&config);
+          insert_int_range (map,0,1900);
+          check_iter (map,1900,3);
+          check_iter (map,1900,1);
+          hashmap_free (&map);
+        }
+
+      // long clusters, the stash, and equal hashes in one bucket.
+      map = hashmap_alloc_backend (constant_hash,backend);
+      insert_int_range (map,0,12);
+      check_iter (map,12,2);
+      check_iter (map,12,1);
+      hashmap_free (&map);
+    }
+
+  // while rehashing incrementally, the old buckets are walked too.
+  hashmap *map = hashmap_alloc (hash_int);
+  hashmap_set_incremental_rehash (map,1);
+  insert_int_range (map,0,13);//starts a rehash up
+  assert(map->old_buckets!=NULL);
+  check_iter (map,13,2);
+  check_iter (map,13,1);
+  hashmap_free (&map);
+}
+
+/**
+ * applies mult_int to the even keys of a map of the int keys [0, n) with
+ * hashmap_apply_if_parallel, and checks every value was changed once
+ */
+void check_apply_if_parallel (hashmap *map, int n, size_t n_threads,
+                              size_t chunk_size)
+{
+  assert(hashmap_apply_if_parallel (map,is_key_even,mult_int,n_threads,
+                                    chunk_size)==(size_t) (n+1)/2);
+  for(int i=0;i<n;i++){
+      int *value = hashmap_at (map,&i);
+      assert(*value==(i%2==0 ? i*2 : i));
+      *value = i;
+    }
+}
+
+void test_hash_map_apply_if_parallel(void)
+{
+  assert(hashmap_apply_if_parallel (NULL,is_key_even,mult_int,0,0)==0);
+
+  for(hashmap_backend backend=HASHMAP_CHAINING;backend<=HASHMAP_COMPACT;
+      backend++){
+      hashmap *map = hashmap_alloc_backend (hash_int,backend);
+      check_apply_if_parallel (map,0,4,0);
+      insert_int_range (map,0,20000);
+      check_apply_if_parallel (map,20000,0,0);
+      check_apply_if_parallel (map,20000,4,1);
+      check_apply_if_parallel (map,20000,3,100);
+      check_apply_if_parallel (map,20000,1,0);
+      hashmap_free (&map);
+
+      // the stash, and equal hashes in one bucket.
+      map = hashmap_alloc_backend (constant_hash,backend);
+      insert_int_range (map,0,12);
+      check_apply_if_parallel (map,12,4,1);
+      hashmap_free (&map);
+    }
+
+  // while rehashing incrementally, the old buckets are chunked too.
+  hashmap *map = hashmap_alloc (hash_int);
+  hashmap_set_incremental_rehash (map,1);
+  insert_int_range (map,0,13);//starts a rehash up
+  assert(map->old_buckets!=NULL);
+  check_apply_if_parallel (map,13,4,2);
+  hashmap_free (&map);
+}
+
+/**
+ * checks a walk over map returns the keys of order, in that order
+ * @param map the map
+ * @param order the keys
+ * @param n the number of keys
+ */
+void check_order (hashmap *map, const int *order, size_t n)
+{
+  hashmap_iter iter = hashmap_iter_begin (map);
+  const_keyT key;
+  size_t count = 0;
+  while(hashmap_iter_next (&iter,&key,NULL)){
+      assert(count<n && *(const int*)key==order[count]);
+      count++;
+    }
+  assert(count==n && map->size==n);
+}
+
+void test_hash_map_compact(void)
+{
+  static int order[70000];
+  hashmap_config config = {0};
+  config.backend = HASHMAP_COMPACT;
+  config.max_load_factor = 0.9;
+  assert(hashmap_alloc_config (hash_int,&config)==NULL);
+
+  // keys inserted backwards come back backwards, through every index width.
+  hashmap *map = hashmap_alloc_backend (hash_int,HASHMAP_COMPACT);
+  for(int i=0;i<70000;i++){
+      order[i] = 69999-i;
+      assert(insert_int (map,order[i])==1);
+    }
+  check_order (map,order,70000);
+  for(int i=0;i<70000;i++){
+      assert(*(int*)hashmap_at (map,&i)==i);
+    }
+
+  // erased keys leave the order of the others, a reinserted key goes last.
+  size_t n = 0;
+  for(int i=0;i<70000;i++){
+      if(order[i]%3==0){
+          assert(hashmap_erase (map,&order[i])==1);
+        }
+      else{
+          order[n++] = order[i];
+        }
+    }
+  check_order (map,order,n);
+  assert(insert_int (map,order[0])==0);
+  assert(hashmap_erase (map,&order[0])==1);
+  assert(insert_int (map,order[0])==1);
+  int first = order[0];
+  memmove (order,order+1,(n-1)*sizeof (int));
+  order[n-1] = first;
+  check_order (map,order,n);
+
+  // shrinking compacts the entries, in the same order.
+  size_t capacity = map->capacity;
+  while(n>100){
+      assert(hashmap_erase (map,&order[--n])==1);
+    }
+  assert(map->capacity<capacity);
+  check_order (map,order,n);
+  hashmap_free (&map);
+
+  // churn on a full map compacts the holes in place.
+  config = (hashmap_config) {0};
+  config.backend = HASHMAP_COMPACT;
+  config.no_shrink = 1;
+  map = hashmap_alloc_config (hash_int,&config);
+  insert_int_range (map,0,12);
+  assert(map->capacity==16);
+  for(int round=0;round<100;round++){
+      int key = round;
+      assert(hashmap_erase (map,&key)==1);
+      assert(insert_int (map,round+12)==1);
+    }
+  assert(map->capacity==16);
+  for(int i=0;i<12;i++){
+      order[i] = 100+i;
+    }
+  check_order (map,order,12);
+  hashmap_free (&map);
+}
+
+/**
+ * the size of an int key
+ */
+size_t int_key_size(const_keyT key)
+{
+  (void) key;
+  return sizeof (int);
+}
+/**
+ * the size of a string value, its terminator included
+ */
+size_t string_value_size(const_valueT value)
+{
+  return strlen ((const char*)value)+1;
+}
+
+void test_hash_map_image(void)
+{
+  char path[] = "/tmp/hashmap_image_XXXXXX";
+  int fd = mkstemp (path);
+  assert(fd>=0);
+  close (fd);
+  assert(hashmap_open_mmap (path,hash_int,int_value_cmp)==NULL);//empty file
+
+  for(hashmap_backend backend=HASHMAP_CHAINING;backend<=HASHMAP_COMPACT;
+      backend++){
+      hashmap *map = hashmap_alloc_backend (hash_int,backend);
+      assert(hashmap_write_image (map,path,int_key_size,string_value_size));
+      hashmap_image *image = hashmap_open_mmap (path,hash_int,int_value_cmp);
+      assert(image!=NULL && image->size==0);
+      assert(hashmap_image_at (image,&(int){0})==NULL);
+      hashmap_image_close (&image);
+      assert(image==NULL);
+
+      // values of different lengths, so records are padded differently.
+      char value[64];
+      for(int i=0;i<3000;i++){
+          snprintf (value,sizeof (value),"value_%d%.*s",i,i%40,
+                    "........................................");
+          pair *p = pair_alloc (&i,value,int_value_cpy,string_value_cpy,
+                                int_value_cmp,string_value_cmp,
+                                int_value_free,string_value_free);
+          assert(hashmap_insert (map,p)==1);
+          pair_free ((void **) &p);
+        }
+      assert(hashmap_write_image (map,path,int_key_size,string_value_size));
+      hashmap_free (&map);
+
+      image = hashmap_open_mmap (path,hash_int,int_value_cmp);
+      assert(image!=NULL && image->size==3000);
+      for(int i=0;i<3000;i++){
+          const char *found = hashmap_image_at (image,&i);
+          snprintf (value,sizeof (value),"value_%d%.*s",i,i%40,
+                    "........................................");
+          assert(found!=NULL && strcmp (found,value)==0);
+        }
+      for(int i=3000;i<6000;i++){
+          assert(hashmap_image_at (image,&i)==NULL);
+        }
+      hashmap_image_close (&image);
+    }
+
+  // the size functions of the pair_ops of a map are used without passing
+  // them, and the image is readable by everyone whatever the umask.
+  pair_ops sized_ops = {.key_cpy = int_value_cpy,
+                        .value_cpy = string_value_cpy,
+                        .key_cmp = int_value_cmp,
+                        .value_cmp = string_value_cmp,
+                        .key_free = int_value_free,
+                        .value_free = string_value_free,
+                        .key_size = int_key_size,
+                        .value_size = string_value_size};
+  hashmap *map = hashmap_alloc_ops (hash_int,HASHMAP_SWISS,&sized_ops,NULL);
+  int key = 7;
+  pair *p = pair_alloc (&key,"seven",int_value_cpy,string_value_cpy,
+                        int_value_cmp,string_value_cmp,int_value_free,
+                        string_value_free);
+  assert(hashmap_insert (map,p)==1);
+  pair_free ((void **) &p);
+  mode_t mask = umask (077);
+  assert(hashmap_write_image (map,path,NULL,NULL));
+  umask (mask);
+  hashmap_free (&map);
+  struct stat st;
+  assert(stat (path,&st)==0 && (st.st_mode&0777)==0644);
+  hashmap_image *image = hashmap_open_mmap (path,hash_int,int_value_cmp);
+  assert(image!=NULL && strcmp (hashmap_image_at (image,&key),"seven")==0);
+  hashmap_image_close (&image);
+
+  // a truncated image is rejected.
+  assert(truncate (path,100)==0);
+  assert(hashmap_open_mmap (path,hash_int,int_value_cmp)==NULL);
+  assert(hashmap_open_mmap ("/nonexistent/image",hash_int,
+                            int_value_cmp)==NULL);
+  remove (path);
+}
+
+/**
+ * saves an int key
+ */
+size_t int_key_save(const_keyT key, void *buf, size_t size)
+{
+  if (size>=sizeof (int)){
+      memcpy (buf,key,sizeof (int));
+    }
+  return sizeof (int);
+}
+/**
+ * loads an int key
+ */
+keyT int_key_load(const void *buf, size_t size)
+{
+  if (size!=sizeof (int)){
+      return NULL;
+    }
+  int *key = malloc (sizeof (int));
+  memcpy (key,buf,sizeof (int));
+  return key;
+}
+/**
+ * saves a string value, without its terminator
+ */
+size_t string_value_save(const_valueT value, void *buf, size_t size)
+{
+  size_t len = strlen ((const char*)value);
+  if (size>=len){
+      memcpy (buf,value,len);
+    }
+  return len;
+}
+/**
+ * loads a string value
+ */
+valueT string_value_load(const void *buf, size_t size)
+{
+  char *value = malloc (size+1);
+  memcpy (value,buf,size);
+  value[size] = '\0';
+  return value;
+}
+
+/**
+ * fills the value of the int key i, some of them longer than the buffer
+ * of hashmap_save
+ */
+static char *stream_value(int i)
+{
+  size_t len = i%1000==0 ? HASHMAP_STREAM_BUFFER+10 : (size_t) (i%50);
+  char *value = malloc (len+1);
+  memset (value,'a'+i%26,len);
+  value[len] = '\0';
+  return value;
+}
+
+/**
+ * a hash function of ints other than hash_int
+ * @param elem an int key
+ * @return hash_int of it, with the lowest bit flipped
+ */
+size_t flipped_hash_int(const void *elem)
+{
+  return hash_int (elem)^1;
+}
+
+void test_hash_map_stream(void)
+{
+  pair_ops ops = {.key_cpy = int_value_cpy,
+                  .value_cpy = string_value_cpy,
+                  .key_cmp = int_value_cmp,
+                  .value_cmp = string_value_cmp,
+                  .key_free = int_value_free,
+                  .value_free = string_value_free,
+                  .key_save = int_key_save,
+                  .value_save = string_value_save,
+                  .key_load = int_key_load,
+                  .value_load = string_value_load};
+
+  for(hashmap_backend backend=HASHMAP_CHAINING;backend<=HASHMAP_COMPACT;
+      backend++){
+      hashmap *map = hashmap_alloc_ops (hash_int,backend,&ops,NULL);
+      for(int i=0;i<5000;i++){
+          char *value = stream_value (i);
+          pair *p = pair_alloc (&i,value,int_value_cpy,string_value_cpy,
+                                int_value_cmp,string_value_cmp,
+                                int_value_free,string_value_free);
+          assert(hashmap_insert (map,p)==1);
+          pair_free ((void **) &p);
+          free (value);
+        }
+      hashmap *empty = hashmap_alloc_backend (hash_int,backend);
+
+      // two snapshots in a row.
+      FILE *file = tmpfile ();
+      assert(file!=NULL);
+      assert(hashmap_save (map,file)==1);
+      assert(hashmap_save (empty,file)==1);
+      rewind (file);
+      hashmap *copy = hashmap_load (file,hash_int,&ops);
+      assert(copy!=NULL && copy->size==5000 && copy->backend==backend);
+      assert(copy->capacity==map->capacity);
+      for(int i=0;i<5000;i++){
+          char *value = stream_value (i);
+          assert(strcmp (hashmap_at (copy,&i),value)==0);
+          free (value);
+        }
+      hashmap *empty_copy = hashmap_load (file,hash_int,&ops);
+      assert(empty_copy!=NULL && empty_copy->size==0);
+      assert(hashmap_load (file,hash_int,&ops)==NULL);//at the end
+      fclose (file);
+
+      // a truncated snapshot is rejected.
+      file = tmpfile ();
+      assert(hashmap_save (map,file)==1);
+      long length = ftell (file);
+      fflush (file);
+      assert(ftruncate (fileno (file),length-1)==0);
+      rewind (file);
+      assert(hashmap_load (file,hash_int,&ops)==NULL);
+      fclose (file);
+
+      hashmap_free (&map);
+      hashmap_free (&empty);
+      hashmap_free (&copy);
+      hashmap_free (&empty_copy);
+    }
+
+  // a damaged capacity does not allocate a huge table.
+  pair_ops int_ops = {.key_cpy = int_value_cpy,
+                      .value_cpy = int_value_cpy,
+                      .key_cmp = int_value_cmp,
+                      .value_cmp = int_value_cmp,
+                      .key_free = int_value_free,
+                      .value_free = int_value_free,
+                      .key_save = int_key_save,
+                      .value_save = int_key_save,
+                      .key_load = int_key_load,
+                      .value_load = int_key_load};
+  hashmap *big = hashmap_alloc_ops (hash_int,HASHMAP_CHAINING,&int_ops,
+                                    NULL);
+  insert_int_range (big,0,5000);
+  FILE *damaged = tmpfile ();
+  assert(hashmap_save (big,damaged)==1);
+  uint64_t capacity = (uint64_t) 1 << 60;
+  fseek (damaged,32,SEEK_SET);//the offset of the capacity
+  assert(fwrite (&capacity,sizeof (capacity),1,damaged)==1);
+  rewind (damaged);
+  hashmap *copy = hashmap_load (damaged,hash_int,&int_ops);
+  assert(copy!=NULL && copy->size==5000 && copy->capacity<=2*big->capacity);
+  for(int i=0;i<5000;i++){
+      assert(*(int *) hashmap_at (copy,&i)==i);
+    }
+  fclose (damaged);
+  hashmap_free (&copy);
+
+  // another hash function does not hash the first key the same.
+  damaged = tmpfile ();
+  assert(hashmap_save (big,damaged)==1);
+  rewind (damaged);
+  assert(hashmap_load (damaged,flipped_hash_int,&int_ops)==NULL);
+  fclose (damaged);
+  hashmap_free (&big);
+
+  // chaining holds more pairs than buckets above a max load factor of 1.
+  hashmap_config dense = {0};
+  dense.max_load_factor = 4.0;
+  dense.ops = &int_ops;
+  big = hashmap_alloc_config (hash_int,&dense);
+  insert_int_range (big,0,40);
+  assert(big->capacity==16);
+  damaged = tmpfile ();
+  assert(hashmap_save (big,damaged)==1);
+  rewind (damaged);
+  copy = hashmap_load (damaged,hash_int,&int_ops);
+  assert(copy!=NULL && copy->size==40 && copy->capacity==16);
+  for(int i=0;i<40;i++){
+      assert(*(int *) hashmap_at (copy,&i)==i);
+    }
+  fclose (damaged);
+  hashmap_free (&copy);
+  hashmap_free (&big);
+
+  // no serialize functions.
+  hashmap *map = hashmap_alloc (hash_int);
+  insert_int_range (map,0,10);
+  FILE *file = tmpfile ();
+  assert(hashmap_save (map,file)==0);
+  fclose (file);
+  hashmap_free (&map);
+  pair_ops no_load = ops;
+  no_load.key_load = NULL;
+  assert(hashmap_load (stdin,hash_int,&no_load)==NULL);
+}
+
+/**
+ * compares two string keys
+ */
+int string_key_cmp(const_keyT key_1, const_keyT key_2)
+{
+  return strcmp (key_1,key_2)==0;
+}
+
+/**
+ * compares a string key with the bytes of a string, without its
+ * terminator
+ */
+int string_key_cmp_bytes(const_keyT key, const void *bytes, size_t len)
+{
+  return strlen (key)==len && memcmp (key,bytes,len)==0;
+}
+
+void test_hash_map_bytes_lookup(void)
+{
+  pair_ops ops = {.key_cpy = string_value_cpy,
+                  .value_cpy = int_value_cpy,
+                  .key_cmp = string_key_cmp,
+                  .value_cmp = int_value_cmp,
+                  .key_free = string_value_free,
+                  .value_free = int_value_free,
+                  .key_cmp_bytes = string_key_cmp_bytes};
+
+  for(hashmap_backend backend=HASHMAP_CHAINING;backend<=HASHMAP_COMPACT;
+      backend++){
+      hashmap *map = hashmap_alloc_ops (hash_string,backend,&ops,NULL);
+      char key[32];
+      for(int i=0;i<2000;i++){
+          sprintf (key,"key%d",i);
+          pair *p = pair_alloc (key,&i,string_value_cpy,int_value_cpy,
+                                string_key_cmp,int_value_cmp,
+                                string_value_free,int_value_free);
+          assert(hashmap_insert (map,p)==1);
+          pair_free ((void **) &p);
+        }
+
+      // keys looked up in place, inside a bigger buffer.
+      char line[64];
+      for(int i=0;i<2000;i++){
+          int len = sprintf (line,"get key%d now",i)-8;
+          size_t hash = hash_bytes (line+4,len,HASH_DEFAULT_SEED);
+          assert(*(int *) hashmap_at_bytes (map,line+4,len,hash)==i);
+          // a prefix of the key is another key, or none.
+          hash = hash_bytes (line+4,len-1,HASH_DEFAULT_SEED);
+          int *prefix = hashmap_at_bytes (map,line+4,len-1,hash);
+          assert(prefix==NULL || *prefix==i/10);
+        }
+      assert(hashmap_at_bytes (map,"key",3,
+                               hash_bytes ("key",3,HASH_DEFAULT_SEED))==NULL);
+
+      for(int i=0;i<2000;i+=2){
+          int len = sprintf (key,"key%d",i);
+          size_t hash = hash_bytes (key,len,HASH_DEFAULT_SEED);
+          assert(hashmap_erase_bytes (map,key,len,hash)==1);
+          assert(hashmap_erase_bytes (map,key,len,hash)==0);
+        }
+      assert(map->size==1000);
+      for(int i=0;i<2000;i++){
+          sprintf (key,"key%d",i);
+          assert((hashmap_at (map,key)==NULL)==(i%2==0));
+        }
+      hashmap_free (&map);
+    }
+
+  // hash maps without key_cmp_bytes.
+  hashmap *map = hashmap_alloc (hash_int);
+  insert_int_range (map,0,10);
+  int key = 3;
+  size_t hash = hash_int (&key);
+  assert(hashmap_at_bytes (map,&key,sizeof (key),hash)==NULL);
+  assert(hashmap_erase_bytes (map,&key,sizeof (key),hash)==0);
+  assert(map->size==10);
+  hashmap_free (&map);
+}
+
+/**
+ * number of keys copied by the counting key copy functions
+ */
+static int key_copies = 0;
+
+void *counting_char_key_cpy(const_keyT key)
+{
+  key_copies++;
+  return char_key_cpy (key);
+}
+
+void *counting_string_key_cpy(const_keyT key)
+{
+  key_copies++;
+  return string_value_cpy (key);
+}
+
+/**
+ * fills key with the string key of i: its digits, padded with dashes to
+ * i%24 chars
+ */
+static size_t inline_key(char *key, int i)
+{
+  int len = sprintf (key,"%d",i);
+  while (len<i%24){
+      key[len++] = '-';
+    }
+  key[len] = '\0';
+  return (size_t) len+1;
+}
+
+/**
+ * a value copy function that always fails
+ */
+void *failing_value_cpy(const_valueT value)
+{
+  (void) value;
+  return NULL;
+}
+
+void test_hash_map_inline(void)
+{
+  pair_ops char_ops = {.key_cpy = counting_char_key_cpy,
+                       .value_cpy = counting_int_cpy,
+                       .key_cmp = char_key_cmp,
+                       .value_cmp = int_value_cmp,
+                       .key_free = char_key_free,
+                       .value_free = int_value_free,
+                       .key_size = char_key_size,
+                       .value_size = int_value_size,
+                       .inline_size = ENTRY_INLINE_SIZE};
+  pair_ops string_ops = {.key_cpy = counting_string_key_cpy,
+                         .value_cpy = counting_int_cpy,
+                         .key_cmp = string_key_cmp,
+                         .value_cmp = int_value_cmp,
+                         .key_free = string_value_free,
+                         .value_free = int_value_free,
+                         .key_size = string_value_size,
+                         .value_size = int_value_size,
+                         .inline_size = ENTRY_INLINE_SIZE};
+  char key[32];
+
+  for(hashmap_backend backend=HASHMAP_CHAINING;backend<=HASHMAP_COMPACT;
+      backend++){
+      // char keys and int values always fit, nothing is copied.
+      key_copies = value_copies = 0;
+      hashmap *map = hashmap_alloc_ops (hash_char,backend,&char_ops,NULL);
+      for(int i=0;i<100;i++){
+          char c = (char) i;
+          pair *p = pair_alloc (&c,&i,char_key_cpy,int_value_cpy,
+                                char_key_cmp,int_value_cmp,char_key_free,
+                                int_value_free);
+          assert(hashmap_insert (map,p)==1);
+          pair_free ((void **) &p);
+        }
+      assert(key_copies==0 && value_copies==0);
+      assert(hashmap_apply_if (map,is_digit,double_value)==10);
+      for(int i=0;i<100;i++){
+          char c = (char) i;
+          int value = is_digit (&c) ? 2*i : i;
+          assert(*(int *) hashmap_at (map,&c)==value);
+        }
+      for(int i=0;i<100;i+=2){
+          char c = (char) i;
+          assert(hashmap_erase (map,&c)==1);
+        }
+      assert(map->size==50);
+
+      // adopted keys and values stay where they are.
+      char c = (char) 100;
+      int value = 100;
+      pair *p = pair_alloc (&c,&value,char_key_cpy,int_value_cpy,
+                            char_key_cmp,int_value_cmp,char_key_free,
+                            int_value_free);
+      assert(hashmap_insert_take (map,p)==1);
+      assert(*(int *) hashmap_at (map,&c)==100);
+      assert(key_copies==0 && value_copies==0);
+      hashmap_free (&map);
+
+      // string keys longer than the inline bytes spill to the heap, and
+      // take the value with them when it does not fit after the key.
+      key_copies = value_copies = 0;
+      int expected_keys = 0, expected_values = 0;
+      map = hashmap_alloc_ops (hash_string,backend,&string_ops,NULL);
+      for(int i=0;i<1000;i++){
+          size_t size = inline_key (key,i);
+          expected_keys += size>ENTRY_INLINE_SIZE;
+          expected_values += size>8 && size<=ENTRY_INLINE_SIZE;
+          pair *q = pair_alloc (key,&i,string_value_cpy,int_value_cpy,
+                                string_key_cmp,int_value_cmp,
+                                string_value_free,int_value_free);
+          assert(hashmap_insert (map,q)==1);
+          pair_free ((void **) &q);
+        }
+      assert(key_copies==expected_keys && value_copies==expected_values);
+      for(int i=0;i<1000;i++){
+          inline_key (key,i);
+          assert(*(int *) hashmap_at (map,key)==i);
+        }
+      for(int i=0;i<1000;i+=3){
+          inline_key (key,i);
+          assert(hashmap_erase (map,key)==1);
+        }
+      for(int i=0;i<1000;i++){
+          inline_key (key,i);
+          assert((hashmap_at (map,key)==NULL)==(i%3==0));
+        }
+      hashmap_free (&map);
+    }
+
+  // a failed copy fails the insert, and frees what was copied already.
+  pair_ops failing_ops = {.key_cpy = char_key_cpy,
+                          .value_cpy = failing_value_cpy,
+                          .key_cmp = char_key_cmp,
+                          .value_cmp = int_value_cmp,
+                          .key_free = char_key_free,
+                          .value_free = int_value_free};
+  for(size_t inline_size=0;inline_size<=ENTRY_INLINE_SIZE;
+      inline_size+=ENTRY_INLINE_SIZE){
+      failing_ops.key_size = inline_size ? char_key_size : NULL;
+      failing_ops.inline_size = inline_size;
+      hashmap *map = hashmap_alloc_ops (hash_char,HASHMAP_CHAINING,
+                                        &failing_ops,NULL);
+      char c = 'a';
+      int value = 1;
+      pair *p = pair_alloc (&c,&value,char_key_cpy,int_value_cpy,
+                            char_key_cmp,int_value_cmp,char_key_free,
+                            int_value_free);
+      assert(hashmap_insert (map,p)==0 && map->size==0);
+      assert(hashmap_at (map,&c)==NULL);
+      pair_free ((void **) &p);
+      hashmap_free (&map);
+    }
+}
+
+void test_hash_map_find_or_insert(void)
+{
+  pair_ops ops = {.key_cpy = char_key_cpy,
+                  .value_cpy = counting_int_cpy,
+                  .key_cmp = char_key_cmp,
+                  .value_cmp = int_value_cmp,
+                  .key_free = char_key_free,
+                  .value_free = int_value_free};
+  pair_ops inline_ops = {.key_cpy = char_key_cpy,
+                         .value_cpy = counting_int_cpy,
+                         .key_cmp = char_key_cmp,
+                         .value_cmp = int_value_cmp,
+                         .key_free = char_key_free,
+                         .value_free = int_value_free,
+                         .key_size = char_key_size,
+                         .value_size = int_value_size,
+                         .inline_size = ENTRY_INLINE_SIZE};
+  const char *text = "the quick brown fox jumps over the lazy dog";
+  int zero = 0, inserted;
+
+  for(hashmap_backend backend=HASHMAP_CHAINING;backend<=HASHMAP_COMPACT;
+      backend++){
+      for(int with_inline=0;with_inline<=1;with_inline++){
+          hashmap *map = hashmap_alloc_ops (hash_char,backend,
+                                            with_inline ? &inline_ops : &ops,
+                                            NULL);
+
+          // counting letters, a copy only for the first of each letter.
+          value_copies = 0;
+          int new_letters = 0;
+          for(const char *c=text;*c!='\0';c++){
+              int *count = hashmap_find_or_insert (map,c,&zero,&inserted);
+              assert(count!=NULL);
+              new_letters += inserted;
+              *count += 1;
+            }
+          assert(new_letters==27 && map->size==27);
+          assert(value_copies==(with_inline ? 0 : 27));
+          assert(*(int *) hashmap_at (map," ")==8);
+          assert(*(int *) hashmap_at (map,"o")==4);
+          assert(*(int *) hashmap_at (map,"z")==1);
+
+          // assigning replaces the value, inserting adds a pair.
+          int value = 100;
+          pair *p = pair_alloc ("o",&value,char_key_cpy,int_value_cpy,
+                                char_key_cmp,int_value_cmp,char_key_free,
+                                int_value_free);
+          assert(hashmap_insert_or_assign (map,p,&inserted)==1);
+          assert(inserted==0 && map->size==27);
+          assert(*(int *) hashmap_at (map,"o")==100);
+          pair_free ((void **) &p);
+          p = pair_alloc ("!",&value,char_key_cpy,int_value_cpy,char_key_cmp,
+                          int_value_cmp,char_key_free,int_value_free);
+          assert(hashmap_insert_or_assign (map,p,NULL)==1);
+          assert(map->size==28 && *(int *) hashmap_at (map,"!")==100);
+          assert(hashmap_find_or_insert (map,"!",&zero,&inserted)!=NULL);
+          assert(inserted==0);
+          pair_free ((void **) &p);
+
+          // many keys, through resizes.
+          for(int i=0;i<100;i++){
+              char c = (char) (128+i);
+              int *slot = hashmap_find_or_insert (map,&c,&i,NULL);
+              assert(*slot==i);
+            }
+          for(int i=0;i<100;i++){
+              char c = (char) (128+i);
+              assert(*(int *) hashmap_at (map,&c)==i);
+            }
+          hashmap_free (&map);
+        }
+    }
+
+  // string values assigned over each other.
+  hashmap *map = hashmap_alloc (hash_int);
+  for(int round=0;round<3;round++){
+      for(int i=0;i<50;i++){
+          char value[16];
+          sprintf (value,"%d:%d",round,i);
+          pair *p = pair_alloc (&i,value,int_value_cpy,string_value_cpy,
+                                int_value_cmp,string_value_cmp,int_value_free,
+                                string_value_free);
+          assert(hashmap_insert_or_assign (map,p,&inserted)==1);
+          assert(inserted==(round==0));
+          pair_free ((void **) &p);
+        }
+    }
+  assert(map->size==50 && strcmp (hashmap_at (map,&zero),"2:0")==0);
+  hashmap_free (&map);
+
+  // a hash map that does not know its functions yet.
+  map = hashmap_alloc (hash_char);
+  inserted = 1;
+  assert(hashmap_find_or_insert (map,"a",&zero,&inserted)==NULL);
+  assert(inserted==0 && map->size==0);
+  assert(hashmap_insert_or_assign (NULL,NULL,NULL)==0);
+  hashmap_free (&map);
+
+  // an entry assigned the tail of its own heap value, short enough to
+  // move inline: the old value is freed only after the copy.
+  pair_ops string_ops = {.key_cpy = char_key_cpy,
+                         .value_cpy = string_value_cpy,
+                         .key_cmp = char_key_cmp,
+                         .value_cmp = string_value_cmp,
+                         .key_free = char_key_free,
+                         .value_free = string_value_free,
+                         .key_size = char_key_size,
+                         .value_size = string_value_size,
+                         .inline_size = ENTRY_INLINE_SIZE};
+  entry *e = entry_alloc (&string_ops,NULL,"k",
+                          "a value too long to be inline: tail",
+                          hash_char ("k"));
+  assert(e!=NULL);
+  const char *tail = (const char *) e->value+strlen (e->value)-4;
+  assert(entry_assign (e,&string_ops,tail)==1);
+  assert(strcmp (e->value,"tail")==0);
+  entry_free (&e,&string_ops,NULL);
+}
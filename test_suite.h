@@ -35,4 +35,137 @@ void test_hash_map_get_load_factor(void);
  */
 void test_hash_map_apply_if();
 
+/**
+ * This function checks the hashmap functions on every storage engine
+ * hashmap_alloc_backend can select.
+ * If one of them fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_backends(void);
+
+/**
+ * This function checks incremental rehashing of the hashmap library.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_incremental_rehash(void);
+
+/**
+ * This function checks the hashmap_insert_take function of the hashmap library.
+ * If hashmap_insert_take fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_insert_take(void);
+
+/**
+ * This function checks hash maps drawing from an allocator (and an arena).
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_allocator(void);
+
+/**
+ * This function checks maps generated by HASHMAP_DECLARE.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_template(void);
+
+/**
+ * This function checks hash maps sharing one pair_ops for all their pairs.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_pair_ops(void);
+
+/**
+ * This function checks the distribution of the hash functions of hash_funcs.h.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_funcs(void);
+
+/**
+ * This function checks the concurrent hash map.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_concurrent_hashmap(void);
+
+/**
+ * This function checks the epoch hash map, whose lookups take no lock.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_epoch_hashmap(void);
+
+/**
+ * This function checks the batch functions of the hashmap library.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_batch(void);
+
+/**
+ * This function checks hashmap_reserve and hashmap_from_array.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_bulk_build(void);
+
+/**
+ * This function checks hashmap_alloc_config and the resize policies.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_config(void);
+
+/**
+ * This function checks the Robin Hood storage engine and its probe lengths.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_robin_hood(void);
+
+/**
+ * This function checks the cuckoo storage engine, its stash and its resizes.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_cuckoo(void);
+
+/**
+ * This function checks the iterator functions, and erasing while iterating.
+ * If they fail at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_iter(void);
+
+/**
+ * This function checks hashmap_apply_if_parallel over threads and chunks.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_apply_if_parallel(void);
+
+/**
+ * This function checks the compact storage engine and its insertion order.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_compact(void);
+
+/**
+ * This function checks writing hash maps to images and mapping them back.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_image(void);
+
+/**
+ * This function checks saving hash maps to files and loading them back.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_stream(void);
+
+/**
+ * This function checks looking keys up and erasing them by their bytes.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_bytes_lookup(void);
+
+/**
+ * This function checks keys and values stored inside their entries.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_inline(void);
+
+/**
+ * This function checks hashmap_find_or_insert and hashmap_insert_or_assign.
+ * If it fails at some points, the functions exits with exit code 1.
+ */
+void test_hash_map_find_or_insert(void);
+
 #endif //TESTSUITE_H_
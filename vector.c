@@ -13,26 +13,51 @@
  */
 vector *vector_alloc(vector_elem_cpy elem_copy_func, vector_elem_cmp
     elem_cmp_func, vector_elem_free elem_free_func){
+    return vector_alloc_with(elem_copy_func, elem_cmp_func, elem_free_func,
+                             NULL);
+}
 
-    // first allocate the memory for the vector and check it succeeded
-    vector* new_vector = malloc(sizeof(vector));
+/**
+ * Dynamically allocates a new vector, from the given allocator.
+ * @param elem_copy_func func which copies the element stored in the vector (returns
+ * dynamically allocated copy).
+ * @param elem_cmp_func func which is used to compare elements stored in the vector.
+ * @param elem_free_func func which frees elements stored in the vector.
+ * @param mem the allocator of the vector and its data (NULL for malloc), it
+ * must outlive the vector.
+ * @return pointer to dynamically allocated vector.
+ * @if_fail return NULL.
+ */
+vector *vector_alloc_with(vector_elem_cpy elem_copy_func,
+                          vector_elem_cmp elem_cmp_func,
+                          vector_elem_free elem_free_func,
+                          const allocator *mem){
 
-    // check the allocation and funcs are legal.
-    if (new_vector == NULL || elem_cmp_func == NULL || elem_copy_func == NULL
+    // check the funcs are legal.
+    if (elem_cmp_func == NULL || elem_copy_func == NULL
     || elem_free_func == NULL){
         return NULL;
     }
 
+    // first allocate the memory for the vector and check it succeeded
+    vector* new_vector = allocator_malloc(mem, sizeof(vector));
+
+    if (new_vector == NULL){
+        return NULL;
+    }
+
     // initialize the vector
     new_vector->size = 0;
     new_vector->capacity = VECTOR_INITIAL_CAP;
     new_vector->elem_free_func = elem_free_func;
     new_vector->elem_copy_func = elem_copy_func;
     new_vector->elem_cmp_func = elem_cmp_func;
+    new_vector->mem = mem;
 
-    new_vector->data = calloc(new_vector->capacity, sizeof(void*));
+    new_vector->data = allocator_calloc(mem, new_vector->capacity,
+                                        sizeof(void*));
     if (new_vector->data == NULL){
-        free(new_vector);
+        allocator_free(mem, new_vector, sizeof(vector));
         return NULL;
     }
 
@@ -46,22 +71,27 @@ vector *vector_alloc(vector_elem_cpy elem_copy_func, vector_elem_cmp
  */
 void vector_free(vector **p_vector){
 
+    if (p_vector == NULL || *p_vector == NULL){
+        return;
+    }
+
     vector* cur_vector = *p_vector;
     for (int i = 0; i < cur_vector->size; ++i) {
 
         // free the current element and secure it with Null
         cur_vector->elem_free_func(&cur_vector->data[i]);
         cur_vector->data[i] = NULL;
-        cur_vector->size -= 1;
     }
+    cur_vector->size = 0;
 
     // now every element is freed so we can free the memory allocated when
     // creating the vector.
-    free(cur_vector->data);
+    allocator_free(cur_vector->mem, cur_vector->data,
+                   sizeof(void *) * cur_vector->capacity);
     cur_vector->data = NULL;
 
-    free(cur_vector);
-    cur_vector = NULL;
+    allocator_free(cur_vector->mem, cur_vector, sizeof(vector));
+    *p_vector = NULL;
 }
 
 /**
@@ -128,11 +158,15 @@ int vector_push_back(vector *vector, const void *value) {
     if (vector_get_load_factor(vector) > VECTOR_MAX_LOAD_FACTOR){
 
         //this means the vector needs to be resized
-        vector->capacity *= VECTOR_GROWTH_FACTOR;
-        vector->data = realloc( vector->data ,sizeof(value) * vector->capacity);
-        if (vector->data == NULL){
+        void **new_data = allocator_realloc(vector->mem, vector->data,
+                                            sizeof(void *) * vector->capacity,
+                                            sizeof(void *) * vector->capacity *
+                                            VECTOR_GROWTH_FACTOR);
+        if (new_data == NULL){
             return false;
         }
+        vector->data = new_data;
+        vector->capacity *= VECTOR_GROWTH_FACTOR;
 
     }
 
@@ -181,15 +215,21 @@ int vector_erase(vector *vector, size_t ind){
 
     vector->size -= 1;
 
-    // this means that after the removal, we need to resize the vector
-    if (vector_get_load_factor(vector) < VECTOR_MIN_LOAD_FACTOR){
-
-        vector->capacity /= VECTOR_GROWTH_FACTOR;
-
-        vector->data = realloc(vector->data, sizeof(void *) * vector->capacity);
-
-        if (vector->data == NULL){
-            return false;
+    // this means that after the removal, we need to resize the vector, but
+    // never below the initial capacity.
+    if (vector_get_load_factor(vector) < VECTOR_MIN_LOAD_FACTOR &&
+    vector->capacity / VECTOR_GROWTH_FACTOR >= VECTOR_INITIAL_CAP){
+
+        void **new_data = allocator_realloc(vector->mem, vector->data,
+                                            sizeof(void *) * vector->capacity,
+                                            sizeof(void *) *
+                                            (vector->capacity /
+                                             VECTOR_GROWTH_FACTOR));
+
+        // a failed shrink leaves the (bigger) old array in place.
+        if (new_data != NULL){
+            vector->data = new_data;
+            vector->capacity /= VECTOR_GROWTH_FACTOR;
         }
     }
 
@@ -203,8 +243,9 @@ int vector_erase(vector *vector, size_t ind){
  */
 void vector_clear(vector *vector){
 
-    for (int i = 0 ; i < vector->size ; ++i){
-        vector_erase(vector, i);
+    // erase from the back so no element is skipped by the shifting.
+    while (vector->size > 0){
+        vector_erase(vector, vector->size - 1);
     }
 
 }